@@ -0,0 +1,153 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "allocationcounter.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+
+#ifdef __GLIBC__
+#    include <malloc.h>
+#endif
+
+namespace {
+// Constant initialized, so they work for allocations made before main()
+std::atomic<quint64> s_allocations{0};
+std::atomic<quint64> s_allocatedBytes{0};
+std::atomic<qint64> s_liveBytes{0};
+std::atomic<qint64> s_peakLiveBytes{0};
+thread_local quint64 t_allocations = 0;
+} // namespace
+
+#ifdef __GLIBC__
+// Executables come first in symbol lookup, so these replace the allocator of
+// every library, operator new included, and forward to the glibc one
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+void *__libc_memalign(size_t alignment, size_t size);
+
+static inline void *countAllocation(void *ptr, size_t size)
+{
+    if (ptr) {
+        ++t_allocations;
+        s_allocations.fetch_add(1, std::memory_order_relaxed);
+        s_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+        const auto usable = qint64(malloc_usable_size(ptr));
+        const qint64 live = s_liveBytes.fetch_add(usable, std::memory_order_relaxed) + usable;
+        qint64 peak       = s_peakLiveBytes.load(std::memory_order_relaxed);
+        while (live > peak &&
+               !s_peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+    }
+    return ptr;
+}
+
+void *malloc(size_t size) __THROW
+{
+    return countAllocation(__libc_malloc(size), size);
+}
+
+void *calloc(size_t count, size_t size) __THROW
+{
+    return countAllocation(__libc_calloc(count, size), count * size);
+}
+
+void *realloc(void *ptr, size_t size) __THROW
+{
+    const qint64 previous = ptr ? qint64(malloc_usable_size(ptr)) : 0;
+    void *ret             = __libc_realloc(ptr, size);
+    if (ret || size == 0) {
+        s_liveBytes.fetch_sub(previous, std::memory_order_relaxed);
+    }
+    return countAllocation(ret, size);
+}
+
+void *memalign(size_t alignment, size_t size) __THROW
+{
+    return countAllocation(__libc_memalign(alignment, size), size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) __THROW
+{
+    return countAllocation(__libc_memalign(alignment, size), size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) __THROW
+{
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+
+    void *ret = __libc_memalign(alignment, size);
+    if (!ret) {
+        return ENOMEM;
+    }
+    *ptr = countAllocation(ret, size);
+    return 0;
+}
+
+void free(void *ptr) __THROW
+{
+    if (ptr) {
+        s_liveBytes.fetch_sub(qint64(malloc_usable_size(ptr)), std::memory_order_relaxed);
+    }
+    __libc_free(ptr);
+}
+}
+#endif
+
+bool AllocationCounter::isAvailable()
+{
+#ifdef __GLIBC__
+    return true;
+#else
+    return false;
+#endif
+}
+
+quint64 AllocationCounter::allocations()
+{
+    return s_allocations.load(std::memory_order_relaxed);
+}
+
+quint64 AllocationCounter::allocatedBytes()
+{
+    return s_allocatedBytes.load(std::memory_order_relaxed);
+}
+
+quint64 AllocationCounter::threadAllocations()
+{
+    return t_allocations;
+}
+
+qint64 AllocationCounter::liveBytes()
+{
+    return s_liveBytes.load(std::memory_order_relaxed);
+}
+
+qint64 AllocationCounter::peakLiveBytes()
+{
+    return s_peakLiveBytes.load(std::memory_order_relaxed);
+}
+
+void AllocationCounter::resetPeakLiveBytes()
+{
+    s_peakLiveBytes.store(liveBytes(), std::memory_order_relaxed);
+}
@@ -0,0 +1,55 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#pragma once
+
+#include <QtGlobal>
+
+/**
+ * Counts the heap allocations of the whole process, Qt and the library
+ * included, by interposing malloc() and friends. Only available with glibc,
+ * elsewhere the counters stay at zero.
+ */
+class AllocationCounter
+{
+public:
+    static bool isAvailable();
+
+    /**
+     * Returns the number of allocations, reallocations included
+     */
+    static quint64 allocations();
+
+    /**
+     * Returns the bytes requested by those calls
+     */
+    static quint64 allocatedBytes();
+
+    /**
+     * Returns the number of allocations made by the calling thread
+     */
+    static quint64 threadAllocations();
+
+    /**
+     * Returns the usable size of the blocks not freed yet
+     */
+    static qint64 liveBytes();
+
+    /**
+     * Returns the highest liveBytes() since the last resetPeakLiveBytes()
+     */
+    static qint64 peakLiveBytes();
+    static void resetPeakLiveBytes();
+};
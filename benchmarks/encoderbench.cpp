@@ -0,0 +1,380 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "allocationcounter.h"
+#include "mimecontentformatter.h"
+#include "mimemessage.h"
+#include "mimepart.h"
+#include "mimetext.h"
+#include "quotedprintable.h"
+
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+
+using namespace SimpleMail;
+
+struct Corpus {
+    QString name;
+    QByteArray data;
+    bool text;
+};
+
+static QByteArray repeatTo(const QByteArray &sample, qsizetype size)
+{
+    QByteArray ret;
+    ret.reserve(size + sample.size());
+    while (ret.size() < size) {
+        ret.append(sample);
+    }
+    return ret;
+}
+
+static QList<Corpus> corpora(qsizetype size)
+{
+    // Text is UTF-8 with LF line endings, as QString::toUtf8() gives it to MimePart
+    const QByteArray ascii = QByteArrayLiteral(
+        "Dear customer,\nyour order #1234 has shipped and should arrive within 3-5 business "
+        "days. The tracking number is ABC-123 = see https://example.com/track?id=42.\n"
+        ". A line starting with a dot, tabs\tand trailing spaces  \n");
+    const QByteArray latin1 = QByteArrayLiteral(
+        "Chère cliente, votre commande a été expédiée à Zürich; la façade du café reçoit "
+        "les crêpes à 9 francs. Größe: groß, naïve coöperation, señor Muñoz.\n");
+    const QByteArray cjk = QByteArrayLiteral(
+        "お客様へ、ご注文の商品は発送されました。到着まで三から五営業日かかります。"
+        "尊敬的客户，您的订单已发货，请查收。고객님, 주문하신 상품이 발송되었습니다.\n");
+
+    QByteArray binary(size, Qt::Uninitialized);
+    QRandomGenerator generator(42);
+    for (qsizetype i = 0; i < size; ++i) {
+        binary[i] = char(generator.bounded(256));
+    }
+
+    return {
+        {QStringLiteral("ascii"), repeatTo(ascii, size), true},
+        {QStringLiteral("latin1"), repeatTo(latin1, size), true},
+        {QStringLiteral("cjk"), repeatTo(cjk, size), true},
+        {QStringLiteral("binary"), binary, false},
+    };
+}
+
+// Keeps the results alive so the calls aren't optimized out
+static volatile qsizetype s_sink = 0;
+
+struct Options {
+    int minTime;
+};
+
+template <typename Func>
+static QJsonObject measure(const QString &function,
+                           const Corpus &corpus,
+                           qsizetype inputBytes,
+                           const Options &options,
+                           Func func)
+{
+    s_sink = s_sink + func(); // Warm up caches and buffers
+
+    QElapsedTimer timer;
+    const quint64 allocations = AllocationCounter::allocations();
+    quint64 iterations        = 0;
+    timer.start();
+    do {
+        s_sink = s_sink + func();
+        ++iterations;
+    } while (timer.elapsed() < options.minTime);
+    const double seconds = double(timer.nsecsElapsed()) / 1e9;
+
+    const quint64 calls = AllocationCounter::allocations() - allocations;
+    qInfo().noquote() << function << corpus.name << (inputBytes * iterations / seconds / 1e6)
+                      << "MB/s";
+
+    return {
+        {QStringLiteral("function"), function},
+        {QStringLiteral("corpus"), corpus.name},
+        {QStringLiteral("inputBytes"), double(inputBytes)},
+        {QStringLiteral("iterations"), double(iterations)},
+        {QStringLiteral("mbPerSecond"), double(inputBytes) * iterations / seconds / 1e6},
+        {QStringLiteral("nsPerCall"), seconds * 1e9 / iterations},
+        {QStringLiteral("allocationsPerCall"),
+         AllocationCounter::isAvailable() ? double(calls) / iterations : -1.0},
+    };
+}
+
+static MimeMessage headerMessage(const Corpus &corpus)
+{
+    // Names and subject taken from the corpus, with whole UTF-8 sequences
+    const QString text = QString::fromUtf8(corpus.data.left(4096));
+
+    MimeMessage message;
+    message.setSender(EmailAddress(QStringLiteral("sender@example.com"), text.mid(0, 20)));
+    for (int i = 0; i < 20; ++i) {
+        message.addTo(
+            EmailAddress(QStringLiteral("rcpt%1@example.com").arg(i), text.mid(i * 7, 24)));
+    }
+    for (int i = 0; i < 5; ++i) {
+        message.addCc(
+            EmailAddress(QStringLiteral("cc%1@example.com").arg(i), text.mid(i * 11, 24)));
+    }
+    message.setSubject(text.mid(3, 70));
+    message.addHeader("X-Mailer", "SimpleMail benchmark");
+    message.setContent(std::make_shared<MimeText>(QStringLiteral("Hi")));
+    return message;
+}
+
+static QByteArray body(const QByteArray &written)
+{
+    // What MimePart::write() produced after the headers, without the last CRLF
+    const auto start = written.indexOf("\r\n\r\n");
+    return written.mid(start + 4, written.size() - start - 6);
+}
+
+static QByteArray unstuffQuotedPrintable(const QByteArray &data)
+{
+    // Undoes the dot stuffing of lines and checks their length
+    QByteArray ret;
+    for (const QByteArray &line : data.split('\n')) {
+        if (line.size() > 77) {
+            return QByteArrayLiteral("line too long");
+        }
+        ret.append(line.startsWith("..") ? line.mid(1) : line);
+        ret.append('\n');
+    }
+    ret.chop(1);
+    return ret;
+}
+
+static QJsonArray crossCheck(const QList<Corpus> &corpora)
+{
+    QJsonArray checks;
+    auto check = [&checks](const QString &name, bool ok) {
+        if (!ok) {
+            qCritical().noquote() << "Check failed:" << name;
+        }
+        checks.append(QJsonObject{
+            {QStringLiteral("name"), name},
+            {QStringLiteral("ok"), ok},
+        });
+    };
+
+    // Reference outputs
+    check(QStringLiteral("qp-encode-reference"),
+          QuotedPrintable::encode(QByteArrayLiteral("Caf\xc3\xa9 = 100%\tok\r\n"), false) ==
+              "Caf=C3=A9 =3D 100%\tok=0D=0A");
+    check(QStringLiteral("qp-encode-rfc2047-reference"),
+          QuotedPrintable::encode(QByteArrayLiteral("Ol\xc3\xa1?a_b*c"), true) ==
+              "Ol=C3=A1=3Fa_b*c");
+    check(QStringLiteral("qp-decode-reference"),
+          QuotedPrintable::decode(QByteArrayLiteral("Caf=C3=A9 =3D=\r\n 100%=\nok")) ==
+              "Caf\xc3\xa9 = 100%ok");
+
+    MimeContentFormatter formatter;
+    int chars = 0;
+    check(QStringLiteral("format-reference"),
+          formatter.format(QByteArray(80, 'A'), chars) ==
+              QByteArray(QByteArray(76, 'A') + "\r\nAAAA\r\n"));
+
+    for (const Corpus &corpus : corpora) {
+        const QByteArray encoded = QuotedPrintable::encode(corpus.data, false);
+        check(QStringLiteral("qp-roundtrip-") + corpus.name,
+              QuotedPrintable::decode(encoded) == corpus.data);
+
+        chars                  = 0;
+        const QByteArray lines = formatter.format(corpus.data.toBase64(), chars);
+        bool shortLines        = true;
+        for (const QByteArray &line : lines.split('\n')) {
+            shortLines = shortLines && line.size() <= 77;
+        }
+        check(QStringLiteral("format-") + corpus.name,
+              shortLines && QByteArray::fromBase64(lines) == corpus.data);
+
+        // The Base64 reference is QByteArray::toBase64()
+        MimePart part;
+        part.setContent(corpus.data);
+        part.setEncoding(MimePart::Base64);
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        part.write(&buffer);
+        QByteArray base64 = body(buffer.data());
+        shortLines        = true;
+        for (const QByteArray &line : base64.split('\n')) {
+            shortLines = shortLines && line.size() <= 77;
+        }
+        base64.replace("\r\n", QByteArray());
+        check(QStringLiteral("write-base64-") + corpus.name,
+              shortLines && base64 == corpus.data.toBase64());
+
+        part.setEncoding(MimePart::QuotedPrintable);
+        buffer.buffer().clear();
+        buffer.seek(0);
+        part.write(&buffer);
+        check(QStringLiteral("write-quoted-printable-") + corpus.name,
+              QuotedPrintable::decode(unstuffQuotedPrintable(body(buffer.data()))) ==
+                  corpus.data);
+    }
+
+    return checks;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("simplemail-bench-encoders"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Measures the MIME encoders and header generation over ASCII, accented, "
+                       "CJK and binary corpora, after checking their output"));
+    parser.addHelpOption();
+
+    const QCommandLineOption sizeOption(QStringLiteral("size"),
+                                        QStringLiteral("Bytes of each corpus."),
+                                        QStringLiteral("bytes"),
+                                        QStringLiteral("65536"));
+    const QCommandLineOption minTimeOption(
+        QStringLiteral("min-time"),
+        QStringLiteral("Milliseconds each function runs over each corpus."),
+        QStringLiteral("msec"),
+        QStringLiteral("200"));
+    const QCommandLineOption outputOption({QStringLiteral("o"), QStringLiteral("output")},
+                                          QStringLiteral("Write the JSON to a file."),
+                                          QStringLiteral("path"));
+    parser.addOptions({sizeOption, minTimeOption, outputOption});
+    parser.process(app);
+
+    Options options;
+    options.minTime = qMax(1, parser.value(minTimeOption).toInt());
+
+    const QList<Corpus> inputs = corpora(qMax(1, parser.value(sizeOption).toInt()));
+    const QJsonArray checks    = crossCheck(inputs);
+
+    QJsonArray results;
+    for (const Corpus &corpus : inputs) {
+        const QByteArray &data = corpus.data;
+
+        results.append(measure(QStringLiteral("QuotedPrintable::encode"),
+                               corpus,
+                               data.size(),
+                               options,
+                               [&data] { return QuotedPrintable::encode(data, false).size(); }));
+        results.append(measure(QStringLiteral("QuotedPrintable::encode(rfc2047)"),
+                               corpus,
+                               data.size(),
+                               options,
+                               [&data] { return QuotedPrintable::encode(data, true).size(); }));
+
+        const QByteArray qp = QuotedPrintable::encode(data, false);
+        results.append(measure(QStringLiteral("QuotedPrintable::decode"),
+                               corpus,
+                               qp.size(),
+                               options,
+                               [&qp] { return QuotedPrintable::decode(qp).size(); }));
+
+        MimeContentFormatter formatter;
+        const QByteArray base64 = data.toBase64();
+        results.append(measure(QStringLiteral("MimeContentFormatter::format"),
+                               corpus,
+                               base64.size(),
+                               options,
+                               [&formatter, &base64] {
+            int chars = 0;
+            return formatter.format(base64, chars).size();
+        }));
+        results.append(measure(QStringLiteral("MimeContentFormatter::formatQuotedPrintable"),
+                               corpus,
+                               qp.size(),
+                               options,
+                               [&formatter, &qp] {
+            int chars = 0;
+            return formatter.formatQuotedPrintable(qp, chars).size();
+        }));
+
+        // MimePartPrivate::writeBase64() and writeQuotedPrintable(), the
+        // output buffer is reused so only the encoding allocates
+        MimePart part;
+        part.setContent(data);
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        auto writePart = [&part, &buffer] {
+            buffer.seek(0);
+            part.write(&buffer);
+            return qsizetype(buffer.pos());
+        };
+
+        part.setEncoding(MimePart::Base64);
+        results.append(measure(QStringLiteral("MimePart::write(base64)"),
+                               corpus,
+                               data.size(),
+                               options,
+                               writePart));
+        part.setEncoding(MimePart::QuotedPrintable);
+        results.append(measure(QStringLiteral("MimePart::write(quoted-printable)"),
+                               corpus,
+                               data.size(),
+                               options,
+                               writePart));
+
+        if (corpus.text) {
+            // MimeMessagePrivate::encodeData() through the headers of a message,
+            // measured against the size of what is written
+            const MimeMessage message = headerMessage(corpus);
+            QBuffer headers;
+            headers.open(QIODevice::WriteOnly);
+            message.write(&headers);
+            const qsizetype headersSize = headers.pos();
+            results.append(measure(QStringLiteral("MimeMessage::write(headers)"),
+                                   corpus,
+                                   headersSize,
+                                   options,
+                                   [&message, &headers] {
+                headers.seek(0);
+                message.write(&headers);
+                return qsizetype(headers.pos());
+            }));
+        }
+    }
+
+    bool ok = true;
+    for (const auto &check : checks) {
+        ok = ok && check.toObject().value(QStringLiteral("ok")).toBool();
+    }
+
+    const QJsonObject root{
+        {QStringLiteral("benchmark"), QStringLiteral("encoders")},
+        {QStringLiteral("allocationsCounted"), AllocationCounter::isAvailable()},
+        {QStringLiteral("checksPassed"), ok},
+        {QStringLiteral("checks"), checks},
+        {QStringLiteral("results"), results},
+    };
+
+    QFile output;
+    if (parser.isSet(outputOption)) {
+        output.setFileName(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qCritical() << "Failed to open" << output.fileName() << output.errorString();
+            return 1;
+        }
+    } else if (!output.open(stdout, QIODevice::WriteOnly)) {
+        return 1;
+    }
+    output.write(QJsonDocument(root).toJson());
+
+    return ok ? 0 : 2;
+}
@@ -0,0 +1,396 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "allocationcounter.h"
+#include "mimeattachment.h"
+#include "mimehtml.h"
+#include "mimemessage.h"
+#include "mimemultipart.h"
+#include "mimetext.h"
+#include "server.h"
+#include "serverreply.h"
+#include "smtpsink.h"
+
+#include <functional>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QTimer>
+
+#ifdef Q_OS_UNIX
+#    include <sys/resource.h>
+#endif
+
+using namespace SimpleMail;
+
+struct Shape {
+    QString name;
+    MimeMessage (*build)();
+};
+
+static MimeMessage baseMessage(int recipients)
+{
+    MimeMessage message;
+    message.setSender(EmailAddress(QStringLiteral("bench@localhost"), QStringLiteral("Bench")));
+    for (int i = 0; i < recipients; ++i) {
+        message.addTo(EmailAddress(QStringLiteral("rcpt%1@localhost").arg(i),
+                                   QStringLiteral("Recipient %1").arg(i)));
+    }
+    message.setSubject(QStringLiteral("SimpleMail benchmark"));
+    return message;
+}
+
+static MimeMessage tinyMessage()
+{
+    MimeMessage message = baseMessage(1);
+    message.addPart(std::make_shared<MimeText>(QStringLiteral("Hello from the benchmark.\n")));
+    return message;
+}
+
+static MimeMessage htmlMessage()
+{
+    MimeMessage message = baseMessage(1);
+    auto alternative    = std::make_shared<MimeMultiPart>(MimeMultiPart::Alternative);
+
+    QString text = QStringLiteral("Newsletter\n");
+    QString html = QStringLiteral("<html><body><h1>Newsletter</h1>");
+    for (int i = 0; i < 20; ++i) {
+        text.append(QStringLiteral("Section %1, all the news of the week.\n").arg(i));
+        html.append(QStringLiteral("<p>Section %1, all the <b>news</b> of the week.</p>").arg(i));
+    }
+    alternative->addPart(std::make_shared<MimeText>(text));
+    alternative->addPart(std::make_shared<MimeHtml>(html + QStringLiteral("</body></html>")));
+    message.addPart(alternative);
+    return message;
+}
+
+static MimeMessage recipientsMessage()
+{
+    MimeMessage message = baseMessage(100);
+    message.addPart(std::make_shared<MimeText>(QStringLiteral("Hello everyone.\n")));
+    return message;
+}
+
+static qint64 procStatus(const QByteArray &field)
+{
+    // Linux only, in bytes, e.g. VmRSS or VmHWM
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+
+    const QByteArray prefix = field + ':';
+    for (const QByteArray &line : status.readAll().split('\n')) {
+        if (line.startsWith(prefix)) {
+            return line.mid(prefix.size()).simplified().split(' ').first().toLongLong() * 1024;
+        }
+    }
+    return -1;
+}
+
+static qint64 peakRss()
+{
+    const qint64 peak = procStatus("VmHWM");
+#ifdef Q_OS_UNIX
+    if (peak == -1) {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#    ifdef Q_OS_DARWIN
+            return usage.ru_maxrss;
+#    else
+            return qint64(usage.ru_maxrss) * 1024;
+#    endif
+        }
+    }
+#endif
+    return peak;
+}
+
+static bool resetPeakRss()
+{
+    // Writing 5 to clear_refs resets VmHWM to the current RSS
+    QFile clearRefs(QStringLiteral("/proc/self/clear_refs"));
+    return clearRefs.open(QIODevice::WriteOnly) && clearRefs.write("5") == 1;
+}
+
+class Sink
+{
+public:
+    explicit Sink(const SmtpSink::Options &options)
+        : m_sink(new SmtpSink(options))
+    {
+        m_sink->moveToThread(&m_thread);
+        QObject::connect(&m_thread, &QThread::finished, m_sink, &QObject::deleteLater);
+        m_thread.start();
+
+        m_port = m_sink->start();
+        if (m_port == 0) {
+            qFatal("Failed to listen on a loopback port");
+        }
+    }
+
+    ~Sink()
+    {
+        m_thread.quit();
+        m_thread.wait();
+    }
+
+    Server *createServer() const
+    {
+        auto server = new Server;
+        server->setHost(QStringLiteral("127.0.0.1"));
+        server->setPort(m_port);
+        return server;
+    }
+
+private:
+    QThread m_thread;
+    SmtpSink *m_sink;
+    quint16 m_port = 0;
+};
+
+static QJsonObject queueMessages(const Shape &shape, int messages, bool copies)
+{
+    // The greeting never comes, so everything stays queued
+    SmtpSink::Options options;
+    options.latency.insert("CONNECT", 24 * 3600 * 1000);
+    Sink sink(options);
+
+    Server *server             = sink.createServer();
+    const MimeMessage prebuilt = shape.build();
+    resetPeakRss();
+
+    // The first message connects, it isn't part of the steady state
+    server->sendMail(prebuilt);
+
+    const qint64 live         = AllocationCounter::liveBytes();
+    const quint64 allocations = AllocationCounter::threadAllocations();
+    for (int i = 1; i < messages; ++i) {
+        server->sendMail(copies ? prebuilt : shape.build());
+    }
+    const double count = qMax(1, messages - 1);
+    const double bytes = double(AllocationCounter::liveBytes() - live) / count;
+    const double calls = double(AllocationCounter::threadAllocations() - allocations) / count;
+    const qint64 rss   = peakRss();
+    delete server;
+
+    qInfo().noquote() << shape.name << (copies ? "copies" : "messages") << bytes
+                      << "bytes queued each";
+
+    return {
+        {QStringLiteral("shape"), shape.name},
+        {QStringLiteral("messages"), messages},
+        {QStringLiteral("copies"), copies},
+        {QStringLiteral("bytesPerMessage"), bytes},
+        {QStringLiteral("allocationsPerMessage"), calls},
+        {QStringLiteral("peakRssBytes"), double(rss)},
+    };
+}
+
+static bool sendAll(Server *server,
+                    const MimeMessage &message,
+                    int messages,
+                    int timeout,
+                    const std::function<void(int)> &onFinished)
+{
+    QEventLoop loop;
+    int finished  = 0;
+    bool timedOut = false;
+
+    std::function<void()> sendNext = [&] {
+        ServerReply *reply = server->sendMail(message);
+        QObject::connect(reply, &ServerReply::finished, &loop, [&, reply] {
+            reply->deleteLater();
+            onFinished(++finished);
+            if (finished == messages) {
+                loop.quit();
+            } else {
+                sendNext();
+            }
+        });
+    };
+
+    QTimer::singleShot(timeout * 1000, &loop, [&] {
+        timedOut = true;
+        loop.quit();
+    });
+
+    sendNext();
+    loop.exec();
+    return !timedOut;
+}
+
+static QJsonObject sendMessages(const Shape &shape, int messages, int timeout)
+{
+    Sink sink({});
+    Server *server = sink.createServer();
+
+    // Counted from the end of the first message, which connects
+    quint64 allocations       = 0;
+    const MimeMessage message = shape.build();
+
+    const bool ok = sendAll(server, message, messages + 1, timeout, [&allocations](int finished) {
+        if (finished == 1) {
+            allocations = AllocationCounter::threadAllocations();
+        }
+    });
+    const ServerMetrics metrics = server->metrics();
+    delete server;
+
+    const double calls = double(AllocationCounter::threadAllocations() - allocations) / messages;
+
+    qInfo().noquote() << shape.name << calls << "allocations per sent message";
+
+    return {
+        {QStringLiteral("shape"), shape.name},
+        {QStringLiteral("messages"), messages},
+        {QStringLiteral("ok"), ok && metrics.messagesFailed == 0},
+        {QStringLiteral("allocationsPerMessage"), calls},
+    };
+}
+
+static QJsonObject sendAttachment(qint64 size, int timeout)
+{
+    // Sparse, so creating it is instant and takes no disk space
+    QTemporaryFile file;
+    if (!file.open() || !file.resize(size)) {
+        qFatal("Failed to create the attachment file");
+    }
+
+    MimeMessage message = baseMessage(1);
+    message.addPart(std::make_shared<MimeText>(QStringLiteral("The payload is attached.\n")));
+    message.addPart(std::make_shared<MimeAttachment>(std::make_shared<QFile>(file.fileName())));
+
+    Sink sink({});
+    Server *server = sink.createServer();
+
+    const qint64 rss    = procStatus("VmRSS");
+    const bool resetRss = resetPeakRss();
+    const qint64 heap   = AllocationCounter::liveBytes();
+    AllocationCounter::resetPeakLiveBytes();
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok        = sendAll(server, message, 1, timeout, [](int) {});
+    const double seconds = double(timer.nsecsElapsed()) / 1e9;
+
+    const ServerMetrics metrics = server->metrics();
+    delete server;
+
+    qInfo().noquote() << size << "bytes attachment sent in" << seconds << "s";
+
+    return {
+        {QStringLiteral("attachmentBytes"), double(size)},
+        {QStringLiteral("ok"), ok && metrics.messagesSent == 1},
+        {QStringLiteral("seconds"), seconds},
+        {QStringLiteral("bytesWritten"), double(metrics.bytesWritten)},
+        {QStringLiteral("rssBeforeBytes"), double(rss)},
+        // Without clear_refs it is the peak of the whole run
+        {QStringLiteral("peakRssBytes"), double(peakRss())},
+        {QStringLiteral("peakRssReset"), resetRss},
+        {QStringLiteral("heapGrowthPeakBytes"),
+         double(AllocationCounter::peakLiveBytes() - heap)},
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("simplemail-bench-memory"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Measures the memory and heap allocations of queued, sent and huge "
+                       "messages against a local SMTP sink and prints them as JSON"));
+    parser.addHelpOption();
+
+    const QCommandLineOption queuedOption(QStringLiteral("queued"),
+                                          QStringLiteral("Messages queued of each shape."),
+                                          QStringLiteral("count"),
+                                          QStringLiteral("100000"));
+    const QCommandLineOption sentOption(QStringLiteral("sent"),
+                                        QStringLiteral("Messages sent of each shape."),
+                                        QStringLiteral("count"),
+                                        QStringLiteral("2000"));
+    const QCommandLineOption attachmentOption(
+        QStringLiteral("attachment-size"),
+        QStringLiteral("Megabytes of the attachment sent, 0 skips it."),
+        QStringLiteral("MB"),
+        QStringLiteral("1024"));
+    const QCommandLineOption timeoutOption(
+        QStringLiteral("timeout"),
+        QStringLiteral("Seconds sending may take before it is abandoned."),
+        QStringLiteral("seconds"),
+        QStringLiteral("600"));
+    const QCommandLineOption outputOption({QStringLiteral("o"), QStringLiteral("output")},
+                                          QStringLiteral("Write the JSON to a file."),
+                                          QStringLiteral("path"));
+    parser.addOptions({queuedOption, sentOption, attachmentOption, timeoutOption, outputOption});
+    parser.process(app);
+
+    const int queued  = qMax(2, parser.value(queuedOption).toInt());
+    const int sent    = qMax(1, parser.value(sentOption).toInt());
+    const int timeout = qMax(1, parser.value(timeoutOption).toInt());
+
+    const QList<Shape> shapes{
+        {QStringLiteral("tiny"), tinyMessage},
+        {QStringLiteral("html"), htmlMessage},
+        {QStringLiteral("recipients-100"), recipientsMessage},
+    };
+
+    // Copies share the message data, so they measure the ServerReplyContainer
+    // and ServerReply of each queued message, fresh messages add their parts
+    QJsonArray queue;
+    QJsonArray send;
+    for (const Shape &shape : shapes) {
+        queue.append(queueMessages(shape, queued, true));
+        queue.append(queueMessages(shape, queued, false));
+        send.append(sendMessages(shape, sent, timeout));
+    }
+
+    QJsonObject root{
+        {QStringLiteral("benchmark"), QStringLiteral("memory")},
+        {QStringLiteral("allocationsCounted"), AllocationCounter::isAvailable()},
+        {QStringLiteral("queued"), queue},
+        {QStringLiteral("sent"), send},
+    };
+
+    const qint64 attachmentSize = parser.value(attachmentOption).toLongLong() * 1024 * 1024;
+    if (attachmentSize > 0) {
+        root.insert(QStringLiteral("attachment"), sendAttachment(attachmentSize, timeout));
+    }
+
+    QFile output;
+    if (parser.isSet(outputOption)) {
+        output.setFileName(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qCritical() << "Failed to open" << output.fileName() << output.errorString();
+            return 1;
+        }
+    } else if (!output.open(stdout, QIODevice::WriteOnly)) {
+        return 1;
+    }
+    output.write(QJsonDocument(root).toJson());
+
+    return 0;
+}
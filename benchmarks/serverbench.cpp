@@ -0,0 +1,396 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "mimeattachment.h"
+#include "mimehtml.h"
+#include "mimeinlinefile.h"
+#include "mimemessage.h"
+#include "mimemultipart.h"
+#include "mimetext.h"
+#include "server.h"
+#include "serverreply.h"
+#include "smtpsink.h"
+
+#include <functional>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QThread>
+#include <QTimer>
+
+using namespace SimpleMail;
+
+struct Shape {
+    QString name;
+    int messages; // Sent with the default scale
+    MimeMessage (*build)();
+};
+
+static QByteArray randomBytes(qsizetype size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    QRandomGenerator generator(quint32(size));
+    for (qsizetype i = 0; i < size; ++i) {
+        data[i] = char(generator.bounded(256));
+    }
+    return data;
+}
+
+static MimeMessage baseMessage(int recipients)
+{
+    MimeMessage message;
+    message.setSender(EmailAddress(QStringLiteral("bench@localhost"), QStringLiteral("Bench")));
+    for (int i = 0; i < recipients; ++i) {
+        message.addTo(EmailAddress(QStringLiteral("rcpt%1@localhost").arg(i),
+                                   QStringLiteral("Recipient %1").arg(i)));
+    }
+    message.setSubject(QStringLiteral("SimpleMail benchmark"));
+    return message;
+}
+
+static MimeMessage tinyMessage()
+{
+    MimeMessage message = baseMessage(1);
+    message.addPart(std::make_shared<MimeText>(QStringLiteral("Hello from the benchmark.\n")));
+    return message;
+}
+
+static MimeMessage htmlMessage()
+{
+    MimeMessage message = baseMessage(1);
+    auto related        = std::make_shared<MimeMultiPart>(MimeMultiPart::Related);
+
+    QString html = QStringLiteral("<html><body><h1>Newsletter</h1>");
+    for (int i = 0; i < 4; ++i) {
+        html.append(QStringLiteral("<p>Section %1</p><img src=\"cid:image%1\">").arg(i));
+    }
+    related->addPart(std::make_shared<MimeHtml>(html + QStringLiteral("</body></html>")));
+
+    for (int i = 0; i < 4; ++i) {
+        auto image = std::make_shared<MimeInlineFile>(randomBytes(32 * 1024),
+                                                      QStringLiteral("image%1.png").arg(i),
+                                                      QByteArrayLiteral("image/png"));
+        image->setContentId("image" + QByteArray::number(i));
+        related->addPart(image);
+    }
+    message.addPart(related);
+    return message;
+}
+
+static MimeMessage attachmentMessage()
+{
+    MimeMessage message = baseMessage(1);
+    message.addPart(std::make_shared<MimeText>(QStringLiteral("The payload is attached.\n")));
+    message.addPart(std::make_shared<MimeAttachment>(randomBytes(50 * 1024 * 1024),
+                                                     QStringLiteral("payload.bin")));
+    return message;
+}
+
+static MimeMessage recipientsMessage()
+{
+    MimeMessage message = baseMessage(1000);
+    message.addPart(std::make_shared<MimeText>(QStringLiteral("Hello everyone.\n")));
+    return message;
+}
+
+static const QList<Shape> &shapes()
+{
+    static const QList<Shape> shapes{
+        {QStringLiteral("tiny"), 2000, tinyMessage},
+        {QStringLiteral("html-inline"), 500, htmlMessage},
+        {QStringLiteral("attachment-50mb"), 4, attachmentMessage},
+        {QStringLiteral("recipients-1000"), 50, recipientsMessage},
+    };
+    return shapes;
+}
+
+static QHash<QByteArray, QString> parseVerbs(const QStringList &values)
+{
+    // VERB=value, e.g. RCPT=5
+    QHash<QByteArray, QString> ret;
+    for (const QString &value : values) {
+        const int sep = value.indexOf(QLatin1Char('='));
+        if (sep > 0) {
+            ret.insert(value.left(sep).toUpper().toLatin1(), value.mid(sep + 1));
+        }
+    }
+    return ret;
+}
+
+struct Run {
+    int connections;
+    int window;
+    int timeout;
+    bool ioUring;
+};
+
+static QJsonObject runScenario(const Shape &shape,
+                               int messages,
+                               const SmtpSink::Options &options,
+                               const Run &run)
+{
+    QThread thread;
+    auto sink = new SmtpSink(options);
+    sink->moveToThread(&thread);
+    QObject::connect(&thread, &QThread::finished, sink, &QObject::deleteLater);
+    thread.start();
+
+    const quint16 port = sink->start();
+    if (port == 0) {
+        qFatal("Failed to listen on a loopback port");
+    }
+
+    const MimeMessage message = shape.build();
+
+    QList<Server *> servers;
+    for (int i = 0; i < run.connections; ++i) {
+        auto server = new Server;
+        server->setHost(QStringLiteral("127.0.0.1"));
+        server->setPort(port);
+        server->setIoUringEnabled(run.ioUring);
+        servers.append(server);
+    }
+
+    QEventLoop loop;
+    int queued    = 0;
+    int finished  = 0;
+    int failed    = 0;
+    bool timedOut = false;
+
+    // Each server keeps a window of messages queued, so the latency of a
+    // message is mostly its transaction and not the time waiting behind others
+    std::function<void(Server *)> sendNext = [&](Server *server) {
+        if (queued == messages) {
+            return;
+        }
+        ++queued;
+
+        ServerReply *reply = server->sendMail(message);
+        QObject::connect(reply, &ServerReply::finished, &loop, [&, reply, server] {
+            if (reply->error()) {
+                ++failed;
+            }
+            reply->deleteLater();
+
+            if (++finished == messages) {
+                loop.quit();
+            } else {
+                sendNext(server);
+            }
+        });
+    };
+
+    QTimer::singleShot(run.timeout * 1000, &loop, [&] {
+        timedOut = true;
+        loop.quit();
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < run.window; ++i) {
+        for (Server *server : servers) {
+            sendNext(server);
+        }
+    }
+    loop.exec();
+    const double seconds = double(timer.nsecsElapsed()) / 1e9;
+
+    ServerMetrics metrics;
+    LatencyHistogram latency;
+    for (Server *server : servers) {
+        metrics += server->metrics();
+        latency.merge(server->latencyHistogram(ServerReply::Queued));
+    }
+    qDeleteAll(servers);
+
+    thread.quit();
+    thread.wait();
+
+    QJsonObject ret{
+        {QStringLiteral("shape"), shape.name},
+        {QStringLiteral("pipelining"), options.pipelining},
+        {QStringLiteral("connections"), run.connections},
+        {QStringLiteral("window"), run.window},
+        {QStringLiteral("ioUring"), run.ioUring},
+        {QStringLiteral("messages"), finished},
+        {QStringLiteral("failed"), failed},
+        {QStringLiteral("timedOut"), timedOut},
+        {QStringLiteral("seconds"), seconds},
+        {QStringLiteral("messagesPerSecond"), double(metrics.messagesSent) / seconds},
+        {QStringLiteral("bytesPerSecond"), double(metrics.bytesWritten) / seconds},
+        {QStringLiteral("bytesWritten"), double(metrics.bytesWritten)},
+        {QStringLiteral("replies4xx"), double(metrics.replies4xx)},
+        {QStringLiteral("replies5xx"), double(metrics.replies5xx)},
+        {QStringLiteral("connects"), double(metrics.connects)},
+        {QStringLiteral("latencyUsec"),
+         QJsonObject{
+             {QStringLiteral("mean"), double(latency.mean())},
+             {QStringLiteral("p50"), double(latency.p50())},
+             {QStringLiteral("p99"), double(latency.p99())},
+             {QStringLiteral("p999"), double(latency.p999())},
+             {QStringLiteral("max"), double(latency.max())},
+         }},
+    };
+
+    qInfo().noquote() << shape.name << (options.pipelining ? "pipelining" : "no pipelining")
+                      << finished << "messages in" << seconds << "s";
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("simplemail-bench-server"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Measures Server throughput and latency against a local SMTP sink "
+                       "and prints the results as JSON"));
+    parser.addHelpOption();
+
+    const QCommandLineOption shapeOption(
+        QStringLiteral("shape"),
+        QStringLiteral("Message shape to run, repeat it for several, all by default: tiny, "
+                       "html-inline, attachment-50mb and recipients-1000."),
+        QStringLiteral("name"));
+    const QCommandLineOption scaleOption(
+        QStringLiteral("scale"),
+        QStringLiteral("Multiplies the number of messages sent of each shape."),
+        QStringLiteral("factor"),
+        QStringLiteral("1"));
+    const QCommandLineOption pipeliningOption(
+        QStringLiteral("pipelining"),
+        QStringLiteral("Whether the sink announces PIPELINING: on, off or both."),
+        QStringLiteral("mode"),
+        QStringLiteral("both"));
+    const QCommandLineOption connectionsOption(
+        {QStringLiteral("c"), QStringLiteral("connections")},
+        QStringLiteral("Number of Server connections sending at once."),
+        QStringLiteral("count"),
+        QStringLiteral("1"));
+    const QCommandLineOption windowOption(QStringLiteral("window"),
+                                          QStringLiteral("Messages queued on each connection."),
+                                          QStringLiteral("count"),
+                                          QStringLiteral("1"));
+    const QCommandLineOption latencyOption(
+        QStringLiteral("latency"),
+        QStringLiteral("Milliseconds the sink waits before replying to a verb, e.g. RCPT=5, "
+                       "CONNECT is the greeting and DATA the final reply of a message."),
+        QStringLiteral("verb=msec"));
+    const QCommandLineOption errorRateOption(
+        QStringLiteral("error-rate"),
+        QStringLiteral("Ratio of 451 replies the sink gives to a verb, e.g. DATA=0.01."),
+        QStringLiteral("verb=ratio"));
+    const QCommandLineOption maxSizeOption(
+        QStringLiteral("max-size"),
+        QStringLiteral("Message size limit the sink announces with SIZE, 0 disables it."),
+        QStringLiteral("bytes"),
+        QStringLiteral("104857600"));
+    const QCommandLineOption noChunkingOption(
+        QStringLiteral("no-chunking"), QStringLiteral("Do not announce CHUNKING from the sink."));
+    const QCommandLineOption ioUringOption(
+        QStringLiteral("io-uring"),
+        QStringLiteral("Send through the io_uring transport when available."));
+    const QCommandLineOption timeoutOption(
+        QStringLiteral("timeout"),
+        QStringLiteral("Seconds a scenario may run before it is abandoned."),
+        QStringLiteral("seconds"),
+        QStringLiteral("600"));
+    const QCommandLineOption outputOption({QStringLiteral("o"), QStringLiteral("output")},
+                                          QStringLiteral("Write the JSON to a file."),
+                                          QStringLiteral("path"));
+    parser.addOptions({shapeOption,
+                       scaleOption,
+                       pipeliningOption,
+                       connectionsOption,
+                       windowOption,
+                       latencyOption,
+                       errorRateOption,
+                       maxSizeOption,
+                       noChunkingOption,
+                       ioUringOption,
+                       timeoutOption,
+                       outputOption});
+    parser.process(app);
+
+    SmtpSink::Options options;
+    options.chunking = !parser.isSet(noChunkingOption);
+    options.maxSize  = parser.value(maxSizeOption).toLongLong();
+
+    const auto latencies = parseVerbs(parser.values(latencyOption));
+    for (auto it = latencies.cbegin(); it != latencies.cend(); ++it) {
+        options.latency.insert(it.key(), it.value().toInt());
+    }
+    const auto errorRates = parseVerbs(parser.values(errorRateOption));
+    for (auto it = errorRates.cbegin(); it != errorRates.cend(); ++it) {
+        options.errorRate.insert(it.key(), it.value().toDouble());
+    }
+
+    const QString pipelining = parser.value(pipeliningOption);
+    QList<bool> pipeliningModes;
+    if (pipelining != QLatin1String("off")) {
+        pipeliningModes.append(true);
+    }
+    if (pipelining != QLatin1String("on")) {
+        pipeliningModes.append(false);
+    }
+
+    Run run;
+    run.connections = qMax(1, parser.value(connectionsOption).toInt());
+    run.window      = qMax(1, parser.value(windowOption).toInt());
+    run.timeout     = qMax(1, parser.value(timeoutOption).toInt());
+    run.ioUring     = parser.isSet(ioUringOption);
+
+    const double scale         = parser.value(scaleOption).toDouble();
+    const QStringList selected = parser.values(shapeOption);
+    QJsonArray results;
+    for (const Shape &shape : shapes()) {
+        if (!selected.isEmpty() && !selected.contains(shape.name)) {
+            continue;
+        }
+
+        const int messages = qMax(1, int(shape.messages * scale));
+        for (bool mode : pipeliningModes) {
+            options.pipelining = mode;
+            results.append(runScenario(shape, messages, options, run));
+        }
+    }
+
+    const QJsonObject root{
+        {QStringLiteral("benchmark"), QStringLiteral("server")},
+        {QStringLiteral("results"), results},
+    };
+
+    QFile output;
+    if (parser.isSet(outputOption)) {
+        output.setFileName(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qCritical() << "Failed to open" << output.fileName() << output.errorString();
+            return 1;
+        }
+    } else if (!output.open(stdout, QIODevice::WriteOnly)) {
+        return 1;
+    }
+    output.write(QJsonDocument(root).toJson());
+
+    return 0;
+}
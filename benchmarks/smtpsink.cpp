@@ -0,0 +1,366 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "smtpsink.h"
+
+#include <deque>
+
+#include <QDeadlineTimer>
+#include <QRandomGenerator>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+
+namespace {
+
+/**
+ * The server side of a single connection, replies are queued in order so
+ * a delayed reply also holds back the ones pipelined after it
+ */
+class SinkSession : public QObject
+{
+public:
+    SinkSession(QTcpSocket *socket, SmtpSink *sink);
+
+private:
+    enum State {
+        Command,
+        Data,
+        Chunk,
+    };
+
+    struct Pending {
+        qint64 due;
+        QByteArray data;
+    };
+
+    void readyRead();
+    void processLine(const QByteArray &line);
+    bool processData();
+    bool processChunk();
+    void finishMessage(const QByteArray &verb);
+    bool injectError(const QByteArray &verb) const;
+    void reply(const QByteArray &verb, const QByteArray &line);
+    void flush();
+    void resetTransaction();
+
+    QTcpSocket *m_socket;
+    SmtpSink *m_sink;
+    QByteArray m_buffer;
+    QByteArray m_tail;
+    std::deque<Pending> m_pending;
+    QTimer m_timer;
+    qint64 m_dataSize  = 0;
+    qint64 m_chunkLeft = 0;
+    int m_recipients   = 0;
+    State m_state      = Command;
+    bool m_hasSender   = false;
+    bool m_lastChunk   = false;
+    bool m_closing     = false;
+};
+
+SinkSession::SinkSession(QTcpSocket *socket, SmtpSink *sink)
+    : QObject(sink)
+    , m_socket(socket)
+    , m_sink(sink)
+{
+    m_socket->setParent(this);
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &SinkSession::flush);
+    connect(m_socket, &QTcpSocket::readyRead, this, &SinkSession::readyRead);
+    connect(m_socket, &QTcpSocket::disconnected, this, &SinkSession::deleteLater);
+
+    reply("CONNECT", "220 localhost ESMTP simplemail-bench sink");
+}
+
+void SinkSession::readyRead()
+{
+    m_buffer.append(m_socket->readAll());
+
+    while (!m_buffer.isEmpty()) {
+        if (m_state == Data) {
+            if (!processData()) {
+                return;
+            }
+            continue;
+        }
+
+        if (m_state == Chunk) {
+            if (!processChunk()) {
+                return;
+            }
+            continue;
+        }
+
+        const auto end = m_buffer.indexOf('\n');
+        if (end == -1) {
+            if (m_buffer.size() > 4096) {
+                reply("", "500 5.5.2 Line too long");
+                m_buffer.clear();
+            }
+            return;
+        }
+
+        const QByteArray line = m_buffer.left(end + 1).trimmed();
+        m_buffer.remove(0, end + 1);
+        processLine(line);
+    }
+}
+
+void SinkSession::processLine(const QByteArray &line)
+{
+    const QByteArray verb = line.left(4).toUpper();
+    if (verb == "EHLO" || verb == "HELO") {
+        resetTransaction();
+        if (verb == "HELO") {
+            reply(verb, "250 localhost");
+            return;
+        }
+
+        const SmtpSink::Options &options = m_sink->options();
+        QByteArray lines                 = "250-localhost\r\n";
+        if (options.pipelining) {
+            lines.append("250-PIPELINING\r\n");
+        }
+        if (options.chunking) {
+            lines.append("250-CHUNKING\r\n");
+        }
+        if (options.maxSize > 0) {
+            lines.append("250-SIZE " + QByteArray::number(options.maxSize) + "\r\n");
+        }
+        lines.append("250-ENHANCEDSTATUSCODES\r\n250 8BITMIME");
+        reply(verb, lines);
+    } else if (verb == "MAIL") {
+        if (m_hasSender) {
+            reply(verb, "503 5.5.1 Sender already specified");
+            return;
+        }
+
+        const qint64 maxSize = m_sink->options().maxSize;
+        const auto size      = line.toUpper().indexOf(" SIZE=");
+        if (maxSize > 0 && size != -1 &&
+            line.mid(size + 6).split(' ').first().toLongLong() > maxSize) {
+            reply(verb, "552 5.3.4 Message size exceeds fixed maximum message size");
+            return;
+        }
+
+        if (injectError(verb)) {
+            reply(verb, "451 4.3.0 Injected failure");
+            return;
+        }
+
+        m_hasSender = true;
+        reply(verb, "250 2.1.0 Ok");
+    } else if (verb == "RCPT") {
+        if (!m_hasSender) {
+            reply(verb, "503 5.5.1 Need MAIL command");
+            return;
+        }
+
+        if (injectError(verb)) {
+            reply(verb, "451 4.3.0 Injected failure");
+            return;
+        }
+
+        ++m_recipients;
+        reply(verb, "250 2.1.5 Ok");
+    } else if (verb == "DATA") {
+        if (m_recipients == 0) {
+            reply(verb, "554 5.5.1 No valid recipients");
+            return;
+        }
+
+        // The line break ending DATA counts for a terminator at the very start
+        reply("", "354 End data with <CR><LF>.<CR><LF>");
+        m_state    = Data;
+        m_tail     = "\r\n";
+        m_dataSize = 0;
+    } else if (verb == "BDAT") {
+        const QList<QByteArray> args = line.split(' ');
+        if (!m_sink->options().chunking || args.size() < 2) {
+            reply(verb, "500 5.5.2 Command unrecognized");
+            return;
+        }
+
+        m_state     = Chunk;
+        m_chunkLeft = args.at(1).toLongLong();
+        m_lastChunk = args.size() > 2 && args.at(2).toUpper() == "LAST";
+        if (m_chunkLeft == 0) {
+            processChunk();
+        }
+    } else if (verb == "RSET") {
+        resetTransaction();
+        reply(verb, "250 2.0.0 Ok");
+    } else if (verb == "NOOP") {
+        reply(verb, "250 2.0.0 Ok");
+    } else if (verb == "QUIT") {
+        reply(verb, "221 2.0.0 Bye");
+        m_closing = true;
+        flush();
+    } else {
+        reply(verb, "500 5.5.2 Command unrecognized");
+    }
+}
+
+bool SinkSession::processData()
+{
+    // The terminator may be split between reads, only its possible start is kept
+    qsizetype end         = -1;
+    const QByteArray edge = m_tail + m_buffer.left(4);
+    const auto edgePos    = edge.indexOf("\r\n.\r\n");
+    if (edgePos != -1 && edgePos < m_tail.size()) {
+        end = edgePos + 5 - m_tail.size();
+    } else {
+        const auto pos = m_buffer.indexOf("\r\n.\r\n");
+        if (pos != -1) {
+            end = pos + 5;
+        }
+    }
+
+    if (end == -1) {
+        m_dataSize += m_buffer.size();
+        m_tail = (m_tail + m_buffer.right(4)).right(4);
+        m_buffer.clear();
+        return false;
+    }
+
+    m_dataSize += end;
+    m_buffer.remove(0, end);
+    m_state = Command;
+    finishMessage("DATA");
+    return true;
+}
+
+bool SinkSession::processChunk()
+{
+    const qint64 size = qMin<qint64>(m_chunkLeft, m_buffer.size());
+    m_buffer.remove(0, size);
+    m_chunkLeft -= size;
+    m_dataSize += size;
+    if (m_chunkLeft > 0) {
+        return false;
+    }
+
+    m_state = Command;
+    if (m_lastChunk) {
+        finishMessage("BDAT");
+    } else {
+        reply("BDAT", "250 2.0.0 Chunk accepted");
+    }
+    return true;
+}
+
+void SinkSession::finishMessage(const QByteArray &verb)
+{
+    const qint64 maxSize = m_sink->options().maxSize;
+    if (maxSize > 0 && m_dataSize > maxSize) {
+        reply(verb, "552 5.3.4 Message size exceeds fixed maximum message size");
+    } else if (injectError(verb)) {
+        reply(verb, "451 4.3.0 Injected failure");
+    } else {
+        m_sink->addMessage(m_dataSize);
+        reply(verb, "250 2.0.0 Ok: queued");
+    }
+    resetTransaction();
+}
+
+bool SinkSession::injectError(const QByteArray &verb) const
+{
+    const double rate = m_sink->options().errorRate.value(verb);
+    return rate > 0 && QRandomGenerator::global()->generateDouble() < rate;
+}
+
+void SinkSession::reply(const QByteArray &verb, const QByteArray &line)
+{
+    const int delay = m_sink->options().latency.value(verb);
+    if (delay <= 0 && m_pending.empty()) {
+        m_socket->write(line + "\r\n");
+        return;
+    }
+
+    const qint64 now = QDeadlineTimer::current().deadline();
+    const qint64 due = qMax(m_pending.empty() ? 0 : m_pending.back().due, now + delay);
+    m_pending.push_back({due, line + "\r\n"});
+    if (!m_timer.isActive()) {
+        m_timer.start(int(m_pending.front().due - now));
+    }
+}
+
+void SinkSession::flush()
+{
+    const qint64 now = QDeadlineTimer::current().deadline();
+    while (!m_pending.empty() && m_pending.front().due <= now) {
+        m_socket->write(m_pending.front().data);
+        m_pending.pop_front();
+    }
+
+    if (!m_pending.empty()) {
+        m_timer.start(int(m_pending.front().due - now));
+    } else if (m_closing) {
+        m_socket->disconnectFromHost();
+    }
+}
+
+void SinkSession::resetTransaction()
+{
+    m_hasSender  = false;
+    m_recipients = 0;
+    m_dataSize   = 0;
+}
+
+} // namespace
+
+SmtpSink::SmtpSink(const Options &options, QObject *parent)
+    : QTcpServer(parent)
+    , m_options(options)
+{
+}
+
+SmtpSink::~SmtpSink() = default;
+
+quint16 SmtpSink::start()
+{
+    quint16 port    = 0;
+    const auto type = thread() == QThread::currentThread() ? Qt::DirectConnection
+                                                           : Qt::BlockingQueuedConnection;
+    QMetaObject::invokeMethod(
+        this,
+        [this, &port] {
+        if (listen(QHostAddress::LocalHost)) {
+            port = serverPort();
+        }
+    },
+        type);
+    return port;
+}
+
+void SmtpSink::addMessage(qint64 size)
+{
+    m_messages.fetch_add(1, std::memory_order_relaxed);
+    m_bytes.fetch_add(quint64(size), std::memory_order_relaxed);
+}
+
+void SmtpSink::incomingConnection(qintptr socketDescriptor)
+{
+    auto socket = new QTcpSocket;
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        delete socket;
+        return;
+    }
+
+    new SinkSession(socket, this);
+}
+
+#include "moc_smtpsink.cpp"
@@ -0,0 +1,66 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#pragma once
+
+#include <atomic>
+
+#include <QHash>
+#include <QTcpServer>
+
+/**
+ * SmtpSink accepts and discards mail on a local TCP port, it is meant to
+ * run on its own thread so the client being measured has the one it is on.
+ * The data is scanned but never buffered, so huge messages cost no memory.
+ */
+class SmtpSink : public QTcpServer
+{
+    Q_OBJECT
+public:
+    struct Options {
+        bool pipelining = true;
+        bool chunking   = true;
+        qint64 maxSize  = 0; // Announced with SIZE and enforced when not 0
+
+        // Delay in milliseconds and ratio of 451 replies for a verb, the
+        // final reply of a message uses the DATA or BDAT verb
+        QHash<QByteArray, int> latency;
+        QHash<QByteArray, double> errorRate;
+    };
+
+    explicit SmtpSink(const Options &options, QObject *parent = nullptr);
+    ~SmtpSink();
+
+    /**
+     * Listens on a loopback port from the thread the sink lives in,
+     * returns the port or 0 on failure
+     */
+    quint16 start();
+
+    inline const Options &options() const { return m_options; }
+
+    inline quint64 messages() const { return m_messages.load(std::memory_order_relaxed); }
+    inline quint64 bytes() const { return m_bytes.load(std::memory_order_relaxed); }
+
+    void addMessage(qint64 size);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    Options m_options;
+    std::atomic<quint64> m_messages{0};
+    std::atomic<quint64> m_bytes{0};
+};
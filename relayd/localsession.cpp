@@ -0,0 +1,256 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "localsession.h"
+
+#include <QLocalSocket>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(RELAYD)
+
+static bool parsePath(const QByteArray &line, const char *prefix, QByteArray &address)
+{
+    const int prefixSize = int(qstrlen(prefix));
+    if (line.size() < prefixSize || qstrnicmp(line.constData(), prefix, prefixSize) != 0) {
+        return false;
+    }
+
+    const auto start = line.indexOf('<', prefixSize);
+    if (start == -1) {
+        return false;
+    }
+
+    const auto end = line.indexOf('>', start);
+    if (end == -1) {
+        return false;
+    }
+
+    address = line.mid(start + 1, end - start - 1);
+    return true;
+}
+
+LocalSession::LocalSession(QLocalSocket *socket, Relay *relay, Protocol protocol, QObject *parent)
+    : QObject(parent)
+    , m_socket(socket)
+    , m_relay(relay)
+    , m_protocol(protocol)
+{
+    m_socket->setParent(this);
+    connect(m_socket, &QLocalSocket::readyRead, this, &LocalSession::readyRead);
+    connect(m_socket, &QLocalSocket::disconnected, this, &LocalSession::deleteLater);
+}
+
+LocalSession::~LocalSession() = default;
+
+void LocalSession::setHostname(const QByteArray &hostname)
+{
+    m_hostname = hostname;
+}
+
+void LocalSession::setMaxMessageSize(qint64 size)
+{
+    m_maxMessageSize = size;
+}
+
+void LocalSession::start()
+{
+    reply("220 " + m_hostname + (m_protocol == Lmtp ? " LMTP" : " ESMTP") +
+          " simplemail-relayd ready");
+    m_state = Ready;
+}
+
+void LocalSession::readyRead()
+{
+    m_buffer.append(m_socket->readAll());
+
+    // Clients may pipeline commands and DATA, so consume everything we have
+    while (!m_buffer.isEmpty()) {
+        if (m_state == ReadingData) {
+            processData();
+            if (m_state == ReadingData) {
+                return;
+            }
+            continue;
+        }
+
+        const auto end = m_buffer.indexOf('\n');
+        if (end == -1) {
+            if (m_buffer.size() > 4096) {
+                reply("500 5.5.2 Line too long");
+                m_buffer.clear();
+            }
+            return;
+        }
+
+        const QByteArray line = m_buffer.left(end + 1).trimmed();
+        m_buffer.remove(0, end + 1);
+        processLine(line);
+    }
+}
+
+void LocalSession::processLine(const QByteArray &line)
+{
+    qCDebug(RELAYD) << "Got command" << line;
+
+    const QByteArray verb = line.left(4).toUpper();
+    if (verb == "EHLO" || verb == "HELO" || verb == "LHLO") {
+        if ((verb == "LHLO") != (m_protocol == Lmtp)) {
+            reply(m_protocol == Lmtp ? "500 5.5.1 Use LHLO" : "500 5.5.1 Use EHLO");
+            return;
+        }
+
+        resetTransaction();
+        if (verb == "HELO") {
+            reply("250 " + m_hostname);
+            return;
+        }
+
+        reply("250-" + m_hostname);
+        // No 8BITMIME, messages are relayed as received and can't be downconverted
+        // for an upstream that doesn't support it
+        reply("250-PIPELINING");
+        reply("250-ENHANCEDSTATUSCODES");
+        reply("250 SIZE " + QByteArray::number(m_maxMessageSize));
+    } else if (verb == "MAIL") {
+        if (m_hasSender) {
+            reply("503 5.5.1 Sender already specified");
+            return;
+        }
+
+        QByteArray address;
+        if (!parsePath(line, "MAIL FROM:", address)) {
+            reply("501 5.5.4 Syntax: MAIL FROM:<address>");
+            return;
+        }
+
+        const auto size = line.toUpper().indexOf(" SIZE=");
+        if (size != -1 && line.mid(size + 6).split(' ').first().toLongLong() > m_maxMessageSize) {
+            reply("552 5.3.4 Message size exceeds fixed maximum message size");
+            return;
+        }
+
+        m_envelope.sender = QString::fromUtf8(address);
+        m_hasSender       = true;
+        reply("250 2.1.0 Ok");
+    } else if (verb == "RCPT") {
+        if (!m_hasSender) {
+            reply("503 5.5.1 Need MAIL command");
+            return;
+        }
+
+        QByteArray address;
+        if (!parsePath(line, "RCPT TO:", address) || address.isEmpty()) {
+            reply("501 5.5.4 Syntax: RCPT TO:<address>");
+            return;
+        }
+
+        m_envelope.recipients.append(QString::fromUtf8(address));
+        reply("250 2.1.5 Ok");
+    } else if (verb == "DATA") {
+        if (m_envelope.recipients.isEmpty()) {
+            reply("554 5.5.1 No valid recipients");
+            return;
+        }
+
+        reply("354 End data with <CR><LF>.<CR><LF>");
+        m_state = ReadingData;
+    } else if (verb == "RSET") {
+        resetTransaction();
+        reply("250 2.0.0 Ok");
+    } else if (verb == "NOOP") {
+        reply("250 2.0.0 Ok");
+    } else if (verb == "VRFY") {
+        reply("252 2.5.0 Cannot VRFY user");
+    } else if (verb == "QUIT") {
+        reply("221 2.0.0 Bye");
+        m_socket->disconnectFromServer();
+    } else {
+        reply("500 5.5.2 Command unrecognized");
+    }
+}
+
+void LocalSession::processData()
+{
+    // The data is kept dot-stuffed as the upstream server needs it that way
+    m_data.append(m_buffer);
+    m_buffer.clear();
+
+    qsizetype end = -1;
+    if (!m_tooLarge && m_data.startsWith(".\r\n")) {
+        end = 0;
+    } else {
+        const auto pos = m_data.indexOf("\r\n.\r\n", int(qMax<qint64>(0, m_scanned - 4)));
+        if (pos != -1) {
+            end = pos + 2;
+        }
+    }
+
+    if (end == -1) {
+        if (m_data.size() > m_maxMessageSize) {
+            // Keep reading until the terminator but stop buffering
+            m_tooLarge = true;
+        }
+
+        if (m_tooLarge) {
+            m_data = m_data.right(4);
+        }
+        m_scanned = m_data.size();
+        return;
+    }
+
+    m_buffer = m_data.mid(end + 3);
+    m_data.truncate(qMax<qsizetype>(0, end - 2));
+    m_state   = Ready;
+    m_scanned = 0;
+
+    QByteArray result;
+    if (m_tooLarge) {
+        result = "552 5.3.4 Message size exceeds fixed maximum message size";
+    } else {
+        m_envelope.data = m_data;
+        if (m_relay->submit(m_envelope)) {
+            result = "250 2.0.0 Queued";
+        } else {
+            result = "451 4.3.0 Queueing failed, try again later";
+        }
+    }
+
+    if (m_protocol == Lmtp) {
+        // LMTP wants one final reply for each accepted recipient
+        for (int i = 0; i < m_envelope.recipients.size(); ++i) {
+            reply(result);
+        }
+    } else {
+        reply(result);
+    }
+
+    resetTransaction();
+}
+
+void LocalSession::reply(const QByteArray &line)
+{
+    m_socket->write(line + "\r\n");
+}
+
+void LocalSession::resetTransaction()
+{
+    m_envelope  = Relay::Envelope();
+    m_hasSender = false;
+    m_tooLarge  = false;
+    m_scanned   = 0;
+    m_data.clear();
+}
+
+#include "moc_localsession.cpp"
@@ -0,0 +1,70 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#pragma once
+
+#include "relay.h"
+
+#include <QObject>
+
+class QLocalSocket;
+
+/**
+ * LocalSession speaks the server side of SMTP or LMTP with a single
+ * local client, accepted messages are handed to the Relay.
+ */
+class LocalSession : public QObject
+{
+    Q_OBJECT
+public:
+    enum Protocol {
+        Smtp,
+        Lmtp,
+    };
+
+    LocalSession(QLocalSocket *socket, Relay *relay, Protocol protocol, QObject *parent = nullptr);
+    ~LocalSession();
+
+    void setHostname(const QByteArray &hostname);
+    void setMaxMessageSize(qint64 size);
+
+    void start();
+
+private:
+    enum State {
+        Greeting,
+        Ready,
+        ReadingData,
+    };
+
+    void readyRead();
+    void processLine(const QByteArray &line);
+    void processData();
+    void reply(const QByteArray &line);
+    void resetTransaction();
+
+    QLocalSocket *m_socket;
+    Relay *m_relay;
+    QByteArray m_hostname;
+    QByteArray m_buffer;
+    QByteArray m_data;
+    Relay::Envelope m_envelope;
+    qint64 m_maxMessageSize = 50 * 1024 * 1024;
+    qint64 m_scanned        = 0;
+    Protocol m_protocol;
+    State m_state    = Greeting;
+    bool m_hasSender = false;
+    bool m_tooLarge  = false;
+};
@@ -0,0 +1,222 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "localsession.h"
+#include "ratelimiter.h"
+#include "relay.h"
+#include "server.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QHostInfo>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(RELAYD)
+
+using namespace SimpleMail;
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("simplemail-relayd"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Accepts mail from local clients on a local socket and relays it "
+                       "through persistent upstream SMTP connections"));
+    parser.addHelpOption();
+
+    const QCommandLineOption socketOption(
+        {QStringLiteral("s"), QStringLiteral("socket")},
+        QStringLiteral("Local socket name or path to listen on."),
+        QStringLiteral("path"),
+        QStringLiteral("simplemail-relayd"));
+    const QCommandLineOption lmtpOption(QStringLiteral("lmtp"),
+                                        QStringLiteral("Speak LMTP instead of SMTP to clients."));
+    const QCommandLineOption hostOption(
+        {QStringLiteral("H"), QStringLiteral("host")},
+        QStringLiteral("Upstream SMTP server as host or host:port, repeat it for failover."),
+        QStringLiteral("host"),
+        QStringLiteral("localhost"));
+    const QCommandLineOption portOption({QStringLiteral("p"), QStringLiteral("port")},
+                                        QStringLiteral("Upstream SMTP port."),
+                                        QStringLiteral("port"),
+                                        QStringLiteral("25"));
+    const QCommandLineOption sslOption(QStringLiteral("ssl"),
+                                       QStringLiteral("Use implicit TLS with the upstream."));
+    const QCommandLineOption startTlsOption(QStringLiteral("starttls"),
+                                            QStringLiteral("Use STARTTLS with the upstream."));
+    const QCommandLineOption userOption(
+        {QStringLiteral("u"), QStringLiteral("username")},
+        QStringLiteral("Upstream username, the password is read from the "
+                       "SIMPLEMAIL_RELAYD_PASSWORD environment variable."),
+        QStringLiteral("username"));
+    const QCommandLineOption connectionsOption(
+        {QStringLiteral("c"), QStringLiteral("connections")},
+        QStringLiteral("Number of persistent connections to each upstream."),
+        QStringLiteral("count"),
+        QStringLiteral("4"));
+    const QCommandLineOption spoolOption(
+        QStringLiteral("spool"),
+        QStringLiteral("Directory for messages that could not be relayed yet."),
+        QStringLiteral("path"));
+    const QCommandLineOption retriesOption(QStringLiteral("retries"),
+                                           QStringLiteral("Attempts before spooling a message."),
+                                           QStringLiteral("count"),
+                                           QStringLiteral("3"));
+    const QCommandLineOption retryIntervalOption(
+        QStringLiteral("retry-interval"),
+        QStringLiteral("Seconds between retries, the spool is scanned every ten intervals."),
+        QStringLiteral("seconds"),
+        QStringLiteral("5"));
+    const QCommandLineOption maxInFlightOption(
+        QStringLiteral("max-in-flight"),
+        QStringLiteral("Messages kept in memory before spooling new ones."),
+        QStringLiteral("count"),
+        QStringLiteral("10000"));
+    const QCommandLineOption ioUringOption(
+        QStringLiteral("io-uring"),
+        QStringLiteral("Batch upstream TCP I/O through io_uring when available."));
+    const QCommandLineOption maxSizeOption(QStringLiteral("max-size"),
+                                           QStringLiteral("Maximum accepted message size."),
+                                           QStringLiteral("bytes"),
+                                           QStringLiteral("52428800"));
+    const QCommandLineOption prewarmOption(
+        QStringLiteral("prewarm"),
+        QStringLiteral("Connect and authenticate the upstream connections at startup."));
+    const QCommandLineOption keepAliveOption(
+        QStringLiteral("keepalive"),
+        QStringLiteral("Seconds between NOOPs on idle upstream connections, 0 disables."),
+        QStringLiteral("seconds"),
+        QStringLiteral("0"));
+    const QCommandLineOption maxIdleOption(
+        QStringLiteral("max-idle"),
+        QStringLiteral("Seconds an upstream connection may stay idle before it is recycled."),
+        QStringLiteral("seconds"),
+        QStringLiteral("240"));
+    const QCommandLineOption rateOption(
+        QStringLiteral("rate"),
+        QStringLiteral("Messages per second relayed upstream, 0 is unlimited."),
+        QStringLiteral("count"),
+        QStringLiteral("0"));
+    const QCommandLineOption recipientsRateOption(
+        QStringLiteral("recipients-per-hour"),
+        QStringLiteral("Recipients per hour for each sender, 0 is unlimited."),
+        QStringLiteral("count"),
+        QStringLiteral("0"));
+    parser.addOptions({socketOption,
+                       lmtpOption,
+                       hostOption,
+                       portOption,
+                       sslOption,
+                       startTlsOption,
+                       userOption,
+                       connectionsOption,
+                       spoolOption,
+                       retriesOption,
+                       retryIntervalOption,
+                       maxInFlightOption,
+                       ioUringOption,
+                       maxSizeOption,
+                       prewarmOption,
+                       keepAliveOption,
+                       maxIdleOption,
+                       rateOption,
+                       recipientsRateOption});
+    parser.process(app);
+
+    Relay relay;
+    relay.setMaxRetries(parser.value(retriesOption).toInt());
+    relay.setRetryInterval(parser.value(retryIntervalOption).toInt() * 1000);
+    relay.setMaxInFlight(parser.value(maxInFlightOption).toInt());
+
+    // Shared by every connection as the quotas are for the whole relay
+    auto limiter = std::make_shared<RateLimiter>();
+    limiter->setLimit(RateLimiter::Messages, parser.value(rateOption).toLongLong(), 1000);
+    limiter->setSenderLimit(
+        RateLimiter::Recipients, parser.value(recipientsRateOption).toLongLong(), 3600 * 1000);
+
+    const int connections = qMax(1, parser.value(connectionsOption).toInt());
+    const auto hosts      = parser.values(hostOption);
+    for (int i = 0; i < connections * hosts.size(); ++i) {
+        // A single colon separates the port, IPv6 addresses use --port
+        QString host = hosts[i % hosts.size()];
+        quint16 port = quint16(parser.value(portOption).toUInt());
+        if (host.count(QLatin1Char(':')) == 1) {
+            const int sep = host.indexOf(QLatin1Char(':'));
+            port          = quint16(host.mid(sep + 1).toUInt());
+            host.truncate(sep);
+        }
+
+        auto server = new Server;
+        server->setHost(host);
+        server->setPort(port);
+        server->setIoUringEnabled(parser.isSet(ioUringOption));
+        server->setKeepAliveInterval(parser.value(keepAliveOption).toInt() * 1000);
+        server->setMaxIdleTime(parser.value(maxIdleOption).toInt() * 1000);
+        server->setRateLimiter(limiter);
+#ifndef QT_NO_SSL
+        if (parser.isSet(sslOption)) {
+            server->setConnectionType(Server::SslConnection);
+        } else if (parser.isSet(startTlsOption)) {
+            server->setConnectionType(Server::TlsConnection);
+        }
+#endif
+        if (parser.isSet(userOption)) {
+            server->setUsername(parser.value(userOption));
+            server->setPassword(qEnvironmentVariable("SIMPLEMAIL_RELAYD_PASSWORD"));
+        }
+        QObject::connect(
+            server, &Server::smtpError, &relay, [](Server::SmtpError e, const QString &description) {
+            qCWarning(RELAYD) << "Upstream error" << e << description;
+        });
+        relay.addUpstream(server);
+
+        if (parser.isSet(prewarmOption)) {
+            server->connectToServer();
+        }
+    }
+
+    if (parser.isSet(spoolOption)) {
+        relay.setSpoolDirectory(parser.value(spoolOption));
+    }
+
+    const auto protocol = parser.isSet(lmtpOption) ? LocalSession::Lmtp : LocalSession::Smtp;
+    const QByteArray hostname = QHostInfo::localHostName().toLatin1();
+    const qint64 maxSize      = parser.value(maxSizeOption).toLongLong();
+
+    QLocalServer listener;
+    const QString socketName = parser.value(socketOption);
+    QLocalServer::removeServer(socketName);
+    if (!listener.listen(socketName)) {
+        qCCritical(RELAYD) << "Failed to listen on" << socketName << listener.errorString();
+        return 1;
+    }
+
+    QObject::connect(&listener, &QLocalServer::newConnection, &listener, [&] {
+        while (QLocalSocket *socket = listener.nextPendingConnection()) {
+            auto session = new LocalSession(socket, &relay, protocol, &listener);
+            session->setHostname(hostname);
+            session->setMaxMessageSize(maxSize);
+            session->start();
+        }
+    });
+
+    qCInfo(RELAYD) << "Listening on" << listener.fullServerName();
+
+    return app.exec();
+}
@@ -0,0 +1,284 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "relay.h"
+
+#include "mimemessage.h"
+#include "relaygroup.h"
+#include "server.h"
+#include "serverreply.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QUuid>
+
+Q_LOGGING_CATEGORY(RELAYD, "simplemail.relayd", QtInfoMsg)
+
+using namespace SimpleMail;
+
+static bool loadEnvelope(const QString &fileName, Relay::Envelope &envelope)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // Envelope lines are followed by an empty line and the message data
+    while (true) {
+        QByteArray line = file.readLine();
+        if (!line.endsWith("\r\n")) {
+            return false;
+        }
+        line.chop(2);
+
+        if (line.isEmpty()) {
+            break;
+        } else if (line.startsWith("MAIL FROM:<") && line.endsWith('>')) {
+            envelope.sender = QString::fromUtf8(line.mid(11, line.size() - 12));
+        } else if (line.startsWith("RCPT TO:<") && line.endsWith('>')) {
+            envelope.recipients.append(QString::fromUtf8(line.mid(9, line.size() - 10)));
+        } else {
+            return false;
+        }
+    }
+
+    envelope.data      = file.readAll();
+    envelope.spoolFile = fileName;
+    return !envelope.recipients.isEmpty();
+}
+
+Relay::Relay(QObject *parent)
+    : QObject(parent)
+    , m_upstreams(new RelayGroup(this))
+{
+    connect(&m_spoolTimer, &QTimer::timeout, this, &Relay::scanSpool);
+}
+
+Relay::~Relay() = default;
+
+void Relay::addUpstream(Server *server)
+{
+    m_upstreams->addServer(server);
+}
+
+void Relay::setSpoolDirectory(const QString &path)
+{
+    m_spoolDirectory = path;
+    if (m_spoolDirectory.isEmpty()) {
+        m_spoolTimer.stop();
+        return;
+    }
+
+    if (!QDir().mkpath(m_spoolDirectory)) {
+        qCWarning(RELAYD) << "Failed to create spool directory" << m_spoolDirectory;
+    }
+
+    // Pick up what was left by a previous run once the event loop starts
+    QTimer::singleShot(0, this, &Relay::scanSpool);
+    m_spoolTimer.start(m_retryInterval * 10);
+}
+
+QString Relay::spoolDirectory() const
+{
+    return m_spoolDirectory;
+}
+
+void Relay::setMaxRetries(int retries)
+{
+    m_maxRetries = qMax(1, retries);
+}
+
+void Relay::setRetryInterval(int msec)
+{
+    m_retryInterval = qMax(1, msec);
+    if (m_spoolTimer.isActive()) {
+        m_spoolTimer.start(m_retryInterval * 10);
+    }
+}
+
+void Relay::setMaxInFlight(int max)
+{
+    m_maxInFlight = qMax(1, max);
+}
+
+bool Relay::submit(const Envelope &envelope)
+{
+    if (m_upstreams->servers().isEmpty()) {
+        return false;
+    }
+
+    if (m_inFlight >= m_maxInFlight) {
+        qCDebug(RELAYD) << "Too many messages in flight, spooling" << m_inFlight;
+        Envelope spooled = envelope;
+        return spool(spooled, m_spoolDirectory);
+    }
+
+    ++m_inFlight;
+    dispatch(envelope);
+    return true;
+}
+
+int Relay::inFlight() const
+{
+    return m_inFlight;
+}
+
+void Relay::dispatch(Envelope envelope)
+{
+    MimeMessage message(false);
+    message.setSender(EmailAddress(envelope.sender, QString()));
+    for (const QString &rcpt : std::as_const(envelope.recipients)) {
+        message.addBcc(EmailAddress(rcpt, QString()));
+    }
+    message.setRawData(envelope.data);
+
+    if (!envelope.spoolFile.isEmpty()) {
+        m_spoolInFlight.insert(envelope.spoolFile);
+    }
+
+    // The group picks the healthy connection expected to finish it first,
+    // all of them are kept open so only the first message pays for connecting
+    ServerReply *reply = m_upstreams->sendMail(message);
+    connect(reply, &ServerReply::finished, this, [this, reply, envelope] {
+        finished(reply, envelope);
+    });
+}
+
+void Relay::finished(ServerReply *reply, Envelope envelope)
+{
+    reply->deleteLater();
+
+    if (!reply->error()) {
+        qCDebug(RELAYD) << "Delivered" << envelope.sender << envelope.recipients
+                        << reply->responseText();
+        if (!envelope.spoolFile.isEmpty()) {
+            m_spoolInFlight.remove(envelope.spoolFile);
+            QFile::remove(envelope.spoolFile);
+        }
+        --m_inFlight;
+        return;
+    }
+
+    const int code = reply->responseCode();
+    if (code / 100 == 5) {
+        qCWarning(RELAYD) << "Permanent failure" << code << reply->responseText()
+                          << envelope.sender << envelope.recipients;
+        m_spoolInFlight.remove(envelope.spoolFile);
+        if (!m_spoolDirectory.isEmpty()) {
+            spool(envelope, m_spoolDirectory + QLatin1String("/failed"));
+        }
+        --m_inFlight;
+        return;
+    }
+
+    if (++envelope.attempts >= m_maxRetries) {
+        m_spoolInFlight.remove(envelope.spoolFile);
+        if (spool(envelope, m_spoolDirectory)) {
+            qCInfo(RELAYD) << "Spooled after" << envelope.attempts << "attempts" << code
+                           << reply->responseText();
+            --m_inFlight;
+            return;
+        }
+
+        // The client was already told it's queued, so without a spool it stays in memory
+        if (!envelope.spoolFile.isEmpty()) {
+            m_spoolInFlight.insert(envelope.spoolFile);
+        }
+    }
+
+    // Stays in m_spoolInFlight, so spool scans skip it while backing off
+    qCInfo(RELAYD) << "Temporary failure, retrying" << code << reply->responseText()
+                   << envelope.attempts;
+    QTimer::singleShot(m_retryInterval * qMin(envelope.attempts, m_maxRetries),
+                       this,
+                       [this, envelope] { dispatch(envelope); });
+}
+
+bool Relay::spool(Envelope &envelope, const QString &directory)
+{
+    if (directory.isEmpty()) {
+        return false;
+    }
+
+    if (!envelope.spoolFile.isEmpty() && QFileInfo(envelope.spoolFile).absolutePath() ==
+                                             QFileInfo(directory).absoluteFilePath()) {
+        return true;
+    }
+
+    const QDir dir(directory);
+    if (!dir.exists() && !QDir().mkpath(directory)) {
+        qCWarning(RELAYD) << "Failed to create spool directory" << directory;
+        return false;
+    }
+
+    const QString fileName =
+        dir.filePath(QUuid::createUuid().toString(QUuid::WithoutBraces) + QLatin1String(".msg"));
+
+    QByteArray header = "MAIL FROM:<" + envelope.sender.toUtf8() + ">\r\n";
+    for (const QString &rcpt : std::as_const(envelope.recipients)) {
+        header.append("RCPT TO:<" + rcpt.toUtf8() + ">\r\n");
+    }
+    header.append("\r\n");
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(header) != header.size() ||
+        file.write(envelope.data) != envelope.data.size() || !file.commit()) {
+        qCWarning(RELAYD) << "Failed to spool message" << fileName << file.errorString();
+        return false;
+    }
+
+    if (!envelope.spoolFile.isEmpty()) {
+        QFile::remove(envelope.spoolFile);
+    }
+    envelope.spoolFile = fileName;
+    qCDebug(RELAYD) << "Spooled" << fileName;
+
+    return true;
+}
+
+void Relay::scanSpool()
+{
+    if (m_spoolDirectory.isEmpty() || m_upstreams->servers().isEmpty()) {
+        return;
+    }
+
+    const QDir dir(m_spoolDirectory);
+    const QStringList files = dir.entryList(
+        {QStringLiteral("*.msg")}, QDir::Files, QDir::Time | QDir::Reversed);
+    for (const QString &name : files) {
+        if (m_inFlight >= m_maxInFlight) {
+            break;
+        }
+
+        const QString fileName = dir.filePath(name);
+        if (m_spoolInFlight.contains(fileName)) {
+            continue;
+        }
+
+        Envelope envelope;
+        if (!loadEnvelope(fileName, envelope)) {
+            qCWarning(RELAYD) << "Ignoring invalid spool file" << fileName;
+            continue;
+        }
+
+        ++m_inFlight;
+        dispatch(envelope);
+    }
+}
+
+#include "moc_relay.cpp"
@@ -0,0 +1,105 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#pragma once
+
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+
+namespace SimpleMail {
+class RelayGroup;
+class Server;
+class ServerReply;
+} // namespace SimpleMail
+
+/**
+ * Relay funnels locally submitted mail into a bounded set of persistent
+ * upstream Server connections, grouped so that a failing upstream host is
+ * ejected and its traffic goes to the others.
+ *
+ * Temporary failures are retried with a linear backoff, once the retries are
+ * exhausted or too many messages are in flight the message is written to the
+ * spool directory, which is scanned periodically. Without a spool directory
+ * accepted messages are retried until they are delivered or permanently fail.
+ */
+class Relay : public QObject
+{
+    Q_OBJECT
+public:
+    struct Envelope {
+        QString sender;
+        QStringList recipients;
+        QByteArray data;
+        QString spoolFile;
+        int attempts = 0;
+    };
+
+    explicit Relay(QObject *parent = nullptr);
+    ~Relay();
+
+    /**
+     * Adds an upstream connection, the relay takes ownership of it
+     */
+    void addUpstream(SimpleMail::Server *server);
+
+    /**
+     * Directory where messages that couldn't be delivered are stored,
+     * spooling is disabled if empty
+     */
+    void setSpoolDirectory(const QString &path);
+    QString spoolDirectory() const;
+
+    /**
+     * Maximum number of attempts before a message is spooled, the retry
+     * backoff stops growing after it
+     */
+    void setMaxRetries(int retries);
+
+    /**
+     * Base interval in milliseconds between retries and spool scans
+     */
+    void setRetryInterval(int msec);
+
+    /**
+     * Maximum number of messages kept in memory, messages above
+     * this limit go straight to the spool
+     */
+    void setMaxInFlight(int max);
+
+    /**
+     * Accepts a message for delivery, returns false if it could neither be
+     * queued nor spooled
+     */
+    bool submit(const Envelope &envelope);
+
+    int inFlight() const;
+
+private:
+    void dispatch(Envelope envelope);
+    void finished(SimpleMail::ServerReply *reply, Envelope envelope);
+    bool spool(Envelope &envelope, const QString &directory);
+    void scanSpool();
+
+    SimpleMail::RelayGroup *m_upstreams;
+    QSet<QString> m_spoolInFlight;
+    QString m_spoolDirectory;
+    QTimer m_spoolTimer;
+    int m_maxRetries    = 3;
+    int m_retryInterval = 5000;
+    int m_maxInFlight   = 10000;
+    int m_inFlight      = 0;
+};
@@ -0,0 +1,359 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "directdelivery_p.h"
+
+#include "serverreply_p.h"
+
+#include <utility>
+
+#include <QBuffer>
+#include <QHostInfo>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(SIMPLEMAIL_SERVER)
+
+using namespace SimpleMail;
+
+DirectDelivery::DirectDelivery(QObject *parent)
+    : QObject(parent)
+    , d_ptr(new DirectDeliveryPrivate(this))
+{
+    Q_D(DirectDelivery);
+    d->hostname = QHostInfo::localHostName();
+    connect(&d->sweepTimer, &QTimer::timeout, this, [d] { d->sweep(); });
+}
+
+DirectDelivery::~DirectDelivery()
+{
+    delete d_ptr;
+}
+
+QString DirectDelivery::hostname() const
+{
+    Q_D(const DirectDelivery);
+    return d->hostname;
+}
+
+void DirectDelivery::setHostname(const QString &hostname)
+{
+    Q_D(DirectDelivery);
+    d->hostname = hostname;
+}
+
+quint16 DirectDelivery::port() const
+{
+    Q_D(const DirectDelivery);
+    return d->port;
+}
+
+void DirectDelivery::setPort(quint16 port)
+{
+    Q_D(DirectDelivery);
+    d->port = port;
+}
+
+QHostAddress DirectDelivery::nameserver() const
+{
+    Q_D(const DirectDelivery);
+    return d->nameserver;
+}
+
+void DirectDelivery::setNameserver(const QHostAddress &address, quint16 port)
+{
+    Q_D(DirectDelivery);
+    d->nameserver     = address;
+    d->nameserverPort = port;
+}
+
+int DirectDelivery::connectionsPerHost() const
+{
+    Q_D(const DirectDelivery);
+    return d->connectionsPerHost;
+}
+
+void DirectDelivery::setConnectionsPerHost(int connections)
+{
+    Q_D(DirectDelivery);
+    d->connectionsPerHost = qMax(1, connections);
+}
+
+int DirectDelivery::idleTimeout() const
+{
+    Q_D(const DirectDelivery);
+    return d->idleTimeout;
+}
+
+void DirectDelivery::setIdleTimeout(int msec)
+{
+    Q_D(DirectDelivery);
+    d->idleTimeout = qMax(0, msec);
+}
+
+ServerReply *DirectDelivery::sendMail(const MimeMessage &msg,
+                                      Server::Priority priority,
+                                      QDeadlineTimer deadline)
+{
+    Q_D(DirectDelivery);
+    auto reply = new ServerReply(this);
+    auto job   = std::make_shared<DirectJob>();
+    job->reply = reply;
+
+    // Deleting the reply cancels the transactions like it does on Server
+    connect(reply, &QObject::destroyed, this, [job] {
+        for (const auto &trans : std::as_const(job->transactions)) {
+            delete trans.data();
+        }
+    });
+
+    // Group the envelope recipients by domain, in the order they first appear
+    QStringList domains;
+    QHash<QString, QList<EmailAddress>> recipients;
+    for (const auto &list : {msg.toRecipients(), msg.ccRecipients(), msg.bccRecipients()}) {
+        for (const EmailAddress &rcpt : list) {
+            const QString address = rcpt.address();
+            const int at          = address.lastIndexOf(QLatin1Char('@'));
+            if (at < 1 || at == address.size() - 1) {
+                job->error        = true;
+                job->responseCode = 501;
+                job->responseText = tr("Invalid recipient address");
+                job->responses.append({address, job->responseText, job->responseCode});
+                continue;
+            }
+
+            const QString domain = address.mid(at + 1).toLower();
+            auto it              = recipients.find(domain);
+            if (it == recipients.end()) {
+                domains.append(domain);
+                it = recipients.insert(domain, {});
+            }
+            it->append(rcpt);
+        }
+    }
+
+    // Encoded once, the transactions only differ on their envelope
+    QByteArray data = msg.rawData();
+    if (data.isNull() && !domains.isEmpty()) {
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::WriteOnly);
+        if (!msg.write(&buffer)) {
+            domains.clear();
+            job->error        = true;
+            job->responseCode = ServerReply::TransportError;
+            job->responseText = tr("Failed to encode the message");
+        }
+    }
+
+    if (domains.isEmpty()) {
+        if (!job->error) {
+            job->error        = true;
+            job->responseCode = 501;
+            job->responseText = tr("No recipients");
+        }
+
+        // Callers connect to finished() after getting the reply
+        QTimer::singleShot(0, reply, [job] { DirectDeliveryPrivate::complete(*job); });
+        return reply;
+    }
+
+    job->pending = int(domains.size());
+    for (const QString &domain : std::as_const(domains)) {
+        DirectTransaction trans;
+        trans.job      = job;
+        trans.deadline = deadline;
+        trans.priority = priority;
+        trans.msg.setSender(msg.sender());
+        trans.msg.setToRecipients(recipients.value(domain));
+        trans.msg.setRawData(data);
+        for (const EmailAddress &rcpt : recipients.value(domain)) {
+            trans.recipients.append(rcpt.address());
+        }
+
+        DnsCache::lookupMx(domain,
+                           d->nameserver,
+                           d->nameserverPort,
+                           this,
+                           [d, trans, domain](const DnsCache::MxResult &result) {
+            d->resolved(trans, domain, result);
+        });
+    }
+
+    return reply;
+}
+
+Server *DirectDelivery::createServer(const QString &host, quint16 port)
+{
+    Q_D(DirectDelivery);
+    auto server = new Server;
+    server->setHost(host);
+    server->setPort(port);
+    server->setHostname(d->hostname);
+    server->setNameserver(d->nameserver, d->nameserverPort);
+    return server;
+}
+
+void DirectDeliveryPrivate::resolved(DirectTransaction trans,
+                                     const QString &domain,
+                                     const DnsCache::MxResult &result)
+{
+    Q_Q(DirectDelivery);
+
+    if (!trans.job->reply) {
+        finish(trans, true, ServerReply::TransportError, QString());
+        return;
+    }
+
+    switch (result.status) {
+    case DnsCache::MxResult::Ok:
+        trans.hosts = result.hosts;
+        send(trans);
+        break;
+    case DnsCache::MxResult::NotFound:
+        finish(trans, true, 550, q->tr("Domain %1 does not exist").arg(domain));
+        break;
+    case DnsCache::MxResult::NullMx:
+        finish(trans, true, 556, q->tr("Domain %1 does not accept mail").arg(domain));
+        break;
+    case DnsCache::MxResult::Failed:
+        finish(trans,
+               true,
+               ServerReply::DnsError,
+               q->tr("MX lookup of %1 failed: %2").arg(domain, result.error));
+        break;
+    }
+}
+
+void DirectDeliveryPrivate::send(DirectTransaction trans)
+{
+    Q_Q(DirectDelivery);
+
+    Server *srv        = server(trans.hosts.at(trans.host));
+    ServerReply *reply = srv->sendMail(trans.msg, trans.priority, trans.deadline);
+    trans.job->transactions.append(reply);
+    if (reply->timestamp(ServerReply::Finished)) {
+        // Finished inside sendMail(), its signal is already gone
+        QTimer::singleShot(0, reply, [this, trans, reply] { finished(trans, reply); });
+    } else {
+        QObject::connect(reply, &ServerReply::finished, q, [this, trans, reply] {
+            finished(trans, reply);
+        });
+    }
+}
+
+void DirectDeliveryPrivate::finished(DirectTransaction trans, ServerReply *reply)
+{
+    reply->deleteLater();
+    trans.job->transactions.removeAll(reply);
+
+    // Temporary failures go to the next exchanger, like greylisting by the first one
+    const int code = reply->responseCode();
+    if (reply->error() && (code == ServerReply::TransportError || code / 100 == 4) &&
+        trans.job->reply && ++trans.host < trans.hosts.size() && !trans.deadline.hasExpired()) {
+        qCDebug(SIMPLEMAIL_SERVER) << "Trying next exchanger" << trans.hosts.at(trans.host)
+                                   << code << reply->responseText();
+        send(trans);
+        return;
+    }
+
+    if (reply->error()) {
+        trans.job->transcript = reply->transcript();
+    }
+    finish(trans, reply->error(), code, reply->responseText());
+}
+
+void DirectDeliveryPrivate::finish(const DirectTransaction &trans,
+                                   bool error,
+                                   int code,
+                                   const QString &text)
+{
+    DirectJob &job = *trans.job;
+    for (const QString &rcpt : trans.recipients) {
+        job.responses.append({rcpt, text, code});
+    }
+
+    if (error) {
+        job.error        = true;
+        job.responseCode = code;
+        job.responseText = text;
+    } else if (!job.error) {
+        job.responseCode = code;
+        job.responseText = text;
+    }
+
+    if (--job.pending == 0 && job.reply) {
+        complete(job);
+    }
+}
+
+void DirectDeliveryPrivate::complete(DirectJob &job)
+{
+    job.reply->d_ptr->recipientResponses = job.responses;
+    job.reply->d_ptr->transcript         = job.transcript;
+    job.reply->finish(job.error, job.responseCode, job.responseText);
+}
+
+Server *DirectDeliveryPrivate::server(const QString &host)
+{
+    Q_Q(DirectDelivery);
+
+    DirectPool &pool = pools[host.toLower()];
+    pool.lastUsed.start();
+
+    Server *best = nullptr;
+    for (Server *srv : std::as_const(pool.servers)) {
+        if (!best || srv->queueSize() < best->queueSize()) {
+            best = srv;
+        }
+    }
+
+    // A new connection only when the others are busy
+    if (!best || (best->queueSize() > 0 && pool.servers.size() < connectionsPerHost)) {
+        best = q->createServer(host, port);
+        best->setParent(q);
+        pool.servers.append(best);
+    }
+
+    if (!sweepTimer.isActive()) {
+        sweepTimer.start(qMax(1000, idleTimeout / 2));
+    }
+    return best;
+}
+
+void DirectDeliveryPrivate::sweep()
+{
+    for (auto it = pools.begin(); it != pools.end();) {
+        bool idle = it->lastUsed.hasExpired(idleTimeout);
+        for (Server *srv : std::as_const(it->servers)) {
+            idle = idle && srv->queueSize() == 0;
+        }
+
+        if (!idle) {
+            ++it;
+            continue;
+        }
+
+        for (Server *srv : std::as_const(it->servers)) {
+            QObject::connect(srv, &Server::drained, srv, &QObject::deleteLater);
+            srv->drain();
+        }
+        it = pools.erase(it);
+    }
+
+    if (pools.isEmpty()) {
+        sweepTimer.stop();
+    }
+}
+
+#include "moc_directdelivery.cpp"
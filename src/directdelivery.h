@@ -0,0 +1,127 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#pragma once
+
+#include "server.h"
+#include "smtpexports.h"
+
+#include <QDeadlineTimer>
+#include <QHostAddress>
+#include <QObject>
+
+namespace SimpleMail {
+
+class MimeMessage;
+class ServerReply;
+class DirectDeliveryPrivate;
+/**
+ * DirectDelivery sends mail straight to the mail exchangers of the
+ * recipients' domains instead of submitting it to a smarthost.
+ *
+ * Recipients are grouped by domain and each group becomes a transaction of
+ * its own, running in parallel with the others. MX records are resolved
+ * asynchronously and cached for their TTL, the exchangers are tried in order
+ * of preference. Connections are pooled per exchanger and closed after being
+ * idle for a while.
+ */
+class SMTP_EXPORT DirectDelivery : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(DirectDelivery)
+public:
+    explicit DirectDelivery(QObject *parent = nullptr);
+    virtual ~DirectDelivery();
+
+    /**
+     * Returns the hostname sent by the EHLO command
+     */
+    QString hostname() const;
+
+    /**
+     * Defines the hostname sent by the EHLO command, should be the public
+     * name of this host as exchangers often check it. Defaults to the local hostname
+     */
+    void setHostname(const QString &hostname);
+
+    /**
+     * Returns the port the exchangers are connected to
+     */
+    quint16 port() const;
+
+    /**
+     * Defines the port the exchangers are connected to. Defaults to 25
+     */
+    void setPort(quint16 port);
+
+    /**
+     * Returns the nameserver used for the MX lookups
+     */
+    QHostAddress nameserver() const;
+
+    /**
+     * Defines the nameserver used for the MX lookups and to resolve the
+     * exchangers, e.g. a local stub in tests. The port is only honoured with
+     * Qt 6.6 or later.
+     * Defaults to a null address, the system's resolver
+     */
+    void setNameserver(const QHostAddress &address, quint16 port = 53);
+
+    /**
+     * Returns the maximum number of connections to each exchanger
+     */
+    int connectionsPerHost() const;
+
+    /**
+     * Defines the maximum number of connections to each exchanger, a new one
+     * is only opened when the others are busy. Defaults to 2
+     */
+    void setConnectionsPerHost(int connections);
+
+    /**
+     * Returns the time in milliseconds an unused exchanger pool is kept
+     */
+    int idleTimeout() const;
+
+    /**
+     * Defines the time in milliseconds an unused exchanger pool is kept before
+     * its connections are closed with QUIT. Defaults to 60 seconds
+     */
+    void setIdleTimeout(int msec);
+
+    /**
+     * Sends the email to the exchangers of its recipients, see Server::sendMail().
+     *
+     * The reply finishes once every domain is done, it fails if any of them
+     * failed with the code and text of that failure. recipientResponses() has
+     * the result of every recipient.
+     */
+    ServerReply *sendMail(const MimeMessage &msg,
+                          Server::Priority priority = Server::TransactionalPriority,
+                          QDeadlineTimer deadline   = QDeadlineTimer(QDeadlineTimer::Forever));
+
+protected:
+    /**
+     * Creates the connection to an exchanger, reimplement it to change the
+     * connection type, TLS configuration or limits. The default implementation
+     * creates a plain TCP Server with the hostname()
+     */
+    virtual Server *createServer(const QString &host, quint16 port);
+
+private:
+    DirectDeliveryPrivate *d_ptr;
+};
+
+} // namespace SimpleMail
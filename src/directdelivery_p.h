@@ -0,0 +1,97 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef DIRECTDELIVERY_P_H
+#define DIRECTDELIVERY_P_H
+
+#include "directdelivery.h"
+#include "dnscache_p.h"
+#include "mimemessage.h"
+#include "serverreply.h"
+
+#include <memory>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPointer>
+#include <QTimer>
+
+namespace SimpleMail {
+
+/**
+ * A message sent with DirectDelivery, finished once every domain is done
+ */
+struct DirectJob {
+    QPointer<ServerReply> reply;
+    QList<QPointer<ServerReply>> transactions;
+    QList<ServerReply::RecipientResponse> responses;
+    QStringList transcript; // Of the last failed transaction
+    QString responseText;
+    int responseCode = 0;
+    int pending      = 0;
+    bool error       = false;
+};
+
+/**
+ * The recipients of a message on the same domain
+ */
+struct DirectTransaction {
+    std::shared_ptr<DirectJob> job;
+    MimeMessage msg{false};
+    QStringList recipients;
+    QStringList hosts;
+    QDeadlineTimer deadline;
+    Server::Priority priority;
+    int host = 0;
+};
+
+struct DirectPool {
+    QList<Server *> servers;
+    QElapsedTimer lastUsed;
+};
+
+class DirectDeliveryPrivate
+{
+    Q_DECLARE_PUBLIC(DirectDelivery)
+public:
+    DirectDeliveryPrivate(DirectDelivery *q)
+        : q_ptr(q)
+    {
+    }
+
+    void resolved(DirectTransaction trans,
+                  const QString &domain,
+                  const DnsCache::MxResult &result);
+    void send(DirectTransaction trans);
+    void finished(DirectTransaction trans, ServerReply *reply);
+    void finish(const DirectTransaction &trans, bool error, int code, const QString &text);
+    static void complete(DirectJob &job);
+    Server *server(const QString &host);
+    void sweep();
+
+    DirectDelivery *q_ptr;
+    QHash<QString, DirectPool> pools;
+    QTimer sweepTimer;
+    QHostAddress nameserver;
+    QString hostname;
+    int connectionsPerHost = 2;
+    int idleTimeout        = 60000;
+    quint16 nameserverPort = 53;
+    quint16 port           = 25;
+};
+
+} // namespace SimpleMail
+
+#endif // DIRECTDELIVERY_P_H
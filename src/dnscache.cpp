@@ -0,0 +1,476 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "dnscache_p.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include <QDeadlineTimer>
+#include <QDnsLookup>
+#include <QHash>
+#include <QHostInfo>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QPointer>
+#include <QRandomGenerator>
+#include <QTimer>
+
+Q_DECLARE_LOGGING_CATEGORY(SIMPLEMAIL_SERVER)
+
+using namespace SimpleMail;
+
+namespace {
+
+// Direct delivery may see many domains, this only protects from unbounded growth
+constexpr int MaxEntries = 4096;
+
+// Used for answers without records to take the TTL from
+constexpr int NegativeTtl = 300;
+
+// Used for QHostInfo answers, which don't have one
+constexpr int FallbackTtl = 60;
+
+// RFC 8305 section 3, how long an A answer waits for the AAAA one
+constexpr int ResolutionDelay = 50;
+
+template <typename Result>
+class Cache
+{
+public:
+    bool find(const QString &key, Result *result)
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_entries.find(key);
+        if (it == m_entries.end()) {
+            return false;
+        }
+
+        if (it->expiry.hasExpired()) {
+            m_entries.erase(it);
+            return false;
+        }
+        *result = it->result;
+        return true;
+    }
+
+    void insert(const QString &key, const Result &result, qint64 ttl)
+    {
+        if (ttl <= 0) {
+            return;
+        }
+
+        QMutexLocker locker(&m_mutex);
+        if (m_entries.size() >= MaxEntries && !m_entries.contains(key)) {
+            for (auto it = m_entries.begin(); it != m_entries.end();) {
+                if (it->expiry.hasExpired()) {
+                    it = m_entries.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            if (m_entries.size() >= MaxEntries) {
+                m_entries.erase(m_entries.begin());
+            }
+        }
+
+        m_entries.insert(key, {result, QDeadlineTimer(ttl * 1000)});
+    }
+
+private:
+    struct Entry {
+        Result result;
+        QDeadlineTimer expiry;
+    };
+
+    QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+};
+
+template <typename Callback>
+struct Pending {
+    QPointer<QObject> context;
+    Callback callback;
+};
+
+Cache<DnsCache::MxResult> mxCache;
+Cache<DnsCache::HostResult> hostCache;
+
+/**
+ * Callbacks waiting for a host, the first caughtUp of them already got
+ * the addresses sent before its lookup finished
+ */
+struct HostWaiters {
+    QList<Pending<DnsCache::HostCallback>> callbacks;
+    QList<QHostAddress> sent;
+    qsizetype caughtUp = 0;
+};
+
+// Lookups run on the thread that asked for them
+thread_local QHash<QString, QList<Pending<DnsCache::MxCallback>>> mxPending;
+thread_local QHash<QString, HostWaiters> hostPending;
+
+/**
+ * Waits for the AAAA and A lookups of a host, a family is sent ahead
+ * when the other one is late
+ */
+struct HostLookup {
+    QList<QHostAddress> ipv6;
+    QList<QHostAddress> ipv4;
+    QString error;
+    quint32 ttl   = std::numeric_limits<quint32>::max();
+    int remaining = 2;
+    bool ipv6Sent = false;
+    bool ipv4Sent = false;
+};
+
+QString cacheKey(const QString &domain, const QHostAddress &nameserver, quint16 port)
+{
+    if (nameserver.isNull()) {
+        return domain;
+    }
+    return domain + QLatin1Char('@') + nameserver.toString() + QLatin1Char(':') +
+           QString::number(port);
+}
+
+template <typename Callback, typename Result>
+void deliver(QObject *context, const Callback &callback, const Result &result)
+{
+    QMetaObject::invokeMethod(
+        context, [callback, result] { callback(result); }, Qt::QueuedConnection);
+}
+
+template <typename Callback, typename Result>
+void notify(QHash<QString, QList<Pending<Callback>>> &pending,
+            const QString &key,
+            const Result &result)
+{
+    const auto waiting = pending.take(key);
+    for (const auto &entry : waiting) {
+        if (entry.context) {
+            entry.callback(result);
+        }
+    }
+}
+
+/**
+ * Sends addresses ahead of the rest of the lookup to the ones waiting
+ */
+void notifyHostPartial(const QString &key, const QList<QHostAddress> &addresses)
+{
+    auto it = hostPending.find(key);
+    if (it == hostPending.end()) {
+        return;
+    }
+
+    DnsCache::HostResult result;
+    result.addresses = addresses;
+    result.complete  = false;
+    it->sent += addresses;
+    it->caughtUp = it->callbacks.size();
+
+    // A callback may start another lookup, which could rehash hostPending
+    const auto waiting = it->callbacks;
+    for (const auto &entry : waiting) {
+        if (entry.context) {
+            entry.callback(result);
+        }
+    }
+}
+
+/**
+ * Sends what is left of result, the ones that joined after the addresses
+ * sent ahead get those too
+ */
+void notifyHost(const QString &key, const DnsCache::HostResult &result)
+{
+    const HostWaiters waiting = hostPending.take(key);
+    DnsCache::HostResult late = result;
+    late.addresses            = waiting.sent + result.addresses;
+    for (qsizetype i = 0; i < waiting.callbacks.size(); ++i) {
+        const auto &entry = waiting.callbacks[i];
+        if (entry.context) {
+            entry.callback(i < waiting.caughtUp ? result : late);
+        }
+    }
+}
+
+QDnsLookup *createLookup(QDnsLookup::Type type,
+                         const QString &name,
+                         const QHostAddress &nameserver,
+                         quint16 port)
+{
+    auto lookup = new QDnsLookup(type, name);
+    if (!nameserver.isNull()) {
+        lookup->setNameserver(nameserver);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+        lookup->setNameserverPort(port);
+#else
+        if (port != 53) {
+            qCWarning(SIMPLEMAIL_SERVER) << "Nameserver port requires Qt 6.6, using 53";
+        }
+#endif
+    }
+    return lookup;
+}
+
+/**
+ * Orders the addresses as RFC 8305 section 4 says, alternating
+ * families starting with IPv6
+ */
+QList<QHostAddress> interleave(const QList<QHostAddress> &ipv6, const QList<QHostAddress> &ipv4)
+{
+    QList<QHostAddress> ret;
+    ret.reserve(ipv6.size() + ipv4.size());
+    for (qsizetype i = 0; i < qMax(ipv6.size(), ipv4.size()); ++i) {
+        if (i < ipv6.size()) {
+            ret.append(ipv6[i]);
+        }
+        if (i < ipv4.size()) {
+            ret.append(ipv4[i]);
+        }
+    }
+    return ret;
+}
+
+void hostInfoFallback(const QString &key, const QString &host)
+{
+    QHostInfo::lookupHost(host, [key](const QHostInfo &info) {
+        QList<QHostAddress> ipv6;
+        QList<QHostAddress> ipv4;
+        const auto addresses = info.addresses();
+        for (const QHostAddress &address : addresses) {
+            if (address.protocol() == QAbstractSocket::IPv6Protocol) {
+                ipv6.append(address);
+            } else {
+                ipv4.append(address);
+            }
+        }
+
+        DnsCache::HostResult result;
+        result.addresses = interleave(ipv6, ipv4);
+        if (result.addresses.isEmpty()) {
+            result.error = info.errorString();
+        } else {
+            hostCache.insert(key, result, FallbackTtl);
+        }
+        qCDebug(SIMPLEMAIL_SERVER) << "Host lookup" << key << result.addresses << result.error;
+        notifyHost(key, result);
+    });
+}
+
+DnsCache::MxResult mxResult(QDnsLookup *lookup, const QString &domain, qint64 *ttl)
+{
+    DnsCache::MxResult result;
+    *ttl = NegativeTtl;
+
+    switch (lookup->error()) {
+    case QDnsLookup::NoError:
+        break;
+    case QDnsLookup::NotFoundError:
+        result.status = DnsCache::MxResult::NotFound;
+        result.error  = lookup->errorString();
+        return result;
+    default:
+        result.status = DnsCache::MxResult::Failed;
+        result.error  = lookup->errorString();
+        *ttl          = 0;
+        return result;
+    }
+
+    auto records = lookup->mailExchangeRecords();
+    if (records.isEmpty()) {
+        // RFC 5321 5.1, the domain itself is the implicit MX
+        result.hosts = QStringList{domain};
+        return result;
+    }
+
+    std::sort(records.begin(), records.end(), [](const auto &a, const auto &b) {
+        return a.preference() < b.preference();
+    });
+
+    // Spread the load over exchangers of the same preference
+    auto *rng = QRandomGenerator::global();
+    for (auto it = records.begin(); it != records.end();) {
+        auto end = std::find_if(it, records.end(), [it](const auto &record) {
+            return record.preference() != it->preference();
+        });
+        for (auto i = end - it; i > 1; --i) {
+            std::swap(it[i - 1], it[rng->bounded(int(i))]);
+        }
+        it = end;
+    }
+
+    quint32 minTtl = std::numeric_limits<quint32>::max();
+    for (const auto &record : std::as_const(records)) {
+        QString exchange = record.exchange();
+        if (exchange.endsWith(QLatin1Char('.'))) {
+            exchange.chop(1);
+        }
+        if (!exchange.isEmpty()) {
+            result.hosts.append(exchange);
+        }
+        minTtl = qMin(minTtl, record.timeToLive());
+    }
+    *ttl = minTtl;
+
+    if (result.hosts.isEmpty()) {
+        result.status = DnsCache::MxResult::NullMx;
+    }
+    return result;
+}
+
+} // namespace
+
+void DnsCache::lookupMx(const QString &domain,
+                        const QHostAddress &nameserver,
+                        quint16 port,
+                        QObject *context,
+                        MxCallback callback)
+{
+    const QString name = domain.toLower();
+    const QString key  = cacheKey(name, nameserver, port);
+
+    MxResult cached;
+    if (mxCache.find(key, &cached)) {
+        deliver(context, callback, cached);
+        return;
+    }
+
+    auto pending = mxPending.find(key);
+    if (pending != mxPending.end()) {
+        pending->append({context, std::move(callback)});
+        return;
+    }
+    mxPending.insert(key, {{context, std::move(callback)}});
+
+    auto lookup = createLookup(QDnsLookup::MX, name, nameserver, port);
+    QObject::connect(lookup, &QDnsLookup::finished, lookup, [lookup, key, name] {
+        lookup->deleteLater();
+
+        qint64 ttl;
+        const MxResult result = mxResult(lookup, name, &ttl);
+        qCDebug(SIMPLEMAIL_SERVER) << "MX lookup" << name << result.status << result.hosts << ttl
+                                   << result.error;
+        mxCache.insert(key, result, ttl);
+        notify(mxPending, key, result);
+    });
+    lookup->lookup();
+}
+
+void DnsCache::lookupHost(const QString &host,
+                          const QHostAddress &nameserver,
+                          quint16 port,
+                          QObject *context,
+                          HostCallback callback)
+{
+    HostResult cached;
+    QHostAddress literal;
+    if (literal.setAddress(host)) {
+        cached.addresses = {literal};
+        deliver(context, callback, cached);
+        return;
+    }
+
+    const QString name = host.toLower();
+    const QString key  = cacheKey(name, nameserver, port);
+    if (hostCache.find(key, &cached)) {
+        deliver(context, callback, cached);
+        return;
+    }
+
+    auto pending = hostPending.find(key);
+    if (pending != hostPending.end()) {
+        pending->callbacks.append({context, std::move(callback)});
+        return;
+    }
+    hostPending.insert(key, {{{context, std::move(callback)}}, {}, 0});
+
+    if (nameserver.isNull() && !name.contains(QLatin1Char('.'))) {
+        // Likely in the hosts file or relative to the search domains
+        hostInfoFallback(key, name);
+        return;
+    }
+
+    // Both families are asked at once, reconnects then hit the cache
+    auto state = std::make_shared<HostLookup>();
+    for (const auto type : {QDnsLookup::AAAA, QDnsLookup::A}) {
+        auto lookup = createLookup(type, name, nameserver, port);
+        QObject::connect(
+            lookup, &QDnsLookup::finished, lookup, [lookup, state, key, name, nameserver] {
+            lookup->deleteLater();
+
+            if (lookup->error() == QDnsLookup::NoError) {
+                const auto records = lookup->hostAddressRecords();
+                for (const auto &record : records) {
+                    if (record.value().protocol() == QAbstractSocket::IPv6Protocol) {
+                        state->ipv6.append(record.value());
+                    } else {
+                        state->ipv4.append(record.value());
+                    }
+                    state->ttl = qMin(state->ttl, record.timeToLive());
+                }
+            } else {
+                state->error = lookup->errorString();
+            }
+
+            if (--state->remaining > 0) {
+                // RFC 8305 section 3, connecting starts without waiting for
+                // the A answer, the A one waits a little for the AAAA one
+                if (lookup->type() == QDnsLookup::AAAA && !state->ipv6.isEmpty()) {
+                    state->ipv6Sent = true;
+                    notifyHostPartial(key, state->ipv6);
+                } else if (lookup->type() == QDnsLookup::A && !state->ipv4.isEmpty()) {
+                    QTimer::singleShot(ResolutionDelay, [state, key] {
+                        if (state->remaining > 0) {
+                            state->ipv4Sent = true;
+                            notifyHostPartial(key, state->ipv4);
+                        }
+                    });
+                }
+                return;
+            }
+
+            HostResult result;
+            const QList<QHostAddress> addresses = interleave(state->ipv6, state->ipv4);
+            if (addresses.isEmpty()) {
+                if (nameserver.isNull()) {
+                    hostInfoFallback(key, name);
+                    return;
+                }
+                result.error = state->error.isEmpty()
+                                   ? QStringLiteral("Host %1 has no addresses").arg(name)
+                                   : state->error;
+            } else {
+                result.addresses = addresses;
+                hostCache.insert(key, result, state->ttl);
+
+                // Only the late family is left to send
+                if (state->ipv6Sent) {
+                    result.addresses = state->ipv4;
+                } else if (state->ipv4Sent) {
+                    result.addresses = state->ipv6;
+                }
+            }
+
+            qCDebug(SIMPLEMAIL_SERVER) << "Host lookup" << name << addresses << state->ttl
+                                       << result.error;
+            notifyHost(key, result);
+        });
+        lookup->lookup();
+    }
+}
@@ -0,0 +1,86 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef DNSCACHE_P_H
+#define DNSCACHE_P_H
+
+#include <functional>
+
+#include <QHostAddress>
+#include <QStringList>
+
+class QObject;
+
+namespace SimpleMail {
+
+/**
+ * Process wide cache of DNS answers honouring their TTLs, the lookups
+ * are done asynchronously with QDnsLookup on the calling thread and
+ * concurrent ones for the same name are coalesced
+ */
+class DnsCache
+{
+public:
+    struct MxResult {
+        enum Status {
+            Ok,
+            NotFound, // NXDOMAIN
+            NullMx,   // RFC 7505, the domain accepts no mail
+            Failed,   // Temporary, not cached
+        };
+
+        QStringList hosts; // by preference, the domain itself when it has no MX
+        QString error;
+        Status status = Ok;
+    };
+    using MxCallback = std::function<void(const MxResult &result)>;
+
+    struct HostResult {
+        QList<QHostAddress> addresses; // IPv6 and IPv4 interleaved as in RFC 8305
+        QString error;
+        bool complete = true; // false when more addresses may follow
+    };
+    using HostCallback = std::function<void(const HostResult &result)>;
+
+    /**
+     * Resolves the mail exchangers of domain, callback is always called from
+     * the event loop and only while context is alive. A null nameserver uses
+     * the system's resolver
+     */
+    static void lookupMx(const QString &domain,
+                         const QHostAddress &nameserver,
+                         quint16 port,
+                         QObject *context,
+                         MxCallback callback);
+
+    /**
+     * Resolves the addresses of host in the same way, names without a dot
+     * like localhost, and names the nameserver couldn't resolve when using the
+     * system's resolver, are looked up with QHostInfo and cached for a minute.
+     *
+     * When one family answers first callback gets its addresses right away if
+     * they are IPv6, or after a 50ms resolution delay if they are IPv4, and is
+     * called again with the addresses of the other family once it answers
+     */
+    static void lookupHost(const QString &host,
+                           const QHostAddress &nameserver,
+                           quint16 port,
+                           QObject *context,
+                           HostCallback callback);
+};
+
+} // namespace SimpleMail
+
+#endif // DNSCACHE_P_H
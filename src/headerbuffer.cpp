@@ -0,0 +1,190 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "headerbuffer_p.h"
+
+#include "quotedprintable.h"
+
+#include <QIODevice>
+
+using namespace SimpleMail;
+
+namespace {
+
+// Capacity a buffer starts with, and the most it keeps once released
+constexpr qsizetype InitialCapacity = 1024;
+constexpr qsizetype MaxKeptCapacity = 256 * 1024;
+
+struct ThreadBuffers {
+    QByteArray data;
+    QByteArray scratch;
+    bool inUse = false;
+};
+
+thread_local ThreadBuffers t_buffers;
+
+inline void recycle(QByteArray &buffer)
+{
+    if (buffer.capacity() > MaxKeptCapacity) {
+        buffer = QByteArray();
+    }
+    if (buffer.capacity() == 0) {
+        buffer.reserve(InitialCapacity);
+    }
+
+    // Keeps the capacity, reserve() marks it as wanted on Qt 5 too
+    buffer.resize(0);
+}
+
+} // namespace
+
+HeaderBuffer::HeaderBuffer()
+{
+    if (t_buffers.inUse) {
+        m_data    = &m_ownData;
+        m_scratch = &m_ownScratch;
+        return;
+    }
+
+    t_buffers.inUse = true;
+    m_data          = &t_buffers.data;
+    m_scratch       = &t_buffers.scratch;
+    recycle(*m_data);
+    recycle(*m_scratch);
+}
+
+HeaderBuffer::~HeaderBuffer()
+{
+    if (m_data == &t_buffers.data) {
+        t_buffers.inUse = false;
+    }
+}
+
+HeaderBuffer &HeaderBuffer::appendLatin1(QStringView text)
+{
+    const qsizetype start = m_data->size();
+    m_data->resize(start + text.size());
+
+    char *out = m_data->data() + start;
+    for (const QChar c : text) {
+        const char16_t unicode = c.unicode();
+        *out++                 = unicode < 0x100 ? char(unicode) : '?';
+    }
+    return *this;
+}
+
+HeaderBuffer &HeaderBuffer::appendBase64(const char *data, qsizetype size)
+{
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    const qsizetype start = m_data->size();
+    m_data->resize(start + (size + 2) / 3 * 4);
+
+    auto in   = reinterpret_cast<const uchar *>(data);
+    char *out = m_data->data() + start;
+    for (qsizetype i = 0; i < size; i += 3) {
+        const qsizetype left = size - i;
+        uint chunk           = uint(in[i]) << 16;
+        if (left > 1) {
+            chunk |= uint(in[i + 1]) << 8;
+        }
+        if (left > 2) {
+            chunk |= uint(in[i + 2]);
+        }
+        *out++ = alphabet[(chunk >> 18) & 0x3f];
+        *out++ = alphabet[(chunk >> 12) & 0x3f];
+        *out++ = left > 1 ? alphabet[(chunk >> 6) & 0x3f] : '=';
+        *out++ = left > 2 ? alphabet[chunk & 0x3f] : '=';
+    }
+    return *this;
+}
+
+HeaderBuffer &HeaderBuffer::appendQuotedPrintable(const QByteArray &data, bool rfc2047)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    // Sized for the worst case, then trimmed to what was written
+    const qsizetype start = m_data->size();
+    m_data->resize(start + data.size() * 3);
+
+    char *begin = m_data->data() + start;
+    char *out   = begin;
+    for (const char c : data) {
+        const auto byte = uchar(c);
+        if (QuotedPrintable::requiresEscape(byte, rfc2047)) {
+            *out++ = '=';
+            *out++ = hex[byte >> 4];
+            *out++ = hex[byte & 0x0f];
+        } else {
+            *out++ = c;
+        }
+    }
+    m_data->resize(start + (out - begin));
+    return *this;
+}
+
+void HeaderBuffer::toUtf8(QStringView text, bool simplify, QByteArray &out)
+{
+    out.resize(text.size() * 3);
+
+    auto begin   = reinterpret_cast<uchar *>(out.data());
+    uchar *dst   = begin;
+    bool pending = false;
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        const QChar c = text[i];
+        if (simplify && c.isSpace()) {
+            // Whitespace runs become a single space, none at the ends
+            pending = dst != begin;
+            continue;
+        }
+        if (pending) {
+            *dst++  = ' ';
+            pending = false;
+        }
+
+        uint unicode = c.unicode();
+        if (c.isHighSurrogate() && i + 1 < text.size() && text[i + 1].isLowSurrogate()) {
+            unicode = QChar::surrogateToUcs4(c, text[++i]);
+        } else if (c.isSurrogate()) {
+            unicode = QChar::ReplacementCharacter;
+        }
+
+        if (unicode < 0x80) {
+            *dst++ = uchar(unicode);
+        } else if (unicode < 0x800) {
+            *dst++ = uchar(0xc0 | (unicode >> 6));
+            *dst++ = uchar(0x80 | (unicode & 0x3f));
+        } else if (unicode < 0x10000) {
+            *dst++ = uchar(0xe0 | (unicode >> 12));
+            *dst++ = uchar(0x80 | ((unicode >> 6) & 0x3f));
+            *dst++ = uchar(0x80 | (unicode & 0x3f));
+        } else {
+            // A surrogate pair is two units, so it fits in their six bytes
+            *dst++ = uchar(0xf0 | (unicode >> 18));
+            *dst++ = uchar(0x80 | ((unicode >> 12) & 0x3f));
+            *dst++ = uchar(0x80 | ((unicode >> 6) & 0x3f));
+            *dst++ = uchar(0x80 | (unicode & 0x3f));
+        }
+    }
+    out.resize(dst - begin);
+}
+
+bool HeaderBuffer::write(QIODevice *device) const
+{
+    // Written from the pointer, so the device can't keep a reference to the
+    // buffer that would make the next message reallocate it
+    return device->write(m_data->constData(), m_data->size()) == m_data->size();
+}
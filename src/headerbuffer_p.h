@@ -0,0 +1,104 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef HEADERBUFFER_P_H
+#define HEADERBUFFER_P_H
+
+#include <QByteArray>
+#include <QStringView>
+
+class QIODevice;
+
+namespace SimpleMail {
+
+/**
+ * Headers and boundaries are rendered into a per thread buffer that keeps
+ * its capacity between messages, so once it has grown rendering them no
+ * longer allocates. Only one instance per thread uses it at a time, a
+ * nested one gets a buffer of its own
+ */
+class HeaderBuffer
+{
+public:
+    HeaderBuffer();
+    ~HeaderBuffer();
+
+    inline qsizetype size() const { return m_data->size(); }
+
+    /**
+     * Makes room for extra more bytes at once
+     */
+    inline void reserve(qsizetype extra) { m_data->reserve(m_data->size() + extra); }
+
+    inline HeaderBuffer &append(char c)
+    {
+        m_data->append(c);
+        return *this;
+    }
+    inline HeaderBuffer &append(const char *data, qsizetype size)
+    {
+        m_data->append(data, size);
+        return *this;
+    }
+    template <qsizetype N>
+    inline HeaderBuffer &append(const char (&literal)[N])
+    {
+        return append(literal, N - 1);
+    }
+    inline HeaderBuffer &append(const QByteArray &data)
+    {
+        return append(data.constData(), data.size());
+    }
+
+    /**
+     * Appends text as QString::toLatin1() does, '?' replaces what Latin-1 lacks
+     */
+    HeaderBuffer &appendLatin1(QStringView text);
+    HeaderBuffer &appendBase64(const char *data, qsizetype size);
+    inline HeaderBuffer &appendBase64(const QByteArray &data)
+    {
+        return appendBase64(data.constData(), data.size());
+    }
+
+    /**
+     * Appends data as QuotedPrintable::encode() does
+     */
+    HeaderBuffer &appendQuotedPrintable(const QByteArray &data, bool rfc2047);
+
+    /**
+     * Returns a second buffer of the same lifetime, for intermediate results
+     */
+    inline QByteArray &scratch() { return *m_scratch; }
+
+    /**
+     * Sets out to the UTF-8 of text, simplified like QString::simplified()
+     * when simplify is true, reusing its capacity
+     */
+    static void toUtf8(QStringView text, bool simplify, QByteArray &out);
+
+    bool write(QIODevice *device) const;
+
+private:
+    Q_DISABLE_COPY(HeaderBuffer)
+
+    QByteArray *m_data;
+    QByteArray *m_scratch;
+    QByteArray m_ownData;
+    QByteArray m_ownScratch;
+};
+
+} // namespace SimpleMail
+
+#endif // HEADERBUFFER_P_H
@@ -0,0 +1,732 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "iouringtransport_p.h"
+
+#include <QLoggingCategory>
+#include <QMetaObject>
+#include <QSocketNotifier>
+#include <QVarLengthArray>
+
+#include <cstring>
+#include <liburing.h>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+
+Q_DECLARE_LOGGING_CATEGORY(SIMPLEMAIL_SERVER)
+
+namespace SimpleMail {
+
+struct IoUringOperation {
+    enum Type {
+        Connect,
+        Read,
+        Write,
+    };
+
+    IoUringOperation(IoUringTransport *transport, Type opType)
+        : owner(transport)
+        , type(opType)
+    {
+    }
+
+    IoUringTransport *owner;
+    QByteArray data;
+    sockaddr_storage address = {};
+    Type type;
+    int bufferIndex = -1; // registered buffer held until the kernel is done with it
+};
+
+/**
+ * One ring per thread shared by all of its transports, completions
+ * are signaled through an eventfd watched by the Qt event loop.
+ */
+class IoUringLoop : public QObject
+{
+public:
+    enum {
+        QueueDepth        = 4096,
+        BufferCount       = 64,
+        BufferSize        = 64 * 1024,
+        ZeroCopyThreshold = 16 * 1024,
+        ReadSize          = 16 * 1024,
+    };
+
+    static IoUringLoop *instance();
+    ~IoUringLoop() override;
+
+    io_uring_sqe *sqe();
+    void scheduleWrite(IoUringTransport *transport);
+    void unscheduleWrite(IoUringTransport *transport);
+
+    /**
+     * Returns a free registered buffer holding one reference, -1 if none
+     */
+    int acquireBuffer();
+    void retainBuffer(int index);
+    void releaseBuffer(int index);
+    char *buffer(int index) const;
+    bool zeroCopy() const;
+
+private:
+    IoUringLoop() = default;
+    bool init();
+    void scheduleSubmit();
+    void submit();
+    void processCompletions();
+    void release(IoUringOperation *op);
+
+    io_uring m_ring;
+    std::unique_ptr<char[]> m_bufferPool;
+    QList<int> m_freeBuffers;
+    QList<int> m_bufferRefs;
+    QList<IoUringTransport *> m_pendingWrites;
+    QSocketNotifier *m_notifier = nullptr;
+    int m_eventFd               = -1;
+    bool m_ringInitialized      = false;
+    bool m_submitScheduled      = false;
+    bool m_zeroCopy             = false;
+};
+
+} // namespace SimpleMail
+
+using namespace SimpleMail;
+
+IoUringLoop *IoUringLoop::instance()
+{
+    thread_local std::unique_ptr<IoUringLoop> loop;
+    thread_local bool initialized = false;
+
+    if (!initialized) {
+        initialized = true;
+        std::unique_ptr<IoUringLoop> candidate(new IoUringLoop);
+        if (candidate->init()) {
+            loop = std::move(candidate);
+        } else {
+            qCInfo(SIMPLEMAIL_SERVER) << "io_uring is not available, using Qt sockets";
+        }
+    }
+    return loop.get();
+}
+
+IoUringLoop::~IoUringLoop()
+{
+    if (m_ringInitialized) {
+        io_uring_queue_exit(&m_ring);
+    }
+    if (m_eventFd != -1) {
+        ::close(m_eventFd);
+    }
+}
+
+bool IoUringLoop::init()
+{
+    int ret = io_uring_queue_init(QueueDepth, &m_ring, 0);
+    if (ret < 0) {
+        qCDebug(SIMPLEMAIL_SERVER) << "io_uring_queue_init failed" << qt_error_string(-ret);
+        return false;
+    }
+    m_ringInitialized = true;
+
+    m_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_eventFd == -1 || io_uring_register_eventfd(&m_ring, m_eventFd) < 0) {
+        qCDebug(SIMPLEMAIL_SERVER) << "Failed to register io_uring eventfd";
+        return false;
+    }
+
+    io_uring_probe *probe = io_uring_get_probe_ring(&m_ring);
+    if (probe) {
+        m_zeroCopy = io_uring_opcode_supported(probe, IORING_OP_SEND_ZC);
+        io_uring_free_probe(probe);
+    }
+
+    if (m_zeroCopy) {
+        // Zero-copy sends need the pages pinned, register them once upfront
+        m_bufferPool.reset(new char[BufferCount * BufferSize]);
+        QVarLengthArray<iovec, BufferCount> iovecs;
+        for (int i = 0; i < BufferCount; ++i) {
+            iovecs.append({m_bufferPool.get() + i * BufferSize, BufferSize});
+        }
+
+        ret = io_uring_register_buffers(&m_ring, iovecs.constData(), unsigned(iovecs.size()));
+        if (ret < 0) {
+            qCDebug(SIMPLEMAIL_SERVER)
+                << "Failed to register io_uring buffers" << qt_error_string(-ret);
+            m_bufferPool.reset();
+            m_zeroCopy = false;
+        } else {
+            m_bufferRefs.fill(0, BufferCount);
+            for (int i = 0; i < BufferCount; ++i) {
+                m_freeBuffers.append(i);
+            }
+        }
+    }
+
+    m_notifier = new QSocketNotifier(m_eventFd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, [this] { processCompletions(); });
+
+    qCDebug(SIMPLEMAIL_SERVER) << "io_uring ready, zero-copy" << m_zeroCopy;
+    return true;
+}
+
+io_uring_sqe *IoUringLoop::sqe()
+{
+    io_uring_sqe *sqe = io_uring_get_sqe(&m_ring);
+    if (!sqe) {
+        // The submission queue is full, flush it right away
+        io_uring_submit(&m_ring);
+        sqe = io_uring_get_sqe(&m_ring);
+    }
+    Q_ASSERT(sqe);
+
+    scheduleSubmit();
+    return sqe;
+}
+
+void IoUringLoop::scheduleWrite(IoUringTransport *transport)
+{
+    m_pendingWrites.append(transport);
+    scheduleSubmit();
+}
+
+void IoUringLoop::unscheduleWrite(IoUringTransport *transport)
+{
+    m_pendingWrites.removeOne(transport);
+}
+
+int IoUringLoop::acquireBuffer()
+{
+    if (m_freeBuffers.isEmpty()) {
+        return -1;
+    }
+
+    const int index     = m_freeBuffers.takeLast();
+    m_bufferRefs[index] = 1;
+    return index;
+}
+
+void IoUringLoop::retainBuffer(int index)
+{
+    ++m_bufferRefs[index];
+}
+
+void IoUringLoop::releaseBuffer(int index)
+{
+    // Held by the chunk filling it and by each send from it
+    if (--m_bufferRefs[index] == 0) {
+        m_freeBuffers.append(index);
+    }
+}
+
+char *IoUringLoop::buffer(int index) const
+{
+    return m_bufferPool.get() + index * BufferSize;
+}
+
+bool IoUringLoop::zeroCopy() const
+{
+    return m_zeroCopy;
+}
+
+void IoUringLoop::scheduleSubmit()
+{
+    // All connections of this thread share a single submission
+    // per event loop iteration
+    if (!m_submitScheduled) {
+        m_submitScheduled = true;
+        QMetaObject::invokeMethod(this, [this] { submit(); }, Qt::QueuedConnection);
+    }
+}
+
+void IoUringLoop::submit()
+{
+    // Writes are gathered until now so that pipelined commands and
+    // message data written separately go out in one send
+    const QList<IoUringTransport *> pending = std::move(m_pendingWrites);
+    m_pendingWrites.clear();
+    for (IoUringTransport *transport : pending) {
+        transport->m_writeScheduled = false;
+        transport->submitWrite();
+    }
+
+    m_submitScheduled = false;
+    const int ret     = io_uring_submit(&m_ring);
+    if (ret < 0) {
+        qCWarning(SIMPLEMAIL_SERVER) << "io_uring_submit failed" << qt_error_string(-ret);
+    }
+}
+
+void IoUringLoop::processCompletions()
+{
+    eventfd_t value;
+    eventfd_read(m_eventFd, &value);
+
+    struct Completion {
+        IoUringOperation *op;
+        int result;
+        unsigned flags;
+    };
+
+    // Collected first since handlers might spin a nested event loop
+    QVarLengthArray<Completion, 64> completions;
+    io_uring_cqe *cqe;
+    unsigned head;
+    unsigned count = 0;
+    io_uring_for_each_cqe(&m_ring, head, cqe) {
+        ++count;
+        auto op = static_cast<IoUringOperation *>(io_uring_cqe_get_data(cqe));
+        if (op) {
+            completions.append({op, cqe->res, cqe->flags});
+        }
+    }
+    io_uring_cq_advance(&m_ring, count);
+
+    for (const Completion &completion : std::as_const(completions)) {
+        IoUringOperation *op = completion.op;
+        if (completion.flags & IORING_CQE_F_NOTIF) {
+            // The kernel is done with the zero-copy buffer
+            release(op);
+            continue;
+        }
+
+        IoUringTransport *owner = std::exchange(op->owner, nullptr);
+        if (owner) {
+            owner->completed(op, completion.result);
+        }
+
+        if (!(completion.flags & IORING_CQE_F_MORE)) {
+            release(op);
+        }
+    }
+}
+
+void IoUringLoop::release(IoUringOperation *op)
+{
+    if (op->bufferIndex != -1) {
+        releaseBuffer(op->bufferIndex);
+    }
+    delete op;
+}
+
+IoUringTransport::IoUringTransport(QObject *parent)
+    : Transport(parent)
+    , m_loop(IoUringLoop::instance())
+{
+    Q_ASSERT(m_loop);
+}
+
+IoUringTransport::~IoUringTransport()
+{
+    if (m_writeScheduled) {
+        m_loop->unscheduleWrite(this);
+    }
+    abortOperations();
+    releaseChunks();
+}
+
+bool IoUringTransport::isAvailable()
+{
+    return IoUringLoop::instance() != nullptr;
+}
+
+void IoUringTransport::setNameserver(const QHostAddress &address, quint16 port)
+{
+    m_nameserver     = address;
+    m_nameserverPort = port;
+}
+
+Transport::Capabilities IoUringTransport::capabilities() const
+{
+    return m_loop->zeroCopy() ? ZeroCopy : NoCapabilities;
+}
+
+void IoUringTransport::connectToHost(const QString &host, quint16 port)
+{
+    m_port         = port;
+    m_closing      = false;
+    m_connectError = 0;
+
+    QHostAddress address;
+    if (address.setAddress(host)) {
+        m_addresses = {address};
+        connectNext();
+        return;
+    }
+
+    // Addresses are tried one after the other, alternating families, the
+    // ones of a family that answers late are tried after those already known
+    qCDebug(SIMPLEMAIL_SERVER) << "Looking up host" << host;
+    const int id = m_lookupId = m_lookups++;
+    DnsCache::lookupHost(
+        host, m_nameserver, m_nameserverPort, this, [this, id](const DnsCache::HostResult &result) {
+        if (id == m_lookupId) {
+            hostFound(result);
+        }
+    });
+}
+
+void IoUringTransport::disconnectFromHost()
+{
+    if (bytesToWrite() > 0 && isOpen()) {
+        // Closed once the pending data is sent
+        m_closing = true;
+        return;
+    }
+    shutdown();
+}
+
+qint64 IoUringTransport::bytesAvailable() const
+{
+    return Transport::bytesAvailable() + m_inbound.size() - m_readPos;
+}
+
+qint64 IoUringTransport::bytesToWrite() const
+{
+    return m_bytesToWrite;
+}
+
+bool IoUringTransport::canReadLine() const
+{
+    return Transport::canReadLine() || m_inbound.indexOf('\n', int(m_readPos)) != -1;
+}
+
+void IoUringTransport::close()
+{
+    shutdown();
+}
+
+qint64 IoUringTransport::readData(char *data, qint64 maxSize)
+{
+    const qint64 size = qMin<qint64>(maxSize, m_inbound.size() - m_readPos);
+    memcpy(data, m_inbound.constData() + m_readPos, size_t(size));
+    m_readPos += size;
+
+    if (m_readPos == m_inbound.size()) {
+        m_inbound.clear();
+        m_readPos = 0;
+    }
+    return size;
+}
+
+qint64 IoUringTransport::readLineData(char *data, qint64 maxSize)
+{
+    const auto eol = m_inbound.indexOf('\n', int(m_readPos));
+    if (eol != -1) {
+        maxSize = qMin<qint64>(maxSize, eol + 1 - m_readPos);
+    }
+    return readData(data, maxSize);
+}
+
+qint64 IoUringTransport::writeData(const char *data, qint64 size)
+{
+    if (m_fd == -1) {
+        return -1;
+    }
+
+    m_bytesToWrite += size;
+    while (size > 0) {
+        // The chunk in flight may still grow, its sends cover what it had then
+        IoUringChunk *tail = m_outbound.isEmpty() ? nullptr : &m_outbound.last();
+        if (tail && tail->bufferIndex != -1 && tail->size < IoUringLoop::BufferSize) {
+            const qint64 length = qMin<qint64>(size, IoUringLoop::BufferSize - tail->size);
+            memcpy(m_loop->buffer(tail->bufferIndex) + tail->size, data, size_t(length));
+            tail->size += length;
+            data += length;
+            size -= length;
+            continue;
+        }
+
+        const int index = m_loop->zeroCopy() ? m_loop->acquireBuffer() : -1;
+        if (index != -1) {
+            IoUringChunk chunk;
+            chunk.bufferIndex = index;
+            m_outbound.append(chunk);
+            continue;
+        }
+
+        // Without a registered buffer data is appended to a heap chunk,
+        // unless a send shares it
+        if (!tail || tail->bufferIndex != -1 || (m_writeOp && m_outbound.size() == 1)) {
+            m_outbound.append(IoUringChunk());
+            tail = &m_outbound.last();
+        }
+        tail->data.append(data, int(size));
+        tail->size = tail->data.size();
+        break;
+    }
+
+    if (!m_writeScheduled) {
+        m_writeScheduled = true;
+        m_loop->scheduleWrite(this);
+    }
+    return size;
+}
+
+void IoUringTransport::hostFound(const DnsCache::HostResult &result)
+{
+    if (result.complete) {
+        m_lookupId = -1;
+    }
+    m_addresses += result.addresses;
+
+    if (m_connectOp) {
+        // Tried once the attempt in progress fails
+        return;
+    }
+
+    if (!m_addresses.isEmpty()) {
+        connectNext();
+    } else if (result.complete) {
+        if (m_connectError) {
+            failed(m_connectError);
+            return;
+        }
+        setErrorString(result.error);
+        Q_EMIT errorOccurred(errorString());
+        Q_EMIT disconnected();
+    }
+}
+
+void IoUringTransport::connectNext()
+{
+    const QHostAddress address = m_addresses.takeFirst();
+    qCDebug(SIMPLEMAIL_SERVER) << "Connecting to host" << address << m_port;
+
+    auto op = new IoUringOperation(this, IoUringOperation::Connect);
+    socklen_t length;
+    if (address.protocol() == QAbstractSocket::IPv6Protocol) {
+        auto sin6         = reinterpret_cast<sockaddr_in6 *>(&op->address);
+        const auto ip6    = address.toIPv6Address();
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port   = htons(m_port);
+        memcpy(&sin6->sin6_addr, &ip6, sizeof(ip6));
+        sin6->sin6_scope_id = address.scopeId().toUInt();
+        length              = sizeof(sockaddr_in6);
+    } else {
+        auto sin             = reinterpret_cast<sockaddr_in *>(&op->address);
+        sin->sin_family      = AF_INET;
+        sin->sin_port        = htons(m_port);
+        sin->sin_addr.s_addr = htonl(address.toIPv4Address());
+        length               = sizeof(sockaddr_in);
+    }
+
+    m_fd = ::socket(op->address.ss_family, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (m_fd == -1) {
+        const int error = errno;
+        delete op;
+        failed(error);
+        return;
+    }
+
+    // SMTP is a conversation of small commands
+    const int one = 1;
+    setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    io_uring_sqe *sqe = m_loop->sqe();
+    io_uring_prep_connect(sqe, m_fd, reinterpret_cast<sockaddr *>(&op->address), length);
+    io_uring_sqe_set_data(sqe, op);
+    m_connectOp = op;
+}
+
+void IoUringTransport::submitRead()
+{
+    if (m_readOp || m_fd == -1) {
+        return;
+    }
+
+    auto op = new IoUringOperation(this, IoUringOperation::Read);
+    op->data.resize(IoUringLoop::ReadSize);
+
+    io_uring_sqe *sqe = m_loop->sqe();
+    io_uring_prep_recv(sqe, m_fd, op->data.data(), size_t(op->data.size()), 0);
+    io_uring_sqe_set_data(sqe, op);
+    m_readOp = op;
+}
+
+void IoUringTransport::submitWrite()
+{
+    if (m_writeOp || m_fd == -1 || !isOpen() || m_bytesToWrite == 0) {
+        return;
+    }
+
+    // Only one send is in flight so partial sends keep the order, the
+    // operation holds the data in case the transport goes away first
+    const IoUringChunk &chunk = m_outbound.first();
+    const size_t size         = size_t(chunk.size - chunk.sent);
+    auto op                   = new IoUringOperation(this, IoUringOperation::Write);
+    io_uring_sqe *sqe         = m_loop->sqe();
+    if (chunk.bufferIndex == -1) {
+        op->data = chunk.data;
+        io_uring_prep_send(sqe, m_fd, op->data.constData() + chunk.sent, size, MSG_NOSIGNAL);
+    } else {
+        op->bufferIndex = chunk.bufferIndex;
+        m_loop->retainBuffer(op->bufferIndex);
+
+        const char *data = m_loop->buffer(op->bufferIndex) + chunk.sent;
+        if (size >= IoUringLoop::ZeroCopyThreshold) {
+            io_uring_prep_send_zc_fixed(
+                sqe, m_fd, data, size, MSG_NOSIGNAL, 0, unsigned(op->bufferIndex));
+        } else {
+            // Small sends, like commands, are cheaper to copy than to pin
+            io_uring_prep_send(sqe, m_fd, data, size, MSG_NOSIGNAL);
+        }
+    }
+    io_uring_sqe_set_data(sqe, op);
+    m_writeOp = op;
+}
+
+void IoUringTransport::completed(IoUringOperation *op, int result)
+{
+    switch (op->type) {
+    case IoUringOperation::Connect:
+        m_connectOp = nullptr;
+        if (result < 0) {
+            ::close(m_fd);
+            m_fd = -1;
+            if (!m_addresses.isEmpty()) {
+                connectNext();
+            } else if (m_lookupId != -1) {
+                // The other family may still answer
+                m_connectError = -result;
+            } else {
+                failed(-result);
+            }
+            return;
+        }
+
+        // Addresses still to come are ignored
+        m_lookupId = -1;
+        m_addresses.clear();
+        open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+        submitRead();
+        Q_EMIT connected();
+        break;
+    case IoUringOperation::Read:
+        m_readOp = nullptr;
+        if (result <= 0) {
+            // Zero means the peer closed the connection
+            if (result < 0 && result != -ECANCELED) {
+                failed(-result);
+            } else {
+                shutdown();
+            }
+            return;
+        }
+
+        m_inbound.append(op->data.constData(), result);
+        submitRead();
+        Q_EMIT readyRead();
+        break;
+    case IoUringOperation::Write:
+        m_writeOp = nullptr;
+        if (result < 0) {
+            failed(-result);
+            return;
+        }
+
+        m_bytesToWrite -= result;
+        m_outbound.first().sent += result;
+        if (m_outbound.first().sent == m_outbound.first().size) {
+            // A registered buffer isn't refilled, sends from it might not be done
+            const IoUringChunk chunk = m_outbound.takeFirst();
+            if (chunk.bufferIndex != -1) {
+                m_loop->releaseBuffer(chunk.bufferIndex);
+            }
+        }
+        Q_EMIT bytesWritten(result);
+
+        if (m_bytesToWrite > 0) {
+            submitWrite();
+        } else if (m_closing) {
+            shutdown();
+        }
+        break;
+    }
+}
+
+void IoUringTransport::failed(int error)
+{
+    qCDebug(SIMPLEMAIL_SERVER) << "io_uring transport error" << qt_error_string(error);
+    setErrorString(qt_error_string(error));
+    Q_EMIT errorOccurred(errorString());
+
+    if (m_fd == -1 && !isOpen()) {
+        // Connecting failed, nothing to shut down
+        Q_EMIT disconnected();
+    } else {
+        shutdown();
+    }
+}
+
+void IoUringTransport::abortOperations()
+{
+    for (IoUringOperation *op : {m_connectOp, m_readOp, m_writeOp}) {
+        if (op) {
+            // The operation outlives us until its completion arrives
+            op->owner         = nullptr;
+            io_uring_sqe *sqe = m_loop->sqe();
+            io_uring_prep_cancel(sqe, op, 0);
+            io_uring_sqe_set_data(sqe, nullptr);
+        }
+    }
+    m_connectOp = nullptr;
+    m_readOp    = nullptr;
+    m_writeOp   = nullptr;
+
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void IoUringTransport::releaseChunks()
+{
+    for (const IoUringChunk &chunk : std::as_const(m_outbound)) {
+        if (chunk.bufferIndex != -1) {
+            m_loop->releaseBuffer(chunk.bufferIndex);
+        }
+    }
+    m_outbound.clear();
+    m_bytesToWrite = 0;
+}
+
+void IoUringTransport::shutdown()
+{
+    if (m_fd == -1 && m_lookupId == -1 && !isOpen()) {
+        return;
+    }
+
+    // A pending lookup's answer is ignored
+    m_lookupId = -1;
+    abortOperations();
+
+    m_inbound.clear();
+    releaseChunks();
+    m_readPos = 0;
+    m_closing = false;
+    m_addresses.clear();
+
+    if (isOpen()) {
+        Transport::close();
+    }
+    Q_EMIT disconnected();
+}
+
+#include "moc_iouringtransport.cpp"
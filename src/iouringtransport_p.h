@@ -0,0 +1,119 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef IOURINGTRANSPORT_P_H
+#define IOURINGTRANSPORT_P_H
+
+#include "dnscache_p.h"
+#include "transport.h"
+
+#include <QHostAddress>
+
+
+namespace SimpleMail {
+
+class IoUringLoop;
+struct IoUringOperation;
+
+/**
+ * Outbound data waiting to be sent, either in a buffer registered with
+ * the ring or on the heap when none was free
+ */
+struct IoUringChunk {
+    QByteArray data;
+    qsizetype size  = 0;
+    qsizetype sent  = 0;
+    int bufferIndex = -1;
+};
+
+/**
+ * TCP transport that submits connect, send and receive operations of
+ * every connection on a thread through one shared io_uring, so that a
+ * single syscall per event loop iteration serves all of them.
+ *
+ * When the kernel supports zero-copy sends, written data is copied once
+ * straight into buffers registered with the ring, and large sends from
+ * them skip the kernel's copy. Otherwise writes are gathered on the heap
+ * and sent from there.
+ */
+class IoUringTransport : public Transport
+{
+    Q_OBJECT
+public:
+    explicit IoUringTransport(QObject *parent = nullptr);
+    ~IoUringTransport() override;
+
+    /**
+     * Returns true if io_uring can be used on the calling thread, it might
+     * be missing on older kernels or disabled by policy
+     */
+    static bool isAvailable();
+
+    /**
+     * Defines the nameserver used to resolve the host, a null address
+     * uses the system's resolver
+     */
+    void setNameserver(const QHostAddress &address, quint16 port);
+
+    Capabilities capabilities() const override;
+    void connectToHost(const QString &host, quint16 port) override;
+    void disconnectFromHost() override;
+
+    qint64 bytesAvailable() const override;
+    qint64 bytesToWrite() const override;
+    bool canReadLine() const override;
+    void close() override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 readLineData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 size) override;
+
+private:
+    friend class IoUringLoop;
+
+    void hostFound(const DnsCache::HostResult &result);
+    void connectNext();
+    void submitRead();
+    void submitWrite();
+    void completed(IoUringOperation *op, int result);
+    void releaseChunks();
+    void failed(int error);
+    void abortOperations();
+    void shutdown();
+
+    IoUringLoop *m_loop;
+    QList<QHostAddress> m_addresses;
+    QHostAddress m_nameserver;
+    QByteArray m_inbound;
+    QList<IoUringChunk> m_outbound; // the first one is being sent
+    qsizetype m_readPos           = 0;
+    qint64 m_bytesToWrite         = 0;
+    IoUringOperation *m_connectOp = nullptr;
+    IoUringOperation *m_readOp    = nullptr;
+    IoUringOperation *m_writeOp   = nullptr;
+    int m_lookupId                = -1; // the pending lookup
+    int m_connectError            = 0;  // of the last address, while more may follow
+    int m_lookups                 = 0;
+    int m_fd                      = -1;
+    quint16 m_nameserverPort      = 53;
+    quint16 m_port                = 0;
+    bool m_closing                = false;
+    bool m_writeScheduled         = false;
+};
+
+} // namespace SimpleMail
+
+#endif // IOURINGTRANSPORT_P_H
@@ -0,0 +1,154 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "latencyhistogram_p.h"
+
+#include <cmath>
+
+#include <QtCore/qalgorithms.h>
+
+using namespace SimpleMail;
+
+LatencyHistogram::LatencyHistogram()
+    : d_ptr(new LatencyHistogramPrivate)
+{
+}
+
+LatencyHistogram::LatencyHistogram(const LatencyHistogram &other)
+    : d_ptr(other.d_ptr)
+{
+}
+
+LatencyHistogram::~LatencyHistogram()
+{
+}
+
+LatencyHistogram &LatencyHistogram::operator=(const LatencyHistogram &other)
+{
+    d_ptr = other.d_ptr;
+    return *this;
+}
+
+quint64 LatencyHistogram::count() const
+{
+    Q_D(const LatencyHistogram);
+    return d->count;
+}
+
+quint64 LatencyHistogram::sum() const
+{
+    Q_D(const LatencyHistogram);
+    return d->sum;
+}
+
+qint64 LatencyHistogram::mean() const
+{
+    Q_D(const LatencyHistogram);
+    return d->count ? qint64(d->sum / d->count) : 0;
+}
+
+qint64 LatencyHistogram::max() const
+{
+    Q_D(const LatencyHistogram);
+    return d->max;
+}
+
+qint64 LatencyHistogram::percentile(double percent) const
+{
+    Q_D(const LatencyHistogram);
+    if (d->count == 0) {
+        return 0;
+    }
+
+    const double fraction = qBound(0.0, percent, 100.0) / 100;
+    const auto rank       = qBound<quint64>(1, quint64(std::ceil(fraction * d->count)), d->count);
+
+    quint64 seen = 0;
+    for (int i = 0; i < LatencyHistogramPrivate::BucketCount; ++i) {
+        seen += d->buckets[i];
+        if (seen >= rank) {
+            return qMin(LatencyHistogramPrivate::upperBound(i), d->max);
+        }
+    }
+    return d->max;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    Q_D(LatencyHistogram);
+    const LatencyHistogramPrivate *o = other.d_func();
+    for (int i = 0; i < LatencyHistogramPrivate::BucketCount; ++i) {
+        d->buckets[i] += o->buckets[i];
+    }
+    d->count += o->count;
+    d->sum += o->sum;
+    d->max = qMax(d->max, o->max);
+}
+
+LatencyHistogramPrivate *LatencyHistogram::d_func()
+{
+    return d_ptr.data();
+}
+
+int LatencyHistogramPrivate::bucket(qint64 value)
+{
+    if (value < LinearBuckets) {
+        return int(qMax<qint64>(0, value));
+    }
+
+    const int msb   = qMin(63 - qCountLeadingZeroBits(quint64(value)), MaxExponent);
+    const int shift = msb - SubBucketBits;
+    if (msb == MaxExponent && (value >> shift) > (2 << SubBucketBits) - 1) {
+        return BucketCount - 1;
+    }
+    return LinearBuckets + (msb - SubBucketBits - 1) * (1 << SubBucketBits) +
+           int(value >> shift) - (1 << SubBucketBits);
+}
+
+qint64 LatencyHistogramPrivate::upperBound(int bucket)
+{
+    if (bucket < LinearBuckets) {
+        return bucket;
+    }
+
+    const int index = bucket - LinearBuckets;
+    const int shift = index >> SubBucketBits;
+    const int sub   = index & ((1 << SubBucketBits) - 1);
+    return ((qint64((1 << SubBucketBits) + sub + 1)) << (shift + 1)) - 1;
+}
+
+void LatencyRecorder::record(qint64 usec)
+{
+    usec = qMax<qint64>(0, usec);
+    m_buckets[LatencyHistogramPrivate::bucket(usec)].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(quint64(usec), std::memory_order_relaxed);
+
+    qint64 max = m_max.load(std::memory_order_relaxed);
+    while (usec > max && !m_max.compare_exchange_weak(max, usec, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram LatencyRecorder::snapshot() const
+{
+    LatencyHistogram ret;
+    LatencyHistogramPrivate *d = ret.d_func();
+    for (int i = 0; i < LatencyHistogramPrivate::BucketCount; ++i) {
+        d->buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        d->count += d->buckets[i];
+    }
+    d->sum = m_sum.load(std::memory_order_relaxed);
+    d->max = m_max.load(std::memory_order_relaxed);
+    return ret;
+}
@@ -0,0 +1,85 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#pragma once
+
+#include "smtpexports.h"
+
+#include <QtCore/QSharedDataPointer>
+
+namespace SimpleMail {
+
+class LatencyHistogramPrivate;
+/**
+ * A snapshot of latencies in microseconds, counted in logarithmic buckets
+ * eight per power of two, so percentiles are within 12.5% of the real value.
+ * See Server::latencyHistogram()
+ */
+class SMTP_EXPORT LatencyHistogram
+{
+public:
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram &other);
+    virtual ~LatencyHistogram();
+
+    LatencyHistogram &operator=(const LatencyHistogram &other);
+
+    /**
+     * Returns the number of recorded values
+     */
+    quint64 count() const;
+
+    /**
+     * Returns the sum of the recorded values
+     */
+    quint64 sum() const;
+
+    /**
+     * Returns the average of the recorded values
+     */
+    qint64 mean() const;
+
+    /**
+     * Returns the largest recorded value
+     */
+    qint64 max() const;
+
+    /**
+     * Returns the value below which percent of the recorded values are,
+     * e.g. 99.9, or 0 if nothing was recorded
+     */
+    qint64 percentile(double percent) const;
+
+    inline qint64 p50() const { return percentile(50); }
+    inline qint64 p99() const { return percentile(99); }
+    inline qint64 p999() const { return percentile(99.9); }
+
+    /**
+     * Adds the values of other, e.g. to aggregate several servers
+     */
+    void merge(const LatencyHistogram &other);
+
+protected:
+    QSharedDataPointer<LatencyHistogramPrivate> d_ptr;
+
+private:
+    friend class LatencyRecorder;
+
+    // Q_DECLARE_PRIVATE equivalent for shared data pointers
+    LatencyHistogramPrivate *d_func();
+    inline const LatencyHistogramPrivate *d_func() const { return d_ptr.constData(); }
+};
+
+} // namespace SimpleMail
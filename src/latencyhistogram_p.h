@@ -0,0 +1,64 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef LATENCYHISTOGRAM_P_H
+#define LATENCYHISTOGRAM_P_H
+
+#include "latencyhistogram.h"
+
+#include <array>
+#include <atomic>
+
+namespace SimpleMail {
+
+class LatencyHistogramPrivate : public QSharedData
+{
+public:
+    // Values below 16 have a bucket each, above that every power of two
+    // up to 2^40 (twelve days) is split in eight
+    static constexpr int SubBucketBits = 3;
+    static constexpr int LinearBuckets = 2 << SubBucketBits;
+    static constexpr int MaxExponent   = 40;
+    static constexpr int BucketCount =
+        LinearBuckets + (MaxExponent - SubBucketBits) * (1 << SubBucketBits);
+
+    static int bucket(qint64 value);
+    static qint64 upperBound(int bucket);
+
+    std::array<quint64, BucketCount> buckets{};
+    quint64 count = 0;
+    quint64 sum   = 0;
+    qint64 max    = 0;
+};
+
+/**
+ * Records latencies from one thread with relaxed atomic increments, so
+ * snapshots can be taken from any thread without locking
+ */
+class LatencyRecorder
+{
+public:
+    void record(qint64 usec);
+    LatencyHistogram snapshot() const;
+
+private:
+    std::atomic<quint64> m_buckets[LatencyHistogramPrivate::BucketCount]{};
+    std::atomic<quint64> m_sum{0};
+    std::atomic<qint64> m_max{0};
+};
+
+} // namespace SimpleMail
+
+#endif // LATENCYHISTOGRAM_P_H
@@ -0,0 +1,178 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "loopbacktransport_p.h"
+
+#include <QMetaObject>
+#include <QTimer>
+
+#include <cstring>
+
+using namespace SimpleMail;
+
+LoopbackTransport::LoopbackTransport(QObject *parent)
+    : Transport(parent)
+    , d_ptr(new LoopbackTransportPrivate(this))
+{
+}
+
+LoopbackTransport::~LoopbackTransport()
+{
+    delete d_ptr;
+}
+
+SmtpResponder *LoopbackTransport::responder() const
+{
+    Q_D(const LoopbackTransport);
+    return const_cast<SmtpResponder *>(&d->responder);
+}
+
+Transport::Capabilities LoopbackTransport::capabilities() const
+{
+    return Local;
+}
+
+void LoopbackTransport::connectToHost(const QString &host, quint16 port)
+{
+    Q_UNUSED(host)
+    Q_UNUSED(port)
+
+    // Like a socket the connection is only established from the event loop
+    QTimer::singleShot(0, this, [this] {
+        Q_D(LoopbackTransport);
+        if (isOpen()) {
+            return;
+        }
+
+        open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+        Q_EMIT connected();
+        d->deliver(d->responder.startSession());
+    });
+}
+
+void LoopbackTransport::disconnectFromHost()
+{
+    Q_D(LoopbackTransport);
+    d->closing = true;
+    d->schedule();
+}
+
+qint64 LoopbackTransport::bytesAvailable() const
+{
+    Q_D(const LoopbackTransport);
+    return Transport::bytesAvailable() + d->inbound.size() - d->readPos;
+}
+
+bool LoopbackTransport::canReadLine() const
+{
+    Q_D(const LoopbackTransport);
+    return Transport::canReadLine() || d->inbound.indexOf('\n', int(d->readPos)) != -1;
+}
+
+void LoopbackTransport::close()
+{
+    Q_D(LoopbackTransport);
+    if (!isOpen()) {
+        return;
+    }
+
+    d->inbound.clear();
+    d->readPos = 0;
+    d->closing = false;
+    Transport::close();
+    Q_EMIT disconnected();
+}
+
+qint64 LoopbackTransport::readData(char *data, qint64 maxSize)
+{
+    Q_D(LoopbackTransport);
+    const qint64 size = qMin<qint64>(maxSize, d->inbound.size() - d->readPos);
+    memcpy(data, d->inbound.constData() + d->readPos, size_t(size));
+    d->readPos += size;
+
+    if (d->readPos == d->inbound.size()) {
+        d->inbound.clear();
+        d->readPos = 0;
+    }
+    return size;
+}
+
+qint64 LoopbackTransport::readLineData(char *data, qint64 maxSize)
+{
+    Q_D(LoopbackTransport);
+    const auto eol = d->inbound.indexOf('\n', int(d->readPos));
+    if (eol != -1) {
+        maxSize = qMin<qint64>(maxSize, eol + 1 - d->readPos);
+    }
+    return readData(data, maxSize);
+}
+
+qint64 LoopbackTransport::writeData(const char *data, qint64 size)
+{
+    Q_D(LoopbackTransport);
+    const QByteArray replies = d->responder.process(data, size);
+    if (!replies.isEmpty()) {
+        d->deliver(replies);
+    }
+
+    if (d->responder.quitReceived()) {
+        d->closing = true;
+    }
+
+    d->written += size;
+    d->schedule();
+
+    return size;
+}
+
+void LoopbackTransportPrivate::deliver(const QByteArray &data)
+{
+    inbound.append(data);
+    schedule();
+}
+
+void LoopbackTransportPrivate::schedule()
+{
+    Q_Q(LoopbackTransport);
+
+    // Replies are delivered from the event loop so that the
+    // reader is never reentered from its own write()
+    if (!scheduled) {
+        scheduled = true;
+        QMetaObject::invokeMethod(q, [this] { flush(); }, Qt::QueuedConnection);
+    }
+}
+
+void LoopbackTransportPrivate::flush()
+{
+    Q_Q(LoopbackTransport);
+
+    scheduled = false;
+    if (written) {
+        const qint64 bytes = written;
+        written            = 0;
+        Q_EMIT q->bytesWritten(bytes);
+    }
+
+    if (readPos < inbound.size()) {
+        Q_EMIT q->readyRead();
+    }
+
+    if (closing) {
+        q->close();
+    }
+}
+
+#include "moc_loopbacktransport.cpp"
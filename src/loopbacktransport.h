@@ -0,0 +1,67 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#pragma once
+
+#include "transport.h"
+
+namespace SimpleMail {
+
+class SmtpResponder;
+class LoopbackTransportPrivate;
+/**
+ * LoopbackTransport keeps the whole SMTP session in process, everything
+ * written is handed to an SmtpResponder and its replies are delivered
+ * back from the event loop, as a socket would.
+ *
+ * This allows measuring the protocol and encoding paths of Server
+ * without the kernel network stack:
+ * @code
+ * auto transport = new LoopbackTransport;
+ * transport->responder()->setExtensions({"PIPELINING", "8BITMIME"});
+ * server->setTransport(transport);
+ * @endcode
+ */
+class SMTP_EXPORT LoopbackTransport : public Transport
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(LoopbackTransport)
+public:
+    explicit LoopbackTransport(QObject *parent = nullptr);
+    ~LoopbackTransport() override;
+
+    /**
+     * Returns the responder playing the server side
+     */
+    SmtpResponder *responder() const;
+
+    Capabilities capabilities() const override;
+    void connectToHost(const QString &host, quint16 port) override;
+    void disconnectFromHost() override;
+
+    qint64 bytesAvailable() const override;
+    bool canReadLine() const override;
+    void close() override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 readLineData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 size) override;
+
+private:
+    LoopbackTransportPrivate *d_ptr;
+};
+
+} // namespace SimpleMail
@@ -0,0 +1,48 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef LOOPBACKTRANSPORT_P_H
+#define LOOPBACKTRANSPORT_P_H
+
+#include "loopbacktransport.h"
+#include "smtpresponder.h"
+
+namespace SimpleMail {
+
+class LoopbackTransportPrivate
+{
+    Q_DECLARE_PUBLIC(LoopbackTransport)
+public:
+    LoopbackTransportPrivate(LoopbackTransport *q)
+        : q_ptr(q)
+    {
+    }
+
+    void deliver(const QByteArray &data);
+    void schedule();
+    void flush();
+
+    LoopbackTransport *q_ptr;
+    SmtpResponder responder;
+    QByteArray inbound;
+    qsizetype readPos = 0;
+    qint64 written    = 0;
+    bool scheduled    = false;
+    bool closing      = false;
+};
+
+} // namespace SimpleMail
+
+#endif // LOOPBACKTRANSPORT_P_H
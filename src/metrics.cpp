@@ -0,0 +1,252 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "metrics_p.h"
+
+#include "latencyhistogram.h"
+#include "server.h"
+
+#include <algorithm>
+
+#include <QMetaEnum>
+
+using namespace SimpleMail;
+
+namespace {
+
+std::atomic<quint64> encodedParts[EncoderMetrics::EncodingCount];
+std::atomic<quint64> encoderInput[EncoderMetrics::EncodingCount];
+std::atomic<quint64> encoderOutput[EncoderMetrics::EncodingCount];
+
+struct ServerSample {
+    QByteArray label;
+    ServerMetrics metrics;
+    LatencyHistogram latency[ServerReply::PhaseCount];
+};
+
+QByteArray escapeLabel(const QString &value)
+{
+    QByteArray ret = value.toUtf8();
+    ret.replace('\\', "\\\\");
+    ret.replace('"', "\\\"");
+    ret.replace('\n', "\\n");
+    return ret;
+}
+
+void family(QByteArray &out, const char *name, const char *type, const char *help)
+{
+    out += QByteArrayLiteral("# TYPE ") + name + ' ' + type + '\n';
+    out += QByteArrayLiteral("# HELP ") + name + ' ' + help + '\n';
+}
+
+void sample(QByteArray &out, const char *name, const QByteArray &labels, quint64 value)
+{
+    out += QByteArray(name) + '{' + labels + "} " + QByteArray::number(value) + '\n';
+}
+
+void sample(QByteArray &out, const char *name, const QByteArray &labels, double value)
+{
+    out += QByteArray(name) + '{' + labels + "} " + QByteArray::number(value, 'g', 9) + '\n';
+}
+
+} // namespace
+
+ServerMetrics &ServerMetrics::operator+=(const ServerMetrics &other)
+{
+    messagesSent += other.messagesSent;
+    messagesFailed += other.messagesFailed;
+    bytesWritten += other.bytesWritten;
+    replies4xx += other.replies4xx;
+    replies5xx += other.replies5xx;
+    connects += other.connects;
+    reconnects += other.reconnects;
+    queuedMessages += other.queuedMessages;
+    queuedBytes += other.queuedBytes;
+    inFlight += other.inFlight;
+    for (int i = 0; i < ConnectionStateCount; ++i) {
+        connections[i] += other.connections[i];
+    }
+    return *this;
+}
+
+ServerMetrics ServerCounters::snapshot() const
+{
+    ServerMetrics ret;
+    ret.messagesSent   = messagesSent.load(std::memory_order_relaxed);
+    ret.messagesFailed = messagesFailed.load(std::memory_order_relaxed);
+    ret.bytesWritten   = bytesWritten.load(std::memory_order_relaxed);
+    ret.replies4xx     = replies4xx.load(std::memory_order_relaxed);
+    ret.replies5xx     = replies5xx.load(std::memory_order_relaxed);
+    ret.connects       = connects.load(std::memory_order_relaxed);
+    ret.reconnects     = reconnects.load(std::memory_order_relaxed);
+    ret.inFlight       = transactions.load(std::memory_order_relaxed);
+    ret.connections[connectionState.load(std::memory_order_relaxed)] = 1;
+    return ret;
+}
+
+EncoderMetrics EncoderMetrics::snapshot()
+{
+    EncoderMetrics ret;
+    for (int i = 0; i < EncodingCount; ++i) {
+        ret.parts[i]       = encodedParts[i].load(std::memory_order_relaxed);
+        ret.inputBytes[i]  = encoderInput[i].load(std::memory_order_relaxed);
+        ret.outputBytes[i] = encoderOutput[i].load(std::memory_order_relaxed);
+    }
+    return ret;
+}
+
+void EncoderCounters::add(EncoderMetrics::Encoding encoding, qint64 input, qint64 output)
+{
+    encodedParts[encoding].fetch_add(1, std::memory_order_relaxed);
+    encoderInput[encoding].fetch_add(quint64(input), std::memory_order_relaxed);
+    encoderOutput[encoding].fetch_add(quint64(output), std::memory_order_relaxed);
+}
+
+QByteArray OpenMetrics::render(const QList<Server *> &servers)
+{
+    QList<ServerSample> samples;
+    for (const Server *server : servers) {
+        const QByteArray label = "server=\"" +
+                                 escapeLabel(server->host() + QLatin1Char(':') +
+                                             QString::number(server->port())) +
+                                 '"';
+        auto it = std::find_if(samples.begin(), samples.end(), [&label](const auto &sample) {
+            return sample.label == label;
+        });
+        if (it == samples.end()) {
+            samples.append({label, {}, {}});
+            it = samples.end() - 1;
+        }
+
+        it->metrics += server->metrics();
+        for (int i = 0; i < ServerReply::PhaseCount; ++i) {
+            it->latency[i].merge(server->latencyHistogram(ServerReply::Phase(i)));
+        }
+    }
+
+    QByteArray out;
+    family(out, "simplemail_messages", "counter", "Messages finished by the server.");
+    for (const auto &s : std::as_const(samples)) {
+        sample(out,
+               "simplemail_messages_total",
+               s.label + ",result=\"sent\"",
+               s.metrics.messagesSent);
+        sample(out,
+               "simplemail_messages_total",
+               s.label + ",result=\"failed\"",
+               s.metrics.messagesFailed);
+    }
+
+    family(out, "simplemail_written_bytes", "counter", "Bytes written to the transport.");
+    for (const auto &s : std::as_const(samples)) {
+        sample(out, "simplemail_written_bytes_total", s.label, s.metrics.bytesWritten);
+    }
+
+    family(out, "simplemail_replies", "counter", "Error replies received, by class.");
+    for (const auto &s : std::as_const(samples)) {
+        sample(out, "simplemail_replies_total", s.label + ",class=\"4xx\"", s.metrics.replies4xx);
+        sample(out, "simplemail_replies_total", s.label + ",class=\"5xx\"", s.metrics.replies5xx);
+    }
+
+    family(out, "simplemail_connects", "counter", "Connections opened.");
+    for (const auto &s : std::as_const(samples)) {
+        sample(out, "simplemail_connects_total", s.label, s.metrics.connects);
+    }
+
+    family(out, "simplemail_reconnects", "counter", "Connections opened after one was lost.");
+    for (const auto &s : std::as_const(samples)) {
+        sample(out, "simplemail_reconnects_total", s.label, s.metrics.reconnects);
+    }
+
+    family(out, "simplemail_queued_messages", "gauge", "Messages waiting or being sent.");
+    for (const auto &s : std::as_const(samples)) {
+        sample(out, "simplemail_queued_messages", s.label, quint64(s.metrics.queuedMessages));
+    }
+
+    family(out, "simplemail_queued_bytes", "gauge", "Encoded size of the queued messages.");
+    for (const auto &s : std::as_const(samples)) {
+        sample(out, "simplemail_queued_bytes", s.label, quint64(s.metrics.queuedBytes));
+    }
+
+    family(out, "simplemail_in_flight", "gauge", "Transactions in progress.");
+    for (const auto &s : std::as_const(samples)) {
+        sample(out, "simplemail_in_flight", s.label, quint64(s.metrics.inFlight));
+    }
+
+    static const char *states[] = {
+        "disconnected", "connecting", "handshaking", "idle", "sending", "closing"};
+    family(out, "simplemail_connections", "gauge", "Connections in each state.");
+    for (const auto &s : std::as_const(samples)) {
+        for (int i = 0; i < ServerMetrics::ConnectionStateCount; ++i) {
+            sample(out,
+                   "simplemail_connections",
+                   s.label + ",state=\"" + states[i] + '"',
+                   quint64(s.metrics.connections[i]));
+        }
+    }
+
+    const QMetaEnum phases = QMetaEnum::fromType<ServerReply::Phase>();
+    family(out,
+           "simplemail_phase_duration_seconds",
+           "summary",
+           "Time to reach each phase of a transaction, Queued is the whole of it.");
+    for (const auto &s : std::as_const(samples)) {
+        for (int i = 0; i < ServerReply::PhaseCount; ++i) {
+            const LatencyHistogram &histogram = s.latency[i];
+            if (histogram.count() == 0) {
+                continue;
+            }
+
+            const QByteArray labels = s.label + ",phase=\"" + phases.valueToKey(i) + '"';
+            for (const double quantile : {0.5, 0.99, 0.999}) {
+                sample(out,
+                       "simplemail_phase_duration_seconds",
+                       labels + ",quantile=\"" + QByteArray::number(quantile) + '"',
+                       histogram.percentile(quantile * 100) / 1e6);
+            }
+            sample(out, "simplemail_phase_duration_seconds_sum", labels, histogram.sum() / 1e6);
+            sample(out, "simplemail_phase_duration_seconds_count", labels, histogram.count());
+        }
+    }
+
+    static const char *encodings[] = {"raw", "text", "base64", "quoted-printable"};
+    const EncoderMetrics encoder = EncoderMetrics::snapshot();
+    family(out, "simplemail_encoded_parts", "counter", "MIME parts written, by encoding.");
+    for (int i = 0; i < EncoderMetrics::EncodingCount; ++i) {
+        sample(out,
+               "simplemail_encoded_parts_total",
+               "encoding=\"" + QByteArray(encodings[i]) + '"',
+               encoder.parts[i]);
+    }
+
+    family(out, "simplemail_encoder_input_bytes", "counter", "Bytes read by the encoders.");
+    for (int i = 0; i < EncoderMetrics::EncodingCount; ++i) {
+        sample(out,
+               "simplemail_encoder_input_bytes_total",
+               "encoding=\"" + QByteArray(encodings[i]) + '"',
+               encoder.inputBytes[i]);
+    }
+
+    family(out, "simplemail_encoder_output_bytes", "counter", "Bytes written by the encoders.");
+    for (int i = 0; i < EncoderMetrics::EncodingCount; ++i) {
+        sample(out,
+               "simplemail_encoder_output_bytes_total",
+               "encoding=\"" + QByteArray(encodings[i]) + '"',
+               encoder.outputBytes[i]);
+    }
+
+    out += "# EOF\n";
+    return out;
+}
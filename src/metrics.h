@@ -0,0 +1,91 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#pragma once
+
+#include "smtpexports.h"
+
+#include <QByteArray>
+#include <QList>
+
+namespace SimpleMail {
+
+class Server;
+/**
+ * A snapshot of the counters of a Server, see Server::metrics().
+ * Counters only grow, rates are computed by whoever samples them
+ */
+struct SMTP_EXPORT ServerMetrics {
+    enum ConnectionState {
+        Disconnected,
+        Connecting,
+        Handshaking, // Greeting, EHLO, STARTTLS and AUTH
+        Idle,
+        Sending, // A transaction is in progress
+        Closing, // QUIT was sent
+        ConnectionStateCount,
+    };
+
+    quint64 messagesSent   = 0; // Accepted by the server
+    quint64 messagesFailed = 0; // Finished with an error, local ones included
+    quint64 bytesWritten   = 0; // Commands and data written to the transport
+    quint64 replies4xx     = 0;
+    quint64 replies5xx     = 0;
+    quint64 connects       = 0;
+    quint64 reconnects     = 0; // Connections opened to resume the queue after one was lost
+    qint64 queuedMessages  = 0;
+    qint64 queuedBytes     = 0; // Only computed when a bytes limit is set
+    qint64 inFlight        = 0; // Transactions started and not finished
+
+    // Connections in each state, a single Server has one
+    qint64 connections[ConnectionStateCount] = {};
+
+    ServerMetrics &operator+=(const ServerMetrics &other);
+};
+
+/**
+ * A snapshot of the process wide counters of MIME part encoding
+ */
+struct SMTP_EXPORT EncoderMetrics {
+    enum Encoding {
+        Raw,  // 7bit and 8bit parts written as they are
+        Text, // 7bit and 8bit parts with line endings converted
+        Base64,
+        QuotedPrintable,
+        EncodingCount,
+    };
+
+    quint64 parts[EncodingCount]       = {};
+    quint64 inputBytes[EncodingCount]  = {};
+    quint64 outputBytes[EncodingCount] = {};
+
+    static EncoderMetrics snapshot();
+};
+
+/**
+ * Renders metrics in the OpenMetrics text format for scraping
+ */
+class SMTP_EXPORT OpenMetrics
+{
+public:
+    /**
+     * Returns the metrics and latency histograms of servers, labelled with
+     * their host and port, followed by the encoder metrics. Servers to the
+     * same host and port, like a pool of connections, are added together
+     */
+    static QByteArray render(const QList<Server *> &servers);
+};
+
+} // namespace SimpleMail
@@ -0,0 +1,82 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef METRICS_P_H
+#define METRICS_P_H
+
+#include "metrics.h"
+
+#include <atomic>
+
+namespace SimpleMail {
+
+/**
+ * The counters of a Server. They are only written from its thread, so a
+ * relaxed load and store is enough and avoids locked instructions, while
+ * snapshots can be taken from any thread
+ */
+class ServerCounters
+{
+public:
+    static inline void add(std::atomic<quint64> &counter, quint64 value = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    inline void countReply(int code)
+    {
+        if (code / 100 == 4) {
+            add(replies4xx);
+        } else if (code / 100 == 5) {
+            add(replies5xx);
+        }
+    }
+
+    inline void setState(ServerMetrics::ConnectionState state)
+    {
+        connectionState.store(state, std::memory_order_relaxed);
+    }
+
+    inline void setInFlight(bool inFlight)
+    {
+        transactions.store(inFlight ? 1 : 0, std::memory_order_relaxed);
+    }
+
+    ServerMetrics snapshot() const;
+
+    std::atomic<quint64> messagesSent{0};
+    std::atomic<quint64> messagesFailed{0};
+    std::atomic<quint64> bytesWritten{0};
+    std::atomic<quint64> replies4xx{0};
+    std::atomic<quint64> replies5xx{0};
+    std::atomic<quint64> connects{0};
+    std::atomic<quint64> reconnects{0};
+    std::atomic<int> transactions{0};
+    std::atomic<int> connectionState{ServerMetrics::Disconnected};
+};
+
+/**
+ * Process wide counters of MimePart encoding, parts may be written from
+ * several threads at once
+ */
+class EncoderCounters
+{
+public:
+    static void add(EncoderMetrics::Encoding encoding, qint64 input, qint64 output);
+};
+
+} // namespace SimpleMail
+
+#endif // METRICS_P_H
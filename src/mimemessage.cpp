@@ -17,8 +17,10 @@ x
 */
 
 #include "mimemessage_p.h"
+#include "headerbuffer_p.h"
 #include "quotedprintable.h"
 
+#include <algorithm>
 #include <typeinfo>
 
 #include <QDateTime>
@@ -69,70 +71,57 @@ void MimeMessage::setContent(const std::shared_ptr<MimePart> &content)
     d->content = content;
 }
 
-bool MimeMessage::write(QIODevice *device) const
+void MimeMessage::setRawData(const QByteArray &data)
 {
-    // Headers
-    QByteArray data;
+    d->rawData = data;
+}
 
-    if (!d->listExtraHeaders.isEmpty()) {
-        const auto listExtraHeaders = d->listExtraHeaders;
-        for (const QByteArray &header : listExtraHeaders) {
-            data += MimeMessagePrivate::encodeData(d->encoding, QString::fromLatin1(header), true) +
-                    QByteArrayLiteral("\r\n");
-        }
-        if (device->write(data) != data.size()) {
-            return false;
-        }
-    }
+QByteArray MimeMessage::rawData() const
+{
+    return d->rawData;
+}
 
-    data = MimeMessagePrivate::encode(
-        QByteArrayLiteral("From: "), QList<EmailAddress>() << d->sender, d->encoding);
-    if (device->write(data) != data.size()) {
-        return false;
+bool MimeMessage::write(QIODevice *device) const
+{
+    return write(device, false);
+}
+
+bool MimeMessage::write(QIODevice *device, bool eightBitMime) const
+{
+    if (!d->rawData.isNull()) {
+        return device->write(d->rawData) == d->rawData.size();
     }
 
-    if (d->replyTo.address().isEmpty() == false) {
-        data = MimeMessagePrivate::encode(
-            QByteArrayLiteral("Reply-To: "), QList<EmailAddress>() << d->replyTo, d->encoding);
-        if (device->write(data) != data.size()) {
+    // Headers, released before the parts render theirs into the same buffer
+    {
+        HeaderBuffer headers;
+        d->headers(headers);
+        if (!headers.write(device)) {
             return false;
         }
     }
 
-    data = MimeMessagePrivate::encode(QByteArrayLiteral("To: "), d->recipientsTo, d->encoding);
-    if (device->write(data) != data.size()) {
-        return false;
-    }
-
-    data = MimeMessagePrivate::encode(QByteArrayLiteral("Cc: "), d->recipientsCc, d->encoding);
-    if (device->write(data) != data.size()) {
-        return false;
-    }
-
-    data = QByteArrayLiteral("Date: ") +
-           QDateTime::currentDateTime().toString(Qt::RFC2822Date).toLatin1() +
-           QByteArrayLiteral("\r\n");
-    if (device->write(data) != data.size()) {
+    if (!d->content->write(device, eightBitMime)) {
+        qCWarning(SIMPLEMAIL_MIMEMSG) << "Failed to write MIME content";
         return false;
     }
 
-    data = QByteArrayLiteral("Subject: ") +
-           MimeMessagePrivate::encodeData(d->encoding, d->subject, true);
-    if (device->write(data) != data.size()) {
-        return false;
-    }
+    return true;
+}
 
-    data = QByteArrayLiteral("\r\nMIME-Version: 1.0\r\n");
-    if (device->write(data) != data.size()) {
-        return false;
+qint64 MimeMessage::encodedSize(bool eightBitMime) const
+{
+    if (!d->rawData.isNull()) {
+        return d->rawData.size();
     }
 
-    if (!d->content->write(device)) {
-        qCWarning(SIMPLEMAIL_MIMEMSG) << "Failed to write MIME content";
-        return false;
+    const qint64 contentSize = d->content->encodedSize(eightBitMime);
+    if (contentSize < 0) {
+        return -1;
     }
-
-    return true;
+    HeaderBuffer headers;
+    d->headers(headers);
+    return headers.size() + contentSize;
 }
 
 void MimeMessage::setSender(const EmailAddress &sender)
@@ -247,65 +236,145 @@ QList<std::shared_ptr<MimePart>> MimeMessage::parts() const
 
 MimeMessagePrivate::~MimeMessagePrivate() = default;
 
-QByteArray MimeMessagePrivate::encode(const QByteArray &addressKind,
-                                      const QList<EmailAddress> &emails,
-                                      MimePart::Encoding codec)
+static void appendSimplified(HeaderBuffer &out, const QByteArray &ascii)
+{
+    // QString::simplified() of ASCII text
+    bool pending = false;
+    bool empty   = true;
+    for (const char c : ascii) {
+        if (c == ' ' || (c >= '\t' && c <= '\r')) {
+            pending = !empty;
+            continue;
+        }
+        if (pending) {
+            out.append(' ');
+            pending = false;
+        }
+        out.append(c);
+        empty = false;
+    }
+}
+
+void MimeMessagePrivate::headers(HeaderBuffer &out) const
+{
+    // Enough for most messages, so a new buffer grows once and not per address
+    out.reserve(512 + subject.size() * 3 + (recipientsTo.size() + recipientsCc.size()) * 96);
+
+    for (const QByteArray &header : listExtraHeaders) {
+        // Only non ASCII headers need to be turned into a QString
+        const bool ascii =
+            std::none_of(header.cbegin(), header.cend(), [](char c) { return uchar(c) >= 0x80; });
+        if (ascii) {
+            appendSimplified(out, header);
+        } else {
+            MimeMessagePrivate::encodeData(out, encoding, QString::fromLatin1(header), true);
+        }
+        out.append("\r\n");
+    }
+
+    out.append("From: ");
+    MimeMessagePrivate::encodeAddress(out, sender, encoding);
+    out.append("\r\n");
+
+    if (replyTo.address().isEmpty() == false) {
+        out.append("Reply-To: ");
+        MimeMessagePrivate::encodeAddress(out, replyTo, encoding);
+        out.append("\r\n");
+    }
+
+    MimeMessagePrivate::encode(out, QByteArrayLiteral("To: "), recipientsTo, encoding);
+    MimeMessagePrivate::encode(out, QByteArrayLiteral("Cc: "), recipientsCc, encoding);
+
+    out.append("Date: ")
+        .appendLatin1(QDateTime::currentDateTime().toString(Qt::RFC2822Date))
+        .append("\r\n");
+
+    out.append("Subject: ");
+    MimeMessagePrivate::encodeData(out, encoding, subject, true);
+
+    out.append("\r\nMIME-Version: 1.0\r\n");
+}
+
+void MimeMessagePrivate::encode(HeaderBuffer &out,
+                                const QByteArray &addressKind,
+                                const QList<EmailAddress> &emails,
+                                MimePart::Encoding codec)
 {
     if (emails.isEmpty()) {
-        return QByteArray();
+        return;
     }
 
-    QByteArray mime = addressKind;
-    bool first      = true;
+    out.append(addressKind);
+    bool first = true;
     for (const EmailAddress &email : emails) {
         if (!first) {
-            mime.append(',');
+            out.append(',');
         } else {
             first = false;
         }
-
-        const QString name = email.name();
-        if (!name.isEmpty()) {
-            mime.append(MimeMessagePrivate::encodeData(codec, name, true));
-            mime.append(" <" + email.address().toLatin1() + '>');
-        } else {
-            mime.append('<' + email.address().toLatin1() + '>');
-        }
+        MimeMessagePrivate::encodeAddress(out, email, codec);
     }
-    mime.append(QByteArrayLiteral("\r\n"));
+    out.append("\r\n");
+}
 
-    return mime;
+void MimeMessagePrivate::encodeAddress(HeaderBuffer &out,
+                                       const EmailAddress &email,
+                                       MimePart::Encoding codec)
+{
+    const QString name = email.name();
+    if (!name.isEmpty()) {
+        MimeMessagePrivate::encodeData(out, codec, name, true);
+        out.append(" <").appendLatin1(email.address()).append('>');
+    } else {
+        out.append('<').appendLatin1(email.address()).append('>');
+    }
 }
 
-QByteArray
-    MimeMessagePrivate::encodeData(MimePart::Encoding codec, const QString &data, bool autoencoding)
+void MimeMessagePrivate::encodeData(HeaderBuffer &out,
+                                    MimePart::Encoding codec,
+                                    QStringView data,
+                                    bool autoencoding)
 {
-    const QString simpleData = data.simplified();
-    const QByteArray simple  = simpleData.toUtf8();
+    // The simplified UTF-8 goes to the scratch buffer, which keeps its capacity
+    QByteArray &simple = out.scratch();
+    HeaderBuffer::toUtf8(data, true, simple);
     if (autoencoding) {
-        if (simpleData.toLatin1() == simple) {
-            return simple;
+        int printable = 0;
+        int encoded   = 0;
+        bool ascii    = true;
+        for (const char c : simple) {
+            ascii = ascii && uchar(c) < 0x80;
+            if (QuotedPrintable::requiresEscape(uchar(c), true)) {
+                ++encoded;
+            } else {
+                ++printable;
+            }
+        }
+
+        if (ascii) {
+            out.append(simple);
+            return;
         }
 
-        int printable           = 0;
-        int encoded             = 0;
-        const QByteArray result = QuotedPrintable::encode(simple, true, &printable, &encoded);
-        int sum                 = printable + encoded;
-        qCDebug(SIMPLEMAIL_MIMEMSG) << data << result << printable << encoded << sum
-                                    << (double(printable) / sum) << (encoded / sum);
+        const int sum = printable + encoded;
         if (sum != 0 && (double(printable) / sum) >= 0.8) {
-            return " =?utf-8?Q?" + result + "?=";
+            out.append(" =?utf-8?Q?").appendQuotedPrintable(simple, true).append("?=");
         } else {
-            return " =?utf-8?B?" + data.toUtf8().toBase64() + "?=";
+            // Not simplified, as it always was
+            HeaderBuffer::toUtf8(data, false, simple);
+            out.append(" =?utf-8?B?").appendBase64(simple).append("?=");
         }
     } else {
         switch (codec) {
         case MimePart::Base64:
-            return " =?utf-8?B?" + simple.toBase64() + "?=";
+            out.append(" =?utf-8?B?").appendBase64(simple).append("?=");
+            break;
         case MimePart::QuotedPrintable:
-            return " =?utf-8?Q?" + QuotedPrintable::encode(simple, true) + "?=";
+            out.append(" =?utf-8?Q?").appendQuotedPrintable(simple, true).append("?=");
+            break;
         default:
-            return ' ' + data.toLatin1();
+            out.append(' ').appendLatin1(data);
+            break;
         }
     }
 }
@@ -69,8 +69,30 @@ public:
     MimePart &getContent();
     void setContent(const std::shared_ptr<MimePart> &content);
 
+    /**
+     * Defines an already encoded message (headers and body) that is written as is,
+     * sender and recipients are then only used for the SMTP envelope.
+     *
+     * The data must use CRLF line endings, be dot-stuffed and must not contain
+     * the trailing CRLF of the last line, as the DATA terminator adds it.
+     */
+    void setRawData(const QByteArray &data);
+    QByteArray rawData() const;
+
     bool write(QIODevice *device) const;
 
+    /**
+     * Writes the message to the device, MimePart::Auto parts are only sent
+     * as 8bit when eightBitMime is true
+     */
+    bool write(QIODevice *device, bool eightBitMime) const;
+
+    /**
+     * Returns the number of bytes write() produces, computed without encoding
+     * the parts, or -1 if it can't be known in advance
+     */
+    qint64 encodedSize(bool eightBitMime = false) const;
+
 protected:
     QSharedDataPointer<MimeMessagePrivate> d;
 };
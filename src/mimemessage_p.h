@@ -25,23 +25,32 @@
 
 namespace SimpleMail {
 
+class HeaderBuffer;
 class MimeMessagePrivate : public QSharedData
 {
 public:
     MimeMessagePrivate() = default;
     ~MimeMessagePrivate();
 
-    inline static QByteArray encode(const QByteArray &addressKind,
-                                    const QList<EmailAddress> &emails,
-                                    MimePart::Encoding codec);
-    inline static QByteArray
-        encodeData(MimePart::Encoding codec, const QString &data, bool autoencoding);
+    static void encode(HeaderBuffer &out,
+                       const QByteArray &addressKind,
+                       const QList<EmailAddress> &emails,
+                       MimePart::Encoding codec);
+    static void
+        encodeAddress(HeaderBuffer &out, const EmailAddress &email, MimePart::Encoding codec);
+    static void encodeData(HeaderBuffer &out,
+                           MimePart::Encoding codec,
+                           QStringView data,
+                           bool autoencoding);
+
+    void headers(HeaderBuffer &out) const;
 
     QList<QByteArray> listExtraHeaders;
     QList<EmailAddress> recipientsTo;
     QList<EmailAddress> recipientsCc;
     QList<EmailAddress> recipientsBcc;
     QString subject;
+    QByteArray rawData;
     EmailAddress sender;
     std::shared_ptr<MimePart> content;
     MimePart::Encoding encoding = MimePart::_8Bit;
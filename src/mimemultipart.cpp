@@ -15,6 +15,7 @@
   See the LICENSE file for more details.
 */
 
+#include "headerbuffer_p.h"
 #include "mimemultipart_p.h"
 
 #include <QtCore/QIODevice>
@@ -22,6 +23,17 @@
 
 using namespace SimpleMail;
 
+static bool writeDelimiter(QIODevice *device, const QByteArray &boundary, bool last)
+{
+    HeaderBuffer line;
+    line.append("--").append(boundary);
+    if (last) {
+        line.append("--");
+    }
+    line.append("\r\n");
+    return line.write(device);
+}
+
 const QByteArray MULTI_PART_NAMES[] = {
     QByteArrayLiteral("multipart/mixed"),       //    Mixed
     QByteArrayLiteral("multipart/digest"),      //    Digest
@@ -63,16 +75,15 @@ bool MimeMultiPart::writeData(QIODevice *device)
 {
     Q_D(MimePart);
 
+    // The parts keep the 8BITMIME choice the device carries
     const auto parts = static_cast<MimeMultiPartPrivate *>(d)->parts;
     for (const auto &part : parts) {
-        device->write("--" + d->contentBoundary + "\r\n");
-        if (!part->write(device)) {
+        if (!writeDelimiter(device, d->contentBoundary, false) || !part->write(device)) {
             return false;
         }
     }
-    device->write("--" + d->contentBoundary + "--\r\n");
 
-    return true;
+    return writeDelimiter(device, d->contentBoundary, true);
 }
 
 void MimeMultiPart::setMimeType(const MultiPartType type)
@@ -89,3 +100,21 @@ MimeMultiPart::MultiPartType MimeMultiPart::mimeType() const
 }
 
 MimeMultiPartPrivate::~MimeMultiPartPrivate() = default;
+
+qint64 MimeMultiPartPrivate::dataSize(bool eightBitMime) const
+{
+    // "--" boundary CRLF
+    const qint64 delimiter = contentBoundary.size() + 4;
+
+    qint64 size = 0;
+    for (const auto &part : parts) {
+        const qint64 partSize = part->encodedSize(eightBitMime);
+        if (partSize < 0) {
+            return -1;
+        }
+        size += delimiter + partSize;
+    }
+
+    // "--" boundary "--" CRLF
+    return size + delimiter + 2;
+}
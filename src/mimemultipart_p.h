@@ -29,6 +29,9 @@ class MimeMultiPartPrivate : public MimePartPrivate
 {
 public:
     virtual ~MimeMultiPartPrivate();
+
+    qint64 dataSize(bool eightBitMime) const override;
+
     QList<std::shared_ptr<MimePart>> parts;
     MimeMultiPart::MultiPartType type;
 };
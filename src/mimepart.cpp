@@ -15,9 +15,13 @@
   See the LICENSE file for more details.
 */
 
+#include "headerbuffer_p.h"
+#include "metrics_p.h"
 #include "mimepart_p.h"
 #include "quotedprintable.h"
+#include "tracing_p.h"
 
+#include <cstring>
 #include <memory>
 
 #include <QtCore/QBuffer>
@@ -26,6 +30,40 @@
 
 using namespace SimpleMail;
 
+namespace {
+
+constexpr char EightBitMimeProperty[] = "_simplemail_eightBitMime";
+
+/**
+ * Sets the 8BITMIME choice of device while a part is written to it
+ */
+class EightBitMimeScope
+{
+public:
+    EightBitMimeScope(QIODevice *device, bool eightBitMime)
+        : m_device(device)
+        , m_changed(MimePartPrivate::eightBitMime(device) != eightBitMime)
+    {
+        // Nested parts usually keep the outer choice, with nothing to set
+        if (m_changed) {
+            m_device->setProperty(EightBitMimeProperty, eightBitMime);
+        }
+    }
+
+    ~EightBitMimeScope()
+    {
+        if (m_changed) {
+            m_device->setProperty(EightBitMimeProperty, !MimePartPrivate::eightBitMime(m_device));
+        }
+    }
+
+private:
+    QIODevice *m_device;
+    bool m_changed;
+};
+
+} // namespace
+
 MimePart::MimePart()
     : d_ptr(new MimePartPrivate)
 {
@@ -59,6 +97,7 @@ MimePart &MimePart::operator=(const MimePart &other)
     d->contentDevice = std::make_unique<QBuffer>();
     d->contentDevice->open(QBuffer::ReadWrite);
     d->contentDevice->write(other.content());
+    d->classified = false;
 
     d->contentId       = other.contentId();
     d->contentName     = other.contentName();
@@ -76,6 +115,7 @@ void MimePart::setContent(const QByteArray &content)
     d->contentDevice = std::make_unique<QBuffer>();
     d->contentDevice->open(QBuffer::ReadWrite);
     d->contentDevice->write(content);
+    d->classified = false;
 }
 
 void MimePart::setHeader(const QByteArray &header)
@@ -171,6 +211,7 @@ void MimePart::setData(const QString &data)
 
     d->contentDevice = std::make_unique<QBuffer>();
     d->contentDevice->open(QBuffer::ReadWrite);
+    d->classified = false;
 
     switch (d->contentEncoding) {
     case _7Bit:
@@ -179,6 +220,7 @@ void MimePart::setData(const QString &data)
     case _8Bit:
     case Base64:
     case QuotedPrintable:
+    case Auto:
         d->contentDevice->write(data.toUtf8());
         break;
     }
@@ -198,6 +240,7 @@ QString MimePart::data() const
         ret = QString::fromLatin1(d->contentDevice->readAll());
         break;
     case _8Bit:
+    case Auto:
         ret = QString::fromUtf8(d->contentDevice->readAll());
         break;
     case Base64:
@@ -218,55 +261,40 @@ MimeContentFormatter *MimePart::contentFormatter()
 
 bool MimePart::write(QIODevice *device)
 {
-    Q_D(const MimePart);
-
-    QByteArray headers;
-
-    // Content-Type
-    headers.append("Content-Type: " + d->contentType);
-    if (!d->contentName.isEmpty()) {
-        headers.append("; name=\"?UTF-8?B?" + d->contentName.toBase64(QByteArray::Base64Encoding) +
-                       "?=\"");
-    }
-    if (!d->contentCharset.isEmpty()) {
-        headers.append("; charset=" + d->contentCharset);
-    }
-    if (!d->contentBoundary.isEmpty()) {
-        headers.append("; boundary=" + d->contentBoundary);
-    }
-    headers.append("\r\n");
+    return write(device, MimePartPrivate::eightBitMime(device));
+}
 
-    // Content-Transfer-Encoding
-    switch (d->contentEncoding) {
-    case _7Bit:
-        headers.append("Content-Transfer-Encoding: 7bit\r\n");
-        break;
-    case _8Bit:
-        headers.append("Content-Transfer-Encoding: 8bit\r\n");
-        break;
-    case Base64:
-        headers.append("Content-Transfer-Encoding: base64\r\n");
-        break;
-    case QuotedPrintable:
-        headers.append("Content-Transfer-Encoding: quoted-printable\r\n");
-        break;
+bool MimePart::write(QIODevice *device, bool eightBitMime)
+{
+    Q_D(const MimePart);
+    EightBitMimeScope scope(device, eightBitMime);
+
+    // Write headers, released before writeData() renders the ones of child parts
+    {
+        const MimePart::Encoding encoding = d->transferEncoding(eightBitMime);
+        HeaderBuffer headers;
+        d->headers(headers, encoding);
+        if (!headers.write(device)) {
+            return false;
+        }
     }
 
-    // Content-Id
-    if (!d->contentId.isNull()) {
-        headers.append("Content-ID: <" + d->contentId + ">\r\n");
-    }
+    // Write content data
+    return writeData(device);
+}
 
-    // Addition header lines
-    headers.append(d->header + "\r\n");
+qint64 MimePart::encodedSize(bool eightBitMime) const
+{
+    Q_D(const MimePart);
 
-    // Write headers
-    if (device->write(headers) != headers.size()) {
-        return false;
+    const qint64 dataSize = d->dataSize(eightBitMime);
+    if (dataSize < 0) {
+        return -1;
     }
-
-    // Write content data
-    return writeData(device);
+    const MimePart::Encoding encoding = d->transferEncoding(eightBitMime);
+    HeaderBuffer headers;
+    d->headers(headers, encoding);
+    return headers.size() + dataSize;
 }
 
 MimePart::MimePart(MimePartPrivate *d)
@@ -278,6 +306,10 @@ bool MimePart::writeData(QIODevice *device)
 {
     Q_D(MimePart);
 
+    // Resolved before rewinding as classifying Auto parts reads the content
+    const MimePart::Encoding encoding =
+        d->transferEncoding(MimePartPrivate::eightBitMime(device));
+
     /* === Content === */
     QIODevice *input = d->contentDevice.get();
     if (!input->isOpen()) {
@@ -288,10 +320,14 @@ bool MimePart::writeData(QIODevice *device)
         return false;
     }
 
-    switch (d->contentEncoding) {
+    switch (encoding) {
     case MimePart::_7Bit:
     case MimePart::_8Bit:
-        if (!d->writeRaw(input, device)) {
+        if (d->contentEncoding == MimePart::Auto) {
+            if (!d->writeText(input, device)) {
+                return false;
+            }
+        } else if (!d->writeRaw(input, device)) {
             return false;
         }
         break;
@@ -305,6 +341,8 @@ bool MimePart::writeData(QIODevice *device)
             return false;
         }
         break;
+    case MimePart::Auto:
+        break;
     }
 
     if (device->write("\r\n", 2) != 2) {
@@ -321,9 +359,98 @@ MimePartPrivate *MimePart::d_func()
 
 MimePartPrivate::~MimePartPrivate() = default;
 
+qint64 MimePartPrivate::dataSize(bool eightBitMime) const
+{
+    QIODevice *input = contentDevice.get();
+    if (!input || input->isSequential()) {
+        return -1;
+    }
+
+    MimeContentClass content;
+    qint64 size = 0;
+    switch (transferEncoding(eightBitMime, &content)) {
+    case MimePart::_7Bit:
+    case MimePart::_8Bit:
+        if (contentEncoding == MimePart::Auto) {
+            // Line endings are converted to CRLF and leading dots stuffed
+            size = content.size + content.bareLineFeeds + content.dotLines;
+        } else {
+            size = input->size();
+        }
+        break;
+    case MimePart::Base64:
+        size = base64Size(input->size());
+        break;
+    case MimePart::QuotedPrintable:
+        if (!input->isOpen()) {
+            if (!input->open(QIODevice::ReadOnly)) {
+                return -1;
+            }
+        } else if (!input->seek(0)) {
+            return -1;
+        }
+        size = quotedPrintableSize(input);
+        break;
+    case MimePart::Auto:
+        break;
+    }
+
+    // Trailing CRLF
+    return size + 2;
+}
+
+bool MimePartPrivate::eightBitMime(const QIODevice *device)
+{
+    return device->property(EightBitMimeProperty).toBool();
+}
+
+void MimePartPrivate::headers(HeaderBuffer &out, MimePart::Encoding encoding) const
+{
+    // Content-Type
+    out.append("Content-Type: ").append(contentType);
+    if (!contentName.isEmpty()) {
+        out.append("; name=\"?UTF-8?B?").appendBase64(contentName).append("?=\"");
+    }
+    if (!contentCharset.isEmpty()) {
+        out.append("; charset=").append(contentCharset);
+    }
+    if (!contentBoundary.isEmpty()) {
+        out.append("; boundary=").append(contentBoundary);
+    }
+    out.append("\r\n");
+
+    // Content-Transfer-Encoding
+    switch (encoding) {
+    case MimePart::_7Bit:
+        out.append("Content-Transfer-Encoding: 7bit\r\n");
+        break;
+    case MimePart::_8Bit:
+        out.append("Content-Transfer-Encoding: 8bit\r\n");
+        break;
+    case MimePart::Base64:
+        out.append("Content-Transfer-Encoding: base64\r\n");
+        break;
+    case MimePart::QuotedPrintable:
+        out.append("Content-Transfer-Encoding: quoted-printable\r\n");
+        break;
+    case MimePart::Auto:
+        break;
+    }
+
+    // Content-Id
+    if (!contentId.isNull()) {
+        out.append("Content-ID: <").append(contentId).append(">\r\n");
+    }
+
+    // Addition header lines
+    out.append(header).append("\r\n");
+}
+
 bool MimePartPrivate::writeRaw(QIODevice *input, QIODevice *out)
 {
+    SIMPLEMAIL_TRACE(encode__start, this, int(EncoderMetrics::Raw));
     char block[4096];
+    qint64 total = 0;
     while (!input->atEnd()) {
         qint64 in = input->read(block, sizeof(block));
         if (in <= 0) {
@@ -333,14 +460,61 @@ bool MimePartPrivate::writeRaw(QIODevice *input, QIODevice *out)
         if (in != out->write(block, in)) {
             return false;
         }
+        total += in;
+    }
+    EncoderCounters::add(EncoderMetrics::Raw, total, total);
+    SIMPLEMAIL_TRACE(encode__done, this, int(EncoderMetrics::Raw), total, total);
+    return true;
+}
+
+bool MimePartPrivate::writeText(QIODevice *input, QIODevice *out)
+{
+    SIMPLEMAIL_TRACE(encode__start, this, int(EncoderMetrics::Text));
+    char block[4096];
+    QByteArray encoded;
+    qint64 read    = 0;
+    qint64 written = 0;
+    bool lineStart = true;
+    bool cr        = false;
+    while (!input->atEnd()) {
+        qint64 in = input->read(block, sizeof(block));
+        if (in <= 0) {
+            break;
+        }
+
+        encoded.clear();
+        for (qint64 i = 0; i < in; ++i) {
+            const char c = block[i];
+            // dot stuffing: https://www.rfc-editor.org/rfc/rfc5321#section-4.5.2
+            if (lineStart && c == '.') {
+                encoded.append('.');
+            }
+            if (c == '\n' && !cr) {
+                encoded.append('\r');
+            }
+            encoded.append(c);
+            cr        = c == '\r';
+            lineStart = c == '\n';
+        }
+
+        if (encoded.size() != out->write(encoded)) {
+            return false;
+        }
+        read += in;
+        written += encoded.size();
     }
+    EncoderCounters::add(EncoderMetrics::Text, read, written);
+    SIMPLEMAIL_TRACE(encode__done, this, int(EncoderMetrics::Text), read, written);
     return true;
 }
 
 bool MimePartPrivate::writeBase64(QIODevice *input, QIODevice *out)
 {
+    SIMPLEMAIL_TRACE(encode__start, this, int(EncoderMetrics::Base64));
     char block[6000]; // Must be powers of 6
-    int chars = 0;
+    qint64 read    = 0;
+    qint64 written = 0;
+    int chars      = 0;
     while (!input->atEnd()) {
         qint64 in = input->read(block, sizeof(block));
         if (in <= 0) {
@@ -354,14 +528,21 @@ bool MimePartPrivate::writeBase64(QIODevice *input, QIODevice *out)
         if (encoded.size() != out->write(encoded)) {
             return false;
         }
+        read += in;
+        written += encoded.size();
     }
+    EncoderCounters::add(EncoderMetrics::Base64, read, written);
+    SIMPLEMAIL_TRACE(encode__done, this, int(EncoderMetrics::Base64), read, written);
     return true;
 }
 
 bool MimePartPrivate::writeQuotedPrintable(QIODevice *input, QIODevice *out)
 {
+    SIMPLEMAIL_TRACE(encode__start, this, int(EncoderMetrics::QuotedPrintable));
     char block[4096];
-    int chars = 0;
+    qint64 read    = 0;
+    qint64 written = 0;
+    int chars      = 0;
     while (!input->atEnd()) {
         qint64 in = input->read(block, sizeof(block));
         if (in <= 0) {
@@ -373,6 +554,205 @@ bool MimePartPrivate::writeQuotedPrintable(QIODevice *input, QIODevice *out)
         if (encoded.size() != out->write(encoded)) {
             return false;
         }
+        read += in;
+        written += encoded.size();
     }
+    EncoderCounters::add(EncoderMetrics::QuotedPrintable, read, written);
+    SIMPLEMAIL_TRACE(encode__done, this, int(EncoderMetrics::QuotedPrintable), read, written);
     return true;
 }
+
+qint64 MimePartPrivate::base64Size(qint64 size) const
+{
+    // writeBase64() encodes and wraps each block on its own
+    const int maxLength = formatter.maxLength();
+    auto blockSize      = [maxLength](qint64 in) {
+        const qint64 encoded = (in + 2) / 3 * 4;
+        return encoded + (encoded + maxLength - 1) / maxLength * 2;
+    };
+
+    const qint64 remainder = size % 6000;
+    return size / 6000 * blockSize(6000) + (remainder ? blockSize(remainder) : 0);
+}
+
+qint64 MimePartPrivate::quotedPrintableSize(QIODevice *input) const
+{
+    // Mirrors MimeContentFormatter::formatQuotedPrintable() on the bytes
+    // QuotedPrintable::encode() would produce, without building them
+    const int maxLength = formatter.maxLength();
+    qint64 size         = 0;
+    int chars           = 0;
+    auto put            = [&](char c) {
+        ++chars;
+        if (c == '\n') {
+            ++size;
+            chars = 0;
+            return;
+        }
+
+        if ((chars > maxLength - 1) || ((c == '=') && (chars > maxLength - 3))) {
+            size += 3;
+            chars = 1;
+        }
+
+        if (chars == 1 && c == '.') {
+            ++size;
+            ++chars;
+        }
+        ++size;
+    };
+
+    bool escape[256];
+    for (int i = 0; i < 256; ++i) {
+        escape[i] = QuotedPrintable::requiresEscape(uchar(i));
+    }
+
+    char block[4096];
+    while (!input->atEnd()) {
+        qint64 in = input->read(block, sizeof(block));
+        if (in <= 0) {
+            break;
+        }
+
+        for (qint64 i = 0; i < in; ++i) {
+            if (escape[uchar(block[i])]) {
+                // Hex digits never trigger line breaks nor dot stuffing
+                put('=');
+                put('0');
+                put('0');
+            } else {
+                put(block[i]);
+            }
+        }
+    }
+    return size;
+}
+
+MimePart::Encoding MimePartPrivate::transferEncoding(bool eightBitMime,
+                                                     MimeContentClass *content) const
+{
+    if (contentEncoding != MimePart::Auto) {
+        return contentEncoding;
+    }
+
+    if (!classified) {
+        QIODevice *input = contentDevice.get();
+        if (!input || input->isSequential()) {
+            // Can't be read twice, base64 is safe for anything
+            return MimePart::Base64;
+        }
+
+        if (!input->isOpen()) {
+            if (!input->open(QIODevice::ReadOnly)) {
+                return MimePart::Base64;
+            }
+        } else if (!input->seek(0)) {
+            return MimePart::Base64;
+        }
+        contentClass = classify(input);
+        classified   = true;
+    }
+
+    if (content) {
+        *content = contentClass;
+    }
+
+    // Only text gets its line endings converted, lines are limited to
+    // 998 characters and leave room for a stuffed dot
+    if (contentType.startsWith("text/") && !contentClass.nul &&
+        !contentClass.bareCarriageReturn && contentClass.maxLineLength < 998) {
+        if (!contentClass.eightBit) {
+            return MimePart::_7Bit;
+        }
+        if (eightBitMime) {
+            return MimePart::_8Bit;
+        }
+    }
+
+    // Estimate quoted-printable with a soft line break every 75 characters
+    const qint64 quoted = contentClass.size + contentClass.escapes * 2;
+    if (quoted + quoted / (formatter.maxLength() - 1) * 3 <= base64Size(contentClass.size)) {
+        return MimePart::QuotedPrintable;
+    }
+    return MimePart::Base64;
+}
+
+MimeContentClass MimePartPrivate::classify(QIODevice *input)
+{
+    constexpr quint64 ones = ~quint64(0) / 255;
+    constexpr quint64 high = ones * 0x80;
+
+    bool escape[256];
+    for (int i = 0; i < 256; ++i) {
+        escape[i] = QuotedPrintable::requiresEscape(uchar(i));
+    }
+
+    MimeContentClass ret;
+    qint64 column = 0;
+    bool cr       = false;
+    char block[4096];
+    while (!input->atEnd()) {
+        const qint64 in = input->read(block, sizeof(block));
+        if (in <= 0) {
+            break;
+        }
+        ret.size += in;
+
+        qint64 i = 0;
+        while (i < in) {
+            if (!cr && i + 8 <= in && (column || block[i] != '.')) {
+                // Skip eight printable ASCII bytes at once when none of them is
+                // a control character, has the high bit set or is an '='
+                quint64 word;
+                std::memcpy(&word, block + i, sizeof(word));
+                const quint64 equals = word ^ (ones * '=');
+                const quint64 special =
+                    ((word - ones * 0x20) & ~word) | ((word + ones) | word) |
+                    ((equals - ones) & ~equals);
+                if (!(special & high)) {
+                    column += 8;
+                    i += 8;
+                    continue;
+                }
+            }
+
+            const uchar c = uchar(block[i++]);
+            if (c == '\n') {
+                if (!cr) {
+                    ++ret.bareLineFeeds;
+                }
+                ret.maxLineLength = qMax(ret.maxLineLength, column);
+                column            = 0;
+                cr                = false;
+                ++ret.escapes;
+                continue;
+            }
+
+            if (cr) {
+                // A CR not followed by LF
+                ret.bareCarriageReturn = true;
+                ++column;
+            }
+            cr = c == '\r';
+
+            if (column == 0 && c == '.') {
+                ++ret.dotLines;
+            }
+            if (!cr) {
+                ++column;
+            }
+            if (escape[c]) {
+                ++ret.escapes;
+            }
+            ret.eightBit |= c >= 0x80;
+            ret.nul |= c == 0;
+        }
+    }
+
+    if (cr) {
+        ret.bareCarriageReturn = true;
+    }
+    ret.maxLineLength = qMax(ret.maxLineLength, column);
+
+    return ret;
+}
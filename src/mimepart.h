@@ -29,7 +29,11 @@ class MimePartPrivate;
 class SMTP_EXPORT MimePart
 {
 public:
-    enum Encoding { _7Bit, _8Bit, Base64, QuotedPrintable };
+    /**
+     * Auto picks 7bit, 8bit, quoted-printable or base64 when the part is
+     * written, from the content and whether the server supports 8BITMIME
+     */
+    enum Encoding { _7Bit, _8Bit, Base64, QuotedPrintable, Auto };
 
     MimePart();
     MimePart(const MimePart &other);
@@ -67,8 +71,25 @@ public:
 
     bool write(QIODevice *device);
 
+    /**
+     * Writes the part, Auto parts are only sent as 8bit when eightBitMime is true
+     */
+    bool write(QIODevice *device, bool eightBitMime);
+
+    /**
+     * Returns the number of bytes write() produces, computed without encoding
+     * the content, or -1 if the content is on a sequential device. Subclasses
+     * overriding writeData() are sized from their content
+     */
+    qint64 encodedSize(bool eightBitMime = false) const;
+
 protected:
     MimePart(MimePartPrivate *d);
+
+    /**
+     * Writes the content after the headers, called by write(). Parts written
+     * from here with write(device) keep the 8BITMIME choice of the outer one
+     */
     virtual bool writeData(QIODevice *device);
 
     QSharedDataPointer<MimePartPrivate> d_ptr;
@@ -27,15 +27,52 @@
 class QFile;
 namespace SimpleMail {
 
+class HeaderBuffer;
+
+/**
+ * What a single pass over the content found out, used to pick the
+ * encoding of MimePart::Auto parts
+ */
+struct MimeContentClass {
+    qint64 size             = 0;
+    qint64 escapes          = 0;
+    qint64 bareLineFeeds    = 0;
+    qint64 dotLines         = 0;
+    qint64 maxLineLength    = 0;
+    bool eightBit           = false;
+    bool nul                = false;
+    bool bareCarriageReturn = false;
+};
+
 class MimePartPrivate : public QSharedData
 {
 public:
     virtual ~MimePartPrivate();
 
     bool writeRaw(QIODevice *input, QIODevice *out);
+    bool writeText(QIODevice *input, QIODevice *out);
     bool writeBase64(QIODevice *input, QIODevice *out);
     bool writeQuotedPrintable(QIODevice *input, QIODevice *out);
 
+    void headers(HeaderBuffer &out, MimePart::Encoding encoding) const;
+    qint64 base64Size(qint64 size) const;
+    qint64 quotedPrintableSize(QIODevice *input) const;
+
+    MimePart::Encoding transferEncoding(bool eightBitMime,
+                                        MimeContentClass *content = nullptr) const;
+    static MimeContentClass classify(QIODevice *input);
+
+    /**
+     * Returns the size of what MimePart::writeData() writes, -1 if unknown
+     */
+    virtual qint64 dataSize(bool eightBitMime) const;
+
+    /**
+     * Returns the 8BITMIME choice of the write() in progress on device, it
+     * travels as a property of the device since writeData() can't take it
+     */
+    static bool eightBitMime(const QIODevice *device);
+
     QByteArray header;
     std::shared_ptr<QIODevice> contentDevice;
 
@@ -46,7 +83,9 @@ public:
     QByteArray contentBoundary;
 
     MimeContentFormatter formatter;
+    mutable MimeContentClass contentClass;
     MimePart::Encoding contentEncoding = MimePart::_7Bit;
+    mutable bool classified            = false;
 };
 
 } // namespace SimpleMail
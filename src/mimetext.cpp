@@ -29,7 +29,7 @@ MimeText::MimeText(const QString &txt)
     Q_D(MimePart);
     d->contentType     = QByteArrayLiteral("text/plain");
     d->contentCharset  = QByteArrayLiteral("UTF-8");
-    d->contentEncoding = QuotedPrintable;
+    d->contentEncoding = Auto;
     setData(txt);
 }
 
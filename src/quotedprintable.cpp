@@ -35,7 +35,7 @@ const unsigned char Minus           = 0x2d;
 const unsigned char Slash           = 0x2f;
 const unsigned char Underscore      = 0x5f;
 
-static inline bool requiresEscape(unsigned char input, bool rfc2047)
+bool QuotedPrintable::requiresEscape(unsigned char input, bool rfc2047)
 {
     // For both, we need to escape '=' and anything unprintable
     bool escape =
@@ -95,10 +95,16 @@ QByteArray QuotedPrintable::decode(const QByteArray &input)
                                  0, 0, 0, 0, 0, 10, 11, 12, 13, 14, 15};
 
     QByteArray output;
+    output.reserve(input.size());
 
     int len = input.length();
-    for (int i = 0; i < len - 2; ++i) {
-        if (input.at(i) == '=') {
+    for (int i = 0; i < len; ++i) {
+        if (input.at(i) == '=' && i + 1 < len && input.at(i + 1) == '\n') {
+            ++i; // Soft line break
+        } else if (input.at(i) == '=' && i + 2 < len && input.at(i + 1) == '\r' &&
+                   input.at(i + 2) == '\n') {
+            i += 2;
+        } else if (input.at(i) == '=' && i + 2 < len) {
             int x = input.at(i + 1) - '0';
             int y = input.at(i + 2) - '0';
             if (x >= 0 && y >= 0 && x < 23 && y < 23) {
@@ -30,6 +30,11 @@ public:
                              int *printable = nullptr,
                              int *encoded   = nullptr);
     static QByteArray decode(const QByteArray &input);
+
+    /**
+     * Returns true if the input byte needs to be written as an "=XX" escape sequence
+     */
+    static bool requiresEscape(unsigned char input, bool rfc2047 = false);
 };
 
 } // namespace SimpleMail
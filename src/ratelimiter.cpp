@@ -0,0 +1,164 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "ratelimiter_p.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace SimpleMail;
+
+static TokenBucketConfig makeConfig(qint64 amount, qint64 msec, qint64 burst)
+{
+    TokenBucketConfig config;
+    if (amount > 0 && msec > 0) {
+        config.rate     = double(amount) / double(msec);
+        config.capacity = double(qMax<qint64>(1, burst));
+    }
+    return config;
+}
+
+RateLimiter::RateLimiter()
+    : d_ptr(new RateLimiterPrivate)
+{
+}
+
+RateLimiter::~RateLimiter()
+{
+    delete d_ptr;
+}
+
+void RateLimiter::setLimit(Resource resource, qint64 amount, qint64 msec, qint64 burst)
+{
+    Q_D(RateLimiter);
+    QMutexLocker locker(&d->mutex);
+    d->limits[resource] = makeConfig(amount, msec, burst);
+    d->global[resource] = TokenBucket();
+}
+
+void RateLimiter::setSenderLimit(Resource resource, qint64 amount, qint64 msec, qint64 burst)
+{
+    Q_D(RateLimiter);
+    QMutexLocker locker(&d->mutex);
+    d->senderLimits[resource] = makeConfig(amount, msec, burst);
+    for (TokenBuckets &buckets : d->senders) {
+        buckets[resource] = TokenBucket();
+    }
+}
+
+bool RateLimiter::isLimited(Resource resource) const
+{
+    Q_D(const RateLimiter);
+    QMutexLocker locker(&d->mutex);
+    return d->limits[resource].rate > 0 || d->senderLimits[resource].rate > 0;
+}
+
+qint64 RateLimiter::acquire(const QString &sender, qint64 recipients, qint64 bytes)
+{
+    Q_D(RateLimiter);
+    QMutexLocker locker(&d->mutex);
+
+    const qint64 now    = d->clock.elapsed();
+    const double cost[] = {1, double(recipients), double(bytes)};
+
+    qint64 wait = RateLimiterPrivate::wait(d->global, d->limits, now);
+
+    TokenBuckets *senderBuckets = nullptr;
+    if (std::any_of(d->senderLimits.cbegin(),
+                    d->senderLimits.cend(),
+                    [](const TokenBucketConfig &config) { return config.rate > 0; })) {
+        d->prune(now);
+        senderBuckets = &d->senders[sender.toLower()];
+        wait          = qMax(wait, RateLimiterPrivate::wait(*senderBuckets, d->senderLimits, now));
+    }
+
+    if (wait > 0) {
+        return wait;
+    }
+
+    RateLimiterPrivate::take(d->global, d->limits, cost);
+    if (senderBuckets) {
+        RateLimiterPrivate::take(*senderBuckets, d->senderLimits, cost);
+    }
+    return 0;
+}
+
+void TokenBucket::refill(const TokenBucketConfig &config, qint64 now)
+{
+    if (last < 0) {
+        tokens = config.capacity;
+    } else {
+        tokens = qMin(config.capacity, tokens + double(now - last) * config.rate);
+    }
+    last = now;
+}
+
+qint64 RateLimiterPrivate::wait(TokenBuckets &buckets,
+                                const TokenBucketConfigs &configs,
+                                qint64 now)
+{
+    qint64 ret = 0;
+    for (int i = 0; i <= RateLimiter::Bytes; ++i) {
+        const TokenBucketConfig &config = configs[i];
+        if (config.rate <= 0) {
+            continue;
+        }
+
+        TokenBucket &bucket = buckets[i];
+        bucket.refill(config, now);
+        if (bucket.tokens <= 0) {
+            // Time until the bucket is out of debt
+            ret = qMax(ret, qint64(std::ceil(-bucket.tokens / config.rate)) + 1);
+        }
+    }
+    return ret;
+}
+
+void RateLimiterPrivate::take(TokenBuckets &buckets,
+                              const TokenBucketConfigs &configs,
+                              const double *cost)
+{
+    for (int i = 0; i <= RateLimiter::Bytes; ++i) {
+        if (configs[i].rate > 0) {
+            buckets[i].tokens -= cost[i];
+        }
+    }
+}
+
+void RateLimiterPrivate::prune(qint64 now)
+{
+    // Forget senders whose buckets are full again, they behave like new ones
+    if (now - lastPrune < 60 * 1000) {
+        return;
+    }
+    lastPrune = now;
+
+    auto it = senders.begin();
+    while (it != senders.end()) {
+        bool full = true;
+        for (int i = 0; i <= RateLimiter::Bytes && full; ++i) {
+            const TokenBucketConfig &config = senderLimits[i];
+            const TokenBucket &bucket       = it.value()[i];
+            full = config.rate <= 0 || bucket.last < 0 ||
+                   bucket.tokens + double(now - bucket.last) * config.rate >= config.capacity;
+        }
+
+        if (full) {
+            it = senders.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#pragma once
+
+#include "smtpexports.h"
+
+#include <QString>
+
+namespace SimpleMail {
+
+class RateLimiterPrivate;
+/**
+ * RateLimiter paces transactions with token buckets on the number of
+ * messages, recipients and bytes sent, so that relay quotas are respected
+ * instead of being hit and answered with 421.
+ *
+ * Every limit exists once for the whole limiter and once per sender
+ * address. A limiter can be shared by several Server objects, e.g. all the
+ * connections to the same relay:
+ * @code
+ * auto limiter = std::make_shared<RateLimiter>();
+ * limiter->setLimit(RateLimiter::Messages, 10, 1000);
+ * limiter->setSenderLimit(RateLimiter::Recipients, 500, 3600 * 1000);
+ * server->setRateLimiter(limiter);
+ * @endcode
+ */
+class SMTP_EXPORT RateLimiter
+{
+    Q_DECLARE_PRIVATE(RateLimiter)
+public:
+    enum Resource {
+        Messages,
+        Recipients,
+        Bytes,
+    };
+
+    RateLimiter();
+    virtual ~RateLimiter();
+
+    /**
+     * Allows amount of the resource every msec milliseconds, refilled
+     * continuously. Burst is how much can be used at once after being idle,
+     * the default of one spreads the amount evenly over the interval.
+     * An amount of 0 removes the limit
+     */
+    void setLimit(Resource resource, qint64 amount, qint64 msec, qint64 burst = 1);
+
+    /**
+     * Same as setLimit() but tracked separately for each sender address
+     */
+    void setSenderLimit(Resource resource, qint64 amount, qint64 msec, qint64 burst = 1);
+
+    /**
+     * Returns true if the resource has a limit, globally or per sender
+     */
+    bool isLimited(Resource resource) const;
+
+    /**
+     * Takes the tokens of a transaction from every bucket and returns 0, or,
+     * if any of them is exhausted, returns the number of milliseconds to wait
+     * before trying again without taking anything.
+     *
+     * A transaction larger than a burst is let through once the bucket is
+     * not in debt, and the following ones wait for the debt to be refilled.
+     */
+    qint64 acquire(const QString &sender, qint64 recipients, qint64 bytes);
+
+private:
+    Q_DISABLE_COPY(RateLimiter)
+
+    RateLimiterPrivate *d_ptr;
+};
+
+} // namespace SimpleMail
@@ -0,0 +1,65 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef RATELIMITER_P_H
+#define RATELIMITER_P_H
+
+#include "ratelimiter.h"
+
+#include <array>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+
+namespace SimpleMail {
+
+struct TokenBucketConfig {
+    double rate     = 0; // tokens per millisecond, 0 if unlimited
+    double capacity = 0;
+};
+
+struct TokenBucket {
+    double tokens = 0; // negative when in debt
+    qint64 last   = -1;
+
+    void refill(const TokenBucketConfig &config, qint64 now);
+};
+
+using TokenBuckets       = std::array<TokenBucket, RateLimiter::Bytes + 1>;
+using TokenBucketConfigs = std::array<TokenBucketConfig, RateLimiter::Bytes + 1>;
+
+class RateLimiterPrivate
+{
+public:
+    RateLimiterPrivate() { clock.start(); }
+
+    static qint64 wait(TokenBuckets &buckets, const TokenBucketConfigs &configs, qint64 now);
+    static void
+        take(TokenBuckets &buckets, const TokenBucketConfigs &configs, const double *cost);
+    void prune(qint64 now);
+
+    mutable QMutex mutex; // Servers on other threads may share the limiter
+    QElapsedTimer clock;
+    TokenBucketConfigs limits;
+    TokenBucketConfigs senderLimits;
+    TokenBuckets global;
+    QHash<QString, TokenBuckets> senders;
+    qint64 lastPrune = 0;
+};
+
+} // namespace SimpleMail
+
+#endif // RATELIMITER_P_H
@@ -0,0 +1,333 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "relaygroup_p.h"
+#include "serverreply.h"
+
+#include "serverreply_p.h"
+
+#include <utility>
+
+#include <QLoggingCategory>
+#include <QTimer>
+
+Q_DECLARE_LOGGING_CATEGORY(SIMPLEMAIL_SERVER)
+
+using namespace SimpleMail;
+
+RelayGroup::RelayGroup(QObject *parent)
+    : QObject(parent)
+    , d_ptr(new RelayGroupPrivate(this))
+{
+}
+
+RelayGroup::~RelayGroup()
+{
+    delete d_ptr;
+}
+
+void RelayGroup::addServer(Server *server)
+{
+    Q_D(RelayGroup);
+    server->setParent(this);
+
+    RelayEndpoint ep;
+    ep.server = server;
+    d->endpoints.append(ep);
+}
+
+QList<Server *> RelayGroup::servers() const
+{
+    Q_D(const RelayGroup);
+    QList<Server *> ret;
+    ret.reserve(d->endpoints.size());
+    for (const RelayEndpoint &ep : d->endpoints) {
+        ret.append(ep.server);
+    }
+    return ret;
+}
+
+ServerReply *
+    RelayGroup::sendMail(const MimeMessage &msg, Server::Priority priority, QDeadlineTimer deadline)
+{
+    Q_D(RelayGroup);
+    auto reply = new ServerReply(this);
+
+    RelayAttempt attempt{msg, reply, {}, deadline, priority};
+    if (!d->dispatch(attempt)) {
+        // Callers connect to finished() after getting the reply
+        QTimer::singleShot(0, reply, [reply] {
+            reply->finish(true, ServerReply::TransportError, tr("No relay available"));
+        });
+    }
+
+    return reply;
+}
+
+RelayGroup::CircuitState RelayGroup::circuitState(Server *server) const
+{
+    Q_D(const RelayGroup);
+    const RelayEndpoint *ep = d->endpoint(server);
+    return ep ? ep->state : Open;
+}
+
+qreal RelayGroup::latency(Server *server) const
+{
+    Q_D(const RelayGroup);
+    const RelayEndpoint *ep = d->endpoint(server);
+    return ep ? ep->latency : 0;
+}
+
+qreal RelayGroup::errorRate(Server *server) const
+{
+    Q_D(const RelayGroup);
+    const RelayEndpoint *ep = d->endpoint(server);
+    return ep ? ep->errorRate : 0;
+}
+
+void RelayGroup::setSmoothing(qreal alpha)
+{
+    Q_D(RelayGroup);
+    d->smoothing = qBound(0.01, alpha, 1.0);
+}
+
+void RelayGroup::setFailureThreshold(int failures)
+{
+    Q_D(RelayGroup);
+    d->threshold = qMax(1, failures);
+}
+
+void RelayGroup::setMaxErrorRate(qreal rate)
+{
+    Q_D(RelayGroup);
+    d->maxErrors = rate;
+}
+
+void RelayGroup::setCooldown(int msec)
+{
+    Q_D(RelayGroup);
+    d->cooldown = qMax(0, msec);
+}
+
+RelayEndpoint *RelayGroupPrivate::endpoint(Server *server)
+{
+    for (RelayEndpoint &ep : endpoints) {
+        if (ep.server == server) {
+            return &ep;
+        }
+    }
+    return nullptr;
+}
+
+const RelayEndpoint *RelayGroupPrivate::endpoint(Server *server) const
+{
+    for (const RelayEndpoint &ep : endpoints) {
+        if (ep.server == server) {
+            return &ep;
+        }
+    }
+    return nullptr;
+}
+
+RelayEndpoint *RelayGroupPrivate::pick(const QList<Server *> &exclude)
+{
+    const qint64 now = clock.elapsed();
+
+    // Endpoints without deliveries are assumed to be as fast as the average
+    qreal known  = 0;
+    int measured = 0;
+    for (const RelayEndpoint &ep : std::as_const(endpoints)) {
+        if (ep.delivered) {
+            known += ep.latency;
+            ++measured;
+        }
+    }
+    const qreal fallback = measured ? known / measured : 1;
+
+    RelayEndpoint *best    = nullptr;
+    RelayEndpoint *ejected = nullptr;
+    qreal bestScore        = 0;
+    for (RelayEndpoint &ep : endpoints) {
+        if (ep.state == RelayGroup::HalfOpen || exclude.contains(ep.server) ||
+            ep.server->isShuttingDown()) {
+            continue;
+        }
+
+        if (ep.state == RelayGroup::Open) {
+            if (now >= ep.retryAt) {
+                // Probe with this message, a single one until it's answered
+                ep.state = RelayGroup::HalfOpen;
+                return &ep;
+            }
+            if (!ejected || ep.retryAt < ejected->retryAt) {
+                ejected = &ep;
+            }
+            continue;
+        }
+
+        // Expected time to complete a message behind the ones already queued
+        const qreal latency = ep.delivered ? qMax<qreal>(ep.latency, 1) : fallback;
+        const qreal score   = latency * (ep.server->queueSize() + 1);
+        if (!best || score < bestScore) {
+            best      = &ep;
+            bestScore = score;
+        }
+    }
+
+    if (!best && ejected) {
+        // Everything is ejected, probing early beats failing the message
+        ejected->state = RelayGroup::HalfOpen;
+        return ejected;
+    }
+    return best;
+}
+
+bool RelayGroupPrivate::dispatch(RelayAttempt attempt)
+{
+    RelayEndpoint *ep = pick(attempt.tried);
+    if (!ep) {
+        return false;
+    }
+
+    Server *server = ep->server;
+    attempt.tried.append(server);
+    attempt.probe = ep->state == RelayGroup::HalfOpen;
+
+    const qint64 submitted = clock.elapsed();
+    QPointer<ServerReply> reply =
+        server->sendMail(attempt.msg, attempt.priority, attempt.deadline);
+    if (reply->timestamp(ServerReply::Finished)) {
+        // Finished inside sendMail(), its signal is already gone
+        QTimer::singleShot(0, q_ptr, [this, reply, attempt, submitted] {
+            if (reply) {
+                finished(reply, attempt, submitted);
+            }
+        });
+    } else {
+        QObject::connect(reply, &ServerReply::finished, q_ptr, [this, reply, attempt, submitted] {
+            finished(reply, attempt, submitted);
+        });
+    }
+
+    // Deleting the group's reply cancels the message like it does on Server
+    QObject::connect(attempt.reply, &QObject::destroyed, reply, [this, reply, attempt] {
+        abortProbe(attempt);
+        delete reply;
+    });
+
+    return true;
+}
+
+void RelayGroupPrivate::finished(ServerReply *reply, RelayAttempt attempt, qint64 submitted)
+{
+    reply->deleteLater();
+    if (attempt.reply) {
+        QObject::disconnect(attempt.reply, &QObject::destroyed, reply, nullptr);
+    }
+
+    // Local failures say nothing about the relay's health
+    const int code    = reply->responseCode();
+    RelayEndpoint *ep = endpoint(attempt.tried.last());
+    if (code == ServerReply::DeadlineExpired || code == ServerReply::QueueFull ||
+        code == ServerReply::ShuttingDown) {
+        abortProbe(attempt);
+    } else if (ep) {
+        const qint64 now     = clock.elapsed();
+        const qint64 elapsed = now - qMax(submitted, ep->lastFinished);
+        record(ep, reply->error() && isTemporary(code), !reply->error(), elapsed);
+        ep->lastFinished = now;
+    }
+
+    if (!attempt.reply) {
+        return;
+    }
+
+    if (reply->error() && code != ServerReply::DeadlineExpired &&
+        (isTemporary(code) || code == ServerReply::QueueFull ||
+         code == ServerReply::ShuttingDown)) {
+        qCDebug(SIMPLEMAIL_SERVER) << "Relay failed temporarily, trying another one" << code
+                                   << reply->responseText();
+        if (dispatch(attempt)) {
+            return;
+        }
+    }
+
+    attempt.reply->d_ptr->recipientResponses = reply->recipientResponses();
+    attempt.reply->d_ptr->transcript         = reply->transcript();
+    attempt.reply->finish(reply->error(), code, reply->responseText());
+}
+
+void RelayGroupPrivate::record(RelayEndpoint *ep, bool failed, bool delivered, qint64 elapsed)
+{
+    Q_Q(RelayGroup);
+
+    ep->errorRate = ep->samples ? smoothing * failed + (1 - smoothing) * ep->errorRate : failed;
+    ++ep->samples;
+
+    // Only deliveries count for latency, an endpoint that rejects fast isn't fast.
+    // A server working through a backlog starts on the next message when it
+    // finishes the previous one, elapsed is measured from the later of both
+    if (delivered) {
+        ep->latency = ep->delivered ? smoothing * elapsed + (1 - smoothing) * ep->latency : elapsed;
+        ++ep->delivered;
+    }
+
+    if (!failed) {
+        ep->failures = 0;
+        if (ep->state != RelayGroup::Closed) {
+            qCInfo(SIMPLEMAIL_SERVER)
+                << "Relay restored" << ep->server->host() << ep->server->port();
+            ep->state     = RelayGroup::Closed;
+            ep->trips     = 0;
+            ep->errorRate = 0;
+            Q_EMIT q->serverRestored(ep->server);
+        }
+        return;
+    }
+
+    ++ep->failures;
+    if (ep->state == RelayGroup::Open) {
+        // Messages that were already queued when it was ejected
+        return;
+    }
+
+    if (ep->state == RelayGroup::HalfOpen) {
+        ++ep->trips;
+    } else if (ep->failures < threshold && (ep->samples < 10 || ep->errorRate < maxErrors)) {
+        return;
+    }
+
+    ep->state   = RelayGroup::Open;
+    ep->retryAt = clock.elapsed() + qint64(cooldown) * (1 << qMin(ep->trips, 3));
+    qCWarning(SIMPLEMAIL_SERVER) << "Relay ejected" << ep->server->host() << ep->server->port()
+                                 << ep->failures << ep->errorRate;
+    Q_EMIT q->serverEjected(ep->server);
+}
+
+void RelayGroupPrivate::abortProbe(const RelayAttempt &attempt)
+{
+    RelayEndpoint *ep = endpoint(attempt.tried.last());
+    if (attempt.probe && ep && ep->state == RelayGroup::HalfOpen) {
+        // Let the next message probe it instead
+        ep->state = RelayGroup::Open;
+    }
+}
+
+bool RelayGroupPrivate::isTemporary(int responseCode)
+{
+    return responseCode == ServerReply::TransportError || responseCode / 100 == 4;
+}
+
+#include "moc_relaygroup.cpp"
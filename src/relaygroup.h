@@ -0,0 +1,129 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#pragma once
+
+#include "server.h"
+#include "smtpexports.h"
+
+#include <QDeadlineTimer>
+#include <QObject>
+
+namespace SimpleMail {
+
+class MimeMessage;
+class ServerReply;
+class RelayGroupPrivate;
+/**
+ * RelayGroup spreads mail over several Server endpoints, usually one or
+ * more connections to each of a set of equivalent relays.
+ *
+ * Each endpoint keeps a moving average of its delivery latency and of
+ * its error rate, new messages go to the healthy endpoint expected to finish
+ * them first. After too many failures an endpoint is ejected by its circuit
+ * breaker, once the cooldown passes a single message probes it back in.
+ * Messages that fail temporarily are retried on the other endpoints.
+ */
+class SMTP_EXPORT RelayGroup : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PRIVATE(RelayGroup)
+public:
+    enum CircuitState {
+        Closed,   // Healthy, receives traffic
+        Open,     // Ejected until the cooldown passes
+        HalfOpen, // A probe message is on its way
+    };
+    Q_ENUM(CircuitState)
+
+    explicit RelayGroup(QObject *parent = nullptr);
+    virtual ~RelayGroup();
+
+    /**
+     * Adds an endpoint, the group takes ownership of it
+     */
+    void addServer(Server *server);
+
+    /**
+     * Returns the endpoints in the order they were added
+     */
+    QList<Server *> servers() const;
+
+    /**
+     * Sends the email through the best endpoint, see Server::sendMail().
+     * The returned reply belongs to the group and is finished with the
+     * result of the last attempt.
+     */
+    ServerReply *sendMail(const MimeMessage &msg,
+                          Server::Priority priority = Server::TransactionalPriority,
+                          QDeadlineTimer deadline   = QDeadlineTimer(QDeadlineTimer::Forever));
+
+    /**
+     * Returns the circuit breaker state of the endpoint
+     */
+    CircuitState circuitState(Server *server) const;
+
+    /**
+     * Returns the moving average of the endpoint's latency on successful
+     * transactions in milliseconds, zero until one succeeds
+     */
+    qreal latency(Server *server) const;
+
+    /**
+     * Returns the moving average of the endpoint's failures, from 0 to 1
+     */
+    qreal errorRate(Server *server) const;
+
+    /**
+     * Defines the weight of a new sample on the moving averages.
+     * Defaults to 0.2
+     */
+    void setSmoothing(qreal alpha);
+
+    /**
+     * Defines the number of consecutive failures that eject an endpoint.
+     * Defaults to 3
+     */
+    void setFailureThreshold(int failures);
+
+    /**
+     * Defines the error rate that ejects an endpoint, only considered after
+     * ten transactions. Defaults to 0.5
+     */
+    void setMaxErrorRate(qreal rate);
+
+    /**
+     * Defines how long in milliseconds an endpoint stays ejected before
+     * being probed, doubled on each failed probe up to eight times the cooldown.
+     * Defaults to 30 seconds
+     */
+    void setCooldown(int msec);
+
+Q_SIGNALS:
+    /**
+     * Emitted when the circuit breaker of the endpoint opens
+     */
+    void serverEjected(SimpleMail::Server *server);
+
+    /**
+     * Emitted when a probe succeeds and the endpoint receives traffic again
+     */
+    void serverRestored(SimpleMail::Server *server);
+
+private:
+    RelayGroupPrivate *d_ptr;
+};
+
+} // namespace SimpleMail
@@ -0,0 +1,79 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef RELAYGROUP_P_H
+#define RELAYGROUP_P_H
+
+#include "mimemessage.h"
+#include "relaygroup.h"
+
+#include <QElapsedTimer>
+#include <QPointer>
+
+namespace SimpleMail {
+
+struct RelayEndpoint {
+    Server *server                 = nullptr;
+    qint64 lastFinished            = -1; // clock time of the last completed transaction
+    qint64 retryAt                 = 0;  // clock time an open circuit may be probed
+    qreal latency                  = 0;
+    qreal errorRate                = 0;
+    int samples                    = 0;
+    int delivered                  = 0; // successful transactions, the latency samples
+    int failures                   = 0; // consecutive
+    int trips                      = 0; // consecutive failed probes
+    RelayGroup::CircuitState state = RelayGroup::Closed;
+};
+
+struct RelayAttempt {
+    MimeMessage msg;
+    QPointer<ServerReply> reply;
+    QList<Server *> tried;
+    QDeadlineTimer deadline;
+    Server::Priority priority;
+    bool probe = false;
+};
+
+class RelayGroupPrivate
+{
+    Q_DECLARE_PUBLIC(RelayGroup)
+public:
+    RelayGroupPrivate(RelayGroup *group)
+        : q_ptr(group)
+    {
+        clock.start();
+    }
+
+    RelayEndpoint *endpoint(Server *server);
+    const RelayEndpoint *endpoint(Server *server) const;
+    RelayEndpoint *pick(const QList<Server *> &exclude);
+    bool dispatch(RelayAttempt attempt);
+    void finished(ServerReply *reply, RelayAttempt attempt, qint64 submitted);
+    void record(RelayEndpoint *ep, bool failed, bool delivered, qint64 elapsed);
+    void abortProbe(const RelayAttempt &attempt);
+    static bool isTemporary(int responseCode);
+
+    RelayGroup *q_ptr;
+    QElapsedTimer clock;
+    QList<RelayEndpoint> endpoints;
+    qreal smoothing = 0.2;
+    qreal maxErrors = 0.5;
+    int threshold   = 3;
+    int cooldown    = 30000;
+};
+
+} // namespace SimpleMail
+
+#endif // RELAYGROUP_P_H
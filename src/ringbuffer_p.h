@@ -0,0 +1,96 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef RINGBUFFER_P_H
+#define RINGBUFFER_P_H
+
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <QtGlobal>
+
+namespace SimpleMail {
+
+/**
+ * FIFO over a power of two sized circular array, the slots are reused so
+ * after growing to the working set size no more allocations are needed
+ * for queueing and dequeueing
+ */
+template <typename T>
+class RingBuffer
+{
+public:
+    inline bool isEmpty() const { return m_size == 0; }
+    inline qsizetype size() const { return m_size; }
+
+    inline T &first() { return *m_slots[m_head]; }
+    inline const T &first() const { return *m_slots[m_head]; }
+
+    inline T &operator[](qsizetype i) { return *m_slots[(m_head + i) & mask()]; }
+    inline const T &operator[](qsizetype i) const { return *m_slots[(m_head + i) & mask()]; }
+
+    void append(T &&value)
+    {
+        if (m_size == qsizetype(m_slots.size())) {
+            grow();
+        }
+        m_slots[(m_head + m_size) & mask()].emplace(std::move(value));
+        ++m_size;
+    }
+
+    T takeFirst()
+    {
+        T value = std::move(*m_slots[m_head]);
+        removeFirst();
+        return value;
+    }
+
+    void removeFirst()
+    {
+        m_slots[m_head].reset();
+        m_head = (m_head + 1) & mask();
+        --m_size;
+    }
+
+    void clear()
+    {
+        while (m_size) {
+            removeFirst();
+        }
+        m_head = 0;
+    }
+
+private:
+    inline qsizetype mask() const { return qsizetype(m_slots.size()) - 1; }
+
+    void grow()
+    {
+        std::vector<std::optional<T>> slots(m_slots.empty() ? 16 : m_slots.size() * 2);
+        for (qsizetype i = 0; i < m_size; ++i) {
+            slots[i] = std::move(m_slots[(m_head + i) & mask()]);
+        }
+        m_slots.swap(slots);
+        m_head = 0;
+    }
+
+    std::vector<std::optional<T>> m_slots;
+    qsizetype m_head = 0;
+    qsizetype m_size = 0;
+};
+
+} // namespace SimpleMail
+
+#endif // RINGBUFFER_P_H
@@ -16,11 +16,24 @@
 #include "server_p.h"
 #include "serverreply.h"
 
+#include "ratelimiter.h"
+#include "serverreply_p.h"
+#include "sockettransport_p.h"
+#include "tracing_p.h"
+
+#ifdef SIMPLEMAIL_IO_URING
+#include "iouringtransport_p.h"
+#endif
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include <QEventLoop>
 #include <QHostInfo>
 #include <QLoggingCategory>
 #include <QMessageAuthenticationCode>
 #include <QSslSocket>
-#include <QTcpSocket>
 
 Q_LOGGING_CATEGORY(SIMPLEMAIL_SERVER, "simplemail.server", QtInfoMsg)
 
@@ -32,6 +45,19 @@ Server::Server(QObject *parent)
 {
     Q_D(Server);
     d->hostname = QHostInfo::localHostName();
+    d->transcript.setCapacity(32);
+
+    connect(&d->keepAliveTimer, &QTimer::timeout, this, [d] { d->keepAlive(); });
+
+    d->shutdownTimer.setSingleShot(true);
+    connect(&d->shutdownTimer, &QTimer::timeout, this, [d] { d->abandonQueue(); });
+
+    d->rateTimer.setSingleShot(true);
+    connect(&d->rateTimer, &QTimer::timeout, this, [d] {
+        if (d->state == ServerPrivate::Ready) {
+            d->processNextMail();
+        }
+    });
 }
 
 Server::~Server()
@@ -75,6 +101,19 @@ void Server::setHostname(const QString &hostname)
     d->hostname = hostname;
 }
 
+QHostAddress Server::nameserver() const
+{
+    Q_D(const Server);
+    return d->nameserver;
+}
+
+void Server::setNameserver(const QHostAddress &address, quint16 port)
+{
+    Q_D(Server);
+    d->nameserver     = address;
+    d->nameserverPort = port;
+}
+
 Server::ConnectionType Server::connectionType() const
 {
     Q_D(const Server);
@@ -84,11 +123,31 @@ Server::ConnectionType Server::connectionType() const
 void Server::setConnectionType(Server::ConnectionType ct)
 {
     Q_D(Server);
-    delete d->socket;
-    d->socket         = nullptr;
+    if (d->connectionType == ct) {
+        return;
+    }
+
+    if (!d->customTransport) {
+        delete d->transport;
+        d->transport = nullptr;
+    }
     d->connectionType = ct;
 }
 
+#ifndef QT_NO_SSL
+QSslConfiguration Server::sslConfiguration() const
+{
+    Q_D(const Server);
+    return d->tlsConfiguration();
+}
+
+void Server::setSslConfiguration(const QSslConfiguration &configuration)
+{
+    Q_D(Server);
+    d->sslConfiguration = configuration;
+}
+#endif
+
 QString Server::username() const
 {
     Q_D(const Server);
@@ -128,22 +187,157 @@ void Server::setAuthMethod(Server::AuthMethod method)
     d->authMethod = method;
 }
 
+Server::Protocol Server::protocol() const
+{
+    Q_D(const Server);
+    return d->protocol;
+}
+
+void Server::setProtocol(Server::Protocol protocol)
+{
+    Q_D(Server);
+    d->protocol = protocol;
+}
+
+int Server::keepAliveInterval() const
+{
+    Q_D(const Server);
+    return d->keepAliveTimer.isActive() ? d->keepAliveTimer.interval() : 0;
+}
+
+void Server::setKeepAliveInterval(int msec)
+{
+    Q_D(Server);
+    if (msec > 0) {
+        d->keepAliveTimer.start(msec);
+    } else {
+        d->keepAliveTimer.stop();
+    }
+}
+
+int Server::maxIdleTime() const
+{
+    Q_D(const Server);
+    return d->maxIdleTime;
+}
+
+void Server::setMaxIdleTime(int msec)
+{
+    Q_D(Server);
+    d->maxIdleTime = qMax(0, msec);
+}
+
+Server::Extensions Server::extensions() const
+{
+    Q_D(const Server);
+    return d->extensions;
+}
+
+qint64 Server::sizeLimit() const
+{
+    Q_D(const Server);
+    return d->sizeLimit;
+}
+
+QStringList Server::authMechanisms() const
+{
+    Q_D(const Server);
+    return d->authMechanisms;
+}
+
+Transport *Server::transport() const
+{
+    Q_D(const Server);
+    return d->transport;
+}
+
+void Server::setTransport(Transport *transport)
+{
+    Q_D(Server);
+    if (d->transport == transport) {
+        return;
+    }
+
+    delete d->transport;
+    d->transport       = transport;
+    d->customTransport = transport != nullptr;
+    d->state           = ServerPrivate::Disconnected;
+    if (transport) {
+        transport->setParent(this);
+        d->connectTransport();
+    }
+}
+
+bool Server::ioUringEnabled() const
+{
+    Q_D(const Server);
+    return d->ioUring;
+}
+
+void Server::setIoUringEnabled(bool enabled)
+{
+    Q_D(Server);
+    if (d->ioUring != enabled && !d->customTransport) {
+        delete d->transport;
+        d->transport = nullptr;
+    }
+    d->ioUring = enabled;
+}
+
 ServerReply *Server::sendMail(const MimeMessage &email)
+{
+    return sendMail(email, TransactionalPriority);
+}
+
+ServerReply *Server::sendMail(const MimeMessage &email, Priority priority, QDeadlineTimer deadline)
 {
     Q_D(Server);
+    auto reply = new ServerReply(this);
+
+    if (d->shuttingDown) {
+        d->finishLater(reply, ServerReply::ShuttingDown, tr("Server is shutting down"));
+        return reply;
+    }
+
     ServerReplyContainer cont(email);
-    cont.reply = new ServerReply(this);
+    cont.reply    = reply;
+    cont.deadline = deadline;
+    if (d->maxQueuedBytes > 0) {
+        cont.size      = email.encodedSize();
+        cont.sizeState = ServerReplyContainer::SizeSevenBit;
+    }
+
+    if (d->isQueueFull(qMax<qint64>(0, cont.size))) {
+        if (d->queuePolicy == RejectWhenFull) {
+            d->finishLater(reply, ServerReply::QueueFull, tr("Send queue is full"));
+            return reply;
+        }
+
+        qCDebug(SIMPLEMAIL_SERVER) << "Queue full, waiting" << d->queue.size() << d->queue.bytes();
+        QEventLoop loop;
+        d->blockedSenders.append(&loop);
+        while (d->isQueueFull(qMax<qint64>(0, cont.size)) && !d->shuttingDown) {
+            loop.exec();
+        }
+        d->blockedSenders.removeOne(&loop);
+
+        if (d->shuttingDown) {
+            d->finishLater(reply, ServerReply::ShuttingDown, tr("Server is shutting down"));
+            return reply;
+        }
+    }
 
     // Add to the mail queue
-    d->queue.append(cont);
+    d->queue.enqueue(std::move(cont), priority);
 
     if (d->state == ServerPrivate::Disconnected) {
         connectToServer();
     } else if (d->state == ServerPrivate::Ready) {
         d->processNextMail();
     }
+    d->updateBackpressure();
 
-    return cont.reply.data();
+    return reply;
 }
 
 int Server::queueSize() const
@@ -152,44 +346,171 @@ int Server::queueSize() const
     return d->queue.size();
 }
 
+qint64 Server::queuedBytes() const
+{
+    Q_D(const Server);
+    return d->queue.bytes();
+}
+
+int Server::maxQueuedMessages() const
+{
+    Q_D(const Server);
+    return d->maxQueuedMessages;
+}
+
+void Server::setMaxQueuedMessages(int max)
+{
+    Q_D(Server);
+    d->maxQueuedMessages = qMax(0, max);
+}
+
+qint64 Server::maxQueuedBytes() const
+{
+    Q_D(const Server);
+    return d->maxQueuedBytes;
+}
+
+void Server::setMaxQueuedBytes(qint64 max)
+{
+    Q_D(Server);
+    d->maxQueuedBytes = qMax<qint64>(0, max);
+}
+
+std::shared_ptr<RateLimiter> Server::rateLimiter() const
+{
+    Q_D(const Server);
+    return d->rateLimiter;
+}
+
+void Server::setRateLimiter(const std::shared_ptr<RateLimiter> &limiter)
+{
+    Q_D(Server);
+    d->rateLimiter = limiter;
+}
+
+Server::QueuePolicy Server::queuePolicy() const
+{
+    Q_D(const Server);
+    return d->queuePolicy;
+}
+
+void Server::setQueuePolicy(QueuePolicy policy)
+{
+    Q_D(Server);
+    d->queuePolicy = policy;
+}
+
+void Server::setQueueWatermarks(qreal low, qreal high)
+{
+    Q_D(Server);
+    d->highWatermark = qBound<qreal>(0, high, 1);
+    d->lowWatermark  = qBound<qreal>(0, low, d->highWatermark);
+}
+
 void Server::connectToServer()
 {
     Q_D(Server);
+    if (d->state != ServerPrivate::Disconnected) {
+        return;
+    }
 
-    d->createSocket();
+    d->createTransport();
 
-    switch (d->connectionType) {
-    case Server::TlsConnection:
-    case Server::TcpConnection:
-        qCDebug(SIMPLEMAIL_SERVER) << "Connecting to host" << d->host << d->port;
-        d->socket->connectToHost(d->host, d->port);
-        d->state = ServerPrivate::Connecting;
-        break;
+    auto socketTransport = qobject_cast<SocketTransport *>(d->transport);
+    if (socketTransport) {
+        socketTransport->setNameserver(d->nameserver, d->nameserverPort);
 #ifndef QT_NO_SSL
-    case Server::SslConnection:
-    {
-        auto sslSock = qobject_cast<QSslSocket *>(d->socket);
-        if (sslSock) {
-            qCDebug(SIMPLEMAIL_SERVER) << "Connecting to host encrypted" << d->host << d->port;
-            sslSock->connectToHostEncrypted(d->host, d->port);
-            d->state = ServerPrivate::Connecting;
-        } else {
-            return /*false*/;
+        if (d->connectionType == SslConnection || d->connectionType == TlsConnection) {
+            QSslConfiguration configuration = d->tlsConfiguration();
+            configuration.setPeerVerifyMode(d->peerVerificationType == Server::VerifyNone
+                                                ? QSslSocket::VerifyNone
+                                                : QSslSocket::VerifyPeer);
+            socketTransport->setSslConfiguration(configuration);
         }
+#endif
+    }
+#ifdef SIMPLEMAIL_IO_URING
+    auto ioUringTransport = qobject_cast<IoUringTransport *>(d->transport);
+    if (ioUringTransport) {
+        ioUringTransport->setNameserver(d->nameserver, d->nameserverPort);
     }
-#else
-        qCDebug(SIMPLEMAIL_SERVER)
-            << "Impossible to connected to host encrypted QT_NO_SSL is defined";
 #endif
-    break;
+
+    std::fill(std::begin(d->connectionTimestamps), std::end(d->connectionTimestamps), 0);
+    d->markConnection(ServerReply::ConnectStarted);
+    ServerCounters::add(d->counters.connects);
+    d->counters.setState(ServerMetrics::Connecting);
+
+    d->transcript.clear();
+    SIMPLEMAIL_TRACE(connect__start, d->host.toUtf8().constData(), int(d->port));
+    d->transport->connectToHost(d->host, d->port);
+    d->state = ServerPrivate::Connecting;
+}
+
+void Server::drain()
+{
+    shutdown(QDeadlineTimer(QDeadlineTimer::Forever));
+}
+
+void Server::shutdown(QDeadlineTimer deadline)
+{
+    Q_D(Server);
+    if (d->shuttingDown) {
+        return;
+    }
+
+    qCDebug(SIMPLEMAIL_SERVER) << "Shutting down" << d->queue.size() << deadline.remainingTime();
+    d->shuttingDown = true;
+    d->keepAliveTimer.stop();
+    d->wakeBlockedSenders();
+
+    d->queue.forEach([d](const ServerReplyContainer &cont) { d->trackDrain(cont.reply); });
+
+    if (!deadline.isForever()) {
+        d->shutdownTimer.start(
+            int(qMin<qint64>(deadline.remainingTime(), std::numeric_limits<int>::max())));
     }
+    d->quitIfDrained();
+}
+
+bool Server::isShuttingDown() const
+{
+    Q_D(const Server);
+    return d->shuttingDown;
+}
+
+LatencyHistogram Server::latencyHistogram(ServerReply::Phase phase) const
+{
+    Q_D(const Server);
+    return d->latency[phase].snapshot();
+}
+
+int Server::transcriptLines() const
+{
+    Q_D(const Server);
+    return d->transcript.capacity();
+}
+
+void Server::setTranscriptLines(int lines)
+{
+    Q_D(Server);
+    d->transcript.setCapacity(lines);
+}
+
+ServerMetrics Server::metrics() const
+{
+    Q_D(const Server);
+    ServerMetrics ret  = d->counters.snapshot();
+    ret.queuedMessages = d->queue.size();
+    ret.queuedBytes    = d->queue.bytes();
+    return ret;
 }
 
 #ifndef QT_NO_SSL
 void Server::ignoreSslErrors()
 {
     Q_D(Server);
-    auto sslSock = qobject_cast<QSslSocket *>(d->socket);
+    auto sslSock = d->sslSocket();
     if (sslSock) {
         sslSock->ignoreSslErrors();
     }
@@ -198,289 +519,411 @@ void Server::ignoreSslErrors()
 void Server::ignoreSslErrors(const QList<QSslError> &errors)
 {
     Q_D(Server);
-    auto sslSock = qobject_cast<QSslSocket *>(d->socket);
+    auto sslSock = d->sslSocket();
     if (sslSock) {
         sslSock->ignoreSslErrors(errors);
     }
 }
 #endif
 
-void ServerPrivate::createSocket()
+void ServerPrivate::createTransport()
 {
     Q_Q(Server);
 
-    if (socket) {
+    if (transport) {
         return;
     }
 
-    switch (connectionType) {
-    case Server::TcpConnection:
-        socket = new QTcpSocket(q);
-        break;
-    case Server::SslConnection:
-    case Server::TlsConnection:
+#ifdef SIMPLEMAIL_IO_URING
+    if (ioUring && connectionType == Server::TcpConnection && IoUringTransport::isAvailable()) {
+        transport = new IoUringTransport(q);
+        connectTransport();
+        return;
+    }
+#endif
+
+    auto socketTransport = new SocketTransport(connectionType, q);
+    transport            = socketTransport;
 #ifndef QT_NO_SSL
-        socket = new QSslSocket(q);
+    if (sslSocket()) {
+        // Forwarded from whichever socket wins the connection race
         setPeerVerificationType(peerVerificationType);
-        q->connect(
-            static_cast<QSslSocket *>(socket),
-            static_cast<void (QSslSocket::*)(const QList<QSslError> &)>(&QSslSocket::sslErrors),
-            q,
-            &Server::sslErrors,
-            Qt::DirectConnection);
-#else
-        qFatal("QT_NO_SSL defined, can't send emails");
-#endif
+        q->connect(socketTransport,
+                   &SocketTransport::sslErrors,
+                   q,
+                   &Server::sslErrors,
+                   Qt::DirectConnection);
     }
-    q->connect(socket, &QTcpSocket::stateChanged, q, [=](QAbstractSocket::SocketState sockState) {
-        qCDebug(SIMPLEMAIL_SERVER) << "stateChanged" << sockState << socket->readAll();
-        if (sockState == QAbstractSocket::ClosingState) {
-            state = Closing;
-        } else if (sockState == QAbstractSocket::UnconnectedState) {
-            state = Disconnected;
-            if (!queue.isEmpty()) {
-                q->connectToServer();
-            }
-        }
-    });
+#endif
+    connectTransport();
+}
+
+void ServerPrivate::connectTransport()
+{
+    Q_Q(Server);
 
-    q->connect(socket, &QTcpSocket::connected, q, [=]() {
-        qCDebug(SIMPLEMAIL_SERVER) << "connected" << state << socket->readAll();
-        state = WaitingForServiceReady220;
+    q->connect(transport, &Transport::connected, q, [this] { transportConnected(); });
+    q->connect(transport, &Transport::encrypted, q, [this] {
+        markConnection(ServerReply::Encrypted);
     });
+    q->connect(transport, &Transport::disconnected, q, [this] { transportDisconnected(); });
+    q->connect(transport, &Transport::errorOccurred, q, [this] { transportError(); });
+    q->connect(transport, &Transport::readyRead, q, [this] { transportReadyRead(); });
+    q->connect(transport, &Transport::bytesWritten, q, [this](qint64 bytes) {
+        ServerCounters::add(counters.bytesWritten, quint64(bytes));
+    });
+}
 
-    auto erroFn = [=](QAbstractSocket::SocketError error) {
-        qCDebug(SIMPLEMAIL_SERVER) << "SocketError" << error << socket->readAll();
-        if (!queue.isEmpty()) {
-            ServerReplyContainer &cont = queue[0];
-            if (!cont.reply.isNull()) {
-                ServerReply *reply = cont.reply;
-                queue.removeFirst();
-                reply->finish(true, -1, socket->errorString());
-            } else {
-                queue.removeFirst();
-            }
-        }
-    };
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
-    q->connect(socket, &QTcpSocket::errorOccurred, q, erroFn);
-#else
-    q->connect(socket,
-               static_cast<void (QTcpSocket::*)(QTcpSocket::SocketError)>(&QTcpSocket::error),
-               q,
-               erroFn);
+#ifndef QT_NO_SSL
+QSslConfiguration ServerPrivate::sharedSslConfiguration()
+{
+    // Parsing the system CA bundle is expensive, so it's done once and
+    // the implicitly shared result is reused by every connection
+    static const QSslConfiguration configuration = [] {
+        QSslConfiguration config = QSslConfiguration::defaultConfiguration();
+        config.setCaCertificates(QSslConfiguration::systemCaCertificates());
+        return config;
+    }();
+    return configuration;
+}
+
+QSslConfiguration ServerPrivate::tlsConfiguration() const
+{
+    // Plain TCP and local socket users never get to parse the CA bundle
+    return sslConfiguration ? *sslConfiguration : sharedSslConfiguration();
+}
+
+QSslSocket *ServerPrivate::sslSocket() const
+{
+    auto socketTransport = qobject_cast<SocketTransport *>(transport);
+    return socketTransport ? qobject_cast<QSslSocket *>(socketTransport->socket()) : nullptr;
+}
 #endif
 
-    q->connect(socket, &QTcpSocket::readyRead, q, [=] {
-        qCDebug(SIMPLEMAIL_SERVER) << "readyRead" << socket->bytesAvailable();
-        switch (state) {
-        case SendingMail:
-            while (socket->canReadLine()) {
-                if (!queue.isEmpty()) {
-                    ServerReplyContainer &cont = queue[0];
-                    if (cont.state == ServerReplyContainer::SendingCommands) {
-                        while (!cont.awaitedCodes.isEmpty() && socket->canReadLine()) {
-                            const int awaitedCode = cont.awaitedCodes.takeFirst();
-
-                            QByteArray responseText;
-                            const int code = parseResponseCode(&responseText);
-                            if (code != awaitedCode) {
-                                // Reset connection
-                                if (!cont.reply.isNull()) {
-                                    ServerReply *reply = cont.reply;
-                                    queue.removeFirst();
-                                    reply->finish(true, code, QString::fromLatin1(responseText));
-                                } else {
-                                    queue.removeFirst();
-                                }
-                                const QByteArray consume = socket->readAll();
-                                qDebug() << "Mail error" << consume;
-                                state = Ready;
-                                commandReset();
-                                return;
-                            }
+void ServerPrivate::transportConnected()
+{
+    qCDebug(SIMPLEMAIL_SERVER) << "connected" << state;
+    markConnection(ServerReply::Connected);
+    SIMPLEMAIL_TRACE(connect__done, host.toUtf8().constData(), int(port));
+    counters.setState(ServerMetrics::Handshaking);
+    state = WaitingForServiceReady220;
+}
 
-                            if (!capPipelining && !cont.awaitedCodes.isEmpty()) {
-                                // Write next command
-                                socket->write(
-                                    cont.commands[cont.commands.size() - cont.awaitedCodes.size()]);
-                            }
-                        }
+void ServerPrivate::transportDisconnected()
+{
+    Q_Q(Server);
+
+    state = Disconnected;
+    idleTimer.invalidate();
+    counters.setState(ServerMetrics::Disconnected);
+    counters.setInFlight(false);
+
+    if (shuttingDown && queue.isEmpty()) {
+        quitIfDrained();
+        return;
+    }
+
+    // A recycled connection is replaced right away to stay warm
+    if (std::exchange(recycling, false)) {
+        q->connectToServer();
+    } else if (!queue.isEmpty()) {
+        ServerCounters::add(counters.reconnects);
+        q->connectToServer();
+    }
+}
+
+void ServerPrivate::transportError()
+{
+    SIMPLEMAIL_TRACE(transport__error,
+                     host.toUtf8().constData(),
+                     int(port),
+                     transport->errorString().toUtf8().constData());
+
+    if (!queue.isEmpty()) {
+        ServerReplyContainer &cont = queue.head();
+        if (!cont.reply.isNull()) {
+            ServerReply *reply = cont.reply;
+            queue.removeHead();
+            ServerCounters::add(counters.messagesFailed);
+            attachTranscript(reply);
+            reply->finish(true, ServerReply::TransportError, transport->errorString());
+        } else {
+            queue.removeHead();
+        }
+        updateBackpressure();
+    }
+}
+
+void ServerPrivate::transportReadyRead()
+{
+    Q_Q(Server);
+
+    qCDebug(SIMPLEMAIL_SERVER) << "readyRead" << transport->bytesAvailable();
+    switch (state) {
+    case SendingMail:
+        while (transport->canReadLine()) {
+            if (!queue.isEmpty()) {
+                ServerReplyContainer &cont = queue.head();
+                if (cont.state == ServerReplyContainer::SendingCommands) {
+                    while (!transaction.awaitedCodes.isEmpty() && transport->canReadLine()) {
+                        const int awaitedCode = transaction.awaitedCodes.takeFirst();
 
-                        if (cont.awaitedCodes.isEmpty()) {
-                            cont.state = ServerReplyContainer::SendingData;
-                            if (cont.msg.write(socket) &&
-                                socket->write(QByteArrayLiteral("\r\n.\r\n")) == 5) {
-                                qCDebug(SIMPLEMAIL_SERVER) << "Mail sent";
+                        QByteArray responseText;
+                        const int code = parseResponseCode(&responseText);
+                        if (code != awaitedCode) {
+                            // Reset connection
+                            if (!cont.reply.isNull()) {
+                                ServerReply *reply = cont.reply;
+                                queue.removeHead();
+                                ServerCounters::add(counters.messagesFailed);
+                                attachTranscript(reply);
+                                reply->finish(true, code, QString::fromLatin1(responseText));
                             } else {
-                                qCCritical(SIMPLEMAIL_SERVER) << "Error writing mail";
-                                if (!cont.reply.isNull()) {
-                                    ServerReply *reply = cont.reply;
-                                    queue.removeFirst();
-                                    reply->finish(true, -1, q->tr("Error sending mail DATA"));
-                                } else {
-                                    queue.removeFirst();
-                                }
-                                socket->disconnectFromHost();
-                                return;
+                                queue.removeHead();
                             }
+                            counters.setInFlight(false);
+                            const QByteArray consume = transport->readAll();
+                            qDebug() << "Mail error" << consume;
+                            state = Ready;
+                            commandReset();
+                            updateBackpressure();
+                            return;
                         }
-                    } else if (cont.state == ServerReplyContainer::SendingData) {
-                        QByteArray responseText;
-                        const int code = parseResponseCode(&responseText);
+
+                        if (!extensions.testFlag(Server::Pipelining) &&
+                            !transaction.awaitedCodes.isEmpty()) {
+                            // Write next command
+                            writeCommand(transaction.commands[transaction.commands.size() -
+                                                              transaction.awaitedCodes.size()]);
+                        }
+                    }
+
+                    if (transaction.awaitedCodes.isEmpty()) {
+                        cont.state = ServerReplyContainer::SendingData;
                         if (!cont.reply.isNull()) {
-                            ServerReply *reply = cont.reply;
-                            queue.removeFirst();
-                            reply->finish(code != 250, code, QString::fromLatin1(responseText));
-                        } else {
-                            queue.removeFirst();
+                            cont.reply->d_func()->mark(ServerReply::RecipientsAccepted);
                         }
-                        qCDebug(SIMPLEMAIL_SERVER)
-                            << "MAIL FINISHED" << code << queue.size() << socket->canReadLine();
 
-                        processNextMail();
-                    }
-                } else {
-                    state = Ready;
-                    break;
-                }
-            }
-            break;
-        case WaitingForServerCaps250:
-            while (socket->canReadLine()) {
-                int ret = parseCaps();
-                if (ret != 0 && ret == 1) {
-                    qCDebug(SIMPLEMAIL_SERVER) << "CAPS" << caps;
-                    capPipelining = caps.contains(QStringLiteral("250-PIPELINING"));
-#ifndef QT_NO_SSL
-                    if (connectionType == Server::TlsConnection) {
-                        auto sslSocket = qobject_cast<QSslSocket *>(socket);
-                        if (sslSocket) {
-                            if (!sslSocket->isEncrypted()) {
-                                qCDebug(SIMPLEMAIL_SERVER) << "Sending STARTTLS";
-                                socket->write(QByteArrayLiteral("STARTTLS\r\n"));
-                                state = WaitingForServerStartTls_220;
+                        SIMPLEMAIL_TRACE(data__start, cont.reply.data());
+                        const bool written =
+                            cont.msg.write(transport, extensions.testFlag(Server::EightBitMime)) &&
+                            transport->write(QByteArrayLiteral("\r\n.\r\n")) == 5;
+                        SIMPLEMAIL_TRACE(data__done, cont.reply.data(), int(written));
+
+                        if (written) {
+                            qCDebug(SIMPLEMAIL_SERVER) << "Mail sent";
+                            if (!cont.reply.isNull()) {
+                                cont.reply->d_func()->mark(ServerReply::DataWritten);
+                            }
+                        } else {
+                            qCCritical(SIMPLEMAIL_SERVER) << "Error writing mail";
+                            if (!cont.reply.isNull()) {
+                                ServerReply *reply = cont.reply;
+                                queue.removeHead();
+                                ServerCounters::add(counters.messagesFailed);
+                                attachTranscript(reply);
+                                reply->finish(true,
+                                              ServerReply::TransportError,
+                                              q->tr("Error sending mail DATA"));
                             } else {
-                                login();
+                                queue.removeHead();
                             }
+                            transport->disconnectFromHost();
+                            updateBackpressure();
+                            return;
+                        }
+                    }
+                } else if (cont.state == ServerReplyContainer::SendingData) {
+                    QByteArray responseText;
+                    int code = parseResponseCode(&responseText);
+                    if (protocol == Server::Lmtp) {
+                        // LMTP replies once for each accepted recipient
+                        const int index = transaction.recipientResponses.size();
+                        transaction.recipientResponses.append(
+                            {transaction.recipients.value(index),
+                             QString::fromLatin1(responseText),
+                             code});
+                        if (transaction.recipientResponses.size() <
+                            transaction.recipients.size()) {
+                            continue;
+                        }
+
+                        // The first failure, if any, represents the whole transaction
+                        for (const auto &response :
+                             std::as_const(transaction.recipientResponses)) {
+                            if (response.code != 250) {
+                                code         = response.code;
+                                responseText = response.text.toLatin1();
+                                break;
+                            }
+                        }
+                    }
+
+                    ServerCounters::add(code == 250 ? counters.messagesSent
+                                                    : counters.messagesFailed);
+                    counters.setInFlight(false);
+                    if (!cont.reply.isNull()) {
+                        ServerReply *reply = cont.reply;
+                        reply->d_func()->recipientResponses =
+                            std::move(transaction.recipientResponses);
+                        reply->d_func()->mark(ServerReply::Finished);
+                        recordLatency(reply->d_func());
+                        if (code != 250) {
+                            attachTranscript(reply);
                         }
+                        queue.removeHead();
+                        reply->finish(code != 250, code, QString::fromLatin1(responseText));
                     } else {
-                        login();
+                        queue.removeHead();
                     }
-#else
-                    login();
-#endif
-                    break;
-                } else if (ret == -1) {
-                    break;
+                    qCDebug(SIMPLEMAIL_SERVER)
+                        << "MAIL FINISHED" << code << queue.size() << transport->canReadLine();
+
+                    processNextMail();
                 }
+            } else {
+                state = Ready;
+                break;
             }
-            break;
-        case WaitingForServerStartTls_220:
-            if (socket->canReadLine()) {
-                if (parseResponseCode(220)) {
+        }
+        break;
+    case WaitingForServerCaps250:
+        while (transport->canReadLine()) {
+            int ret = parseCaps();
+            if (ret != 0 && ret == 1) {
+                qCDebug(SIMPLEMAIL_SERVER)
+                    << "Extensions" << extensions << sizeLimit << authMechanisms;
+                markConnection(ServerReply::HelloDone);
 #ifndef QT_NO_SSL
-                    auto sslSock = qobject_cast<QSslSocket *>(socket);
-                    if (sslSock) {
-                        qCDebug(SIMPLEMAIL_SERVER) << "Starting client encryption";
-                        sslSock->startClientEncryption();
-
-                        // This will be queued and sent once the connection get's encrypted
-                        socket->write("EHLO " + hostname.toLatin1() + "\r\n");
-                        state = WaitingForServerCaps250;
-                        caps.clear();
+                if (connectionType == Server::TlsConnection && !transport->isEncrypted()) {
+                    if (!transport->capabilities().testFlag(Transport::Encryption)) {
+                        // Logging in anyway would send the credentials in the clear
+                        failConnection(Server::ClientError,
+                                       ServerReply::TransportError,
+                                       q->tr("TLS is required but the transport can't encrypt"));
+                        break;
                     }
-#endif
+
+                    qCDebug(SIMPLEMAIL_SERVER) << "Sending STARTTLS";
+                    writeCommand(QByteArrayLiteral("STARTTLS\r\n"));
+                    state = WaitingForServerStartTls_220;
+                } else {
+                    login();
                 }
+#else
+                login();
+#endif
+                break;
+            } else if (ret == -1) {
+                break;
             }
-            break;
-        case Noop_250:
-        case Reset_250:
-            if (parseResponseCode(250)) {
-                qCDebug(SIMPLEMAIL_SERVER) << "Got NOOP/RSET OK";
+        }
+        break;
+    case WaitingForServerStartTls_220:
+        if (transport->canReadLine()) {
+            if (parseResponseCode(220)) {
+                transport->startClientEncryption();
+
+                // This will be queued and sent once the connection get's encrypted
+                commandHello();
+                state = WaitingForServerCaps250;
+            }
+        }
+        break;
+    case Noop_250:
+    case Reset_250:
+        if (parseResponseCode(250)) {
+            qCDebug(SIMPLEMAIL_SERVER) << "Got NOOP/RSET OK";
+            state = Ready;
+            processNextMail();
+        }
+        break;
+    case Quit_221:
+        // The session is over whatever the reply is
+        qCDebug(SIMPLEMAIL_SERVER) << "Got QUIT reply" << transport->readAll();
+        transport->disconnectFromHost();
+        break;
+    case WaitingForAuthPlain235:
+    case WaitingForAuthLogin235_step3:
+    case WaitingForAuthCramMd5_235_step2:
+        if (transport->canReadLine()) {
+            if (parseResponseCode(235, Server::AuthenticationFailedError)) {
+                markConnection(ServerReply::Authenticated);
                 state = Ready;
                 processNextMail();
             }
-            break;
-        case WaitingForAuthPlain235:
-        case WaitingForAuthLogin235_step3:
-        case WaitingForAuthCramMd5_235_step2:
-            if (socket->canReadLine()) {
-                if (parseResponseCode(235, Server::AuthenticationFailedError)) {
-                    state = Ready;
-                    processNextMail();
-                }
-            }
-            break;
-        case WaitingForAuthLogin334_step1:
-            if (socket->canReadLine()) {
-                if (parseResponseCode(334, Server::AuthenticationFailedError)) {
-                    // Send the username in base64
-                    qCDebug(SIMPLEMAIL_SERVER) << "Sending authentication user" << username;
-                    socket->write(username.toUtf8().toBase64() + "\r\n");
-                    state = WaitingForAuthLogin334_step2;
-                }
+        }
+        break;
+    case WaitingForAuthLogin334_step1:
+        if (transport->canReadLine()) {
+            if (parseResponseCode(334, Server::AuthenticationFailedError)) {
+                // Send the username in base64
+                qCDebug(SIMPLEMAIL_SERVER) << "Sending authentication user" << username;
+                transcript.append(Transcript::Client, "***", 3);
+                transport->write(username.toUtf8().toBase64() + "\r\n");
+                state = WaitingForAuthLogin334_step2;
             }
-            break;
-        case WaitingForAuthLogin334_step2:
-            if (socket->canReadLine()) {
-                if (parseResponseCode(334, Server::AuthenticationFailedError)) {
-                    // Send the password in base64
-                    qCDebug(SIMPLEMAIL_SERVER) << "Sending authentication password";
-                    socket->write(password.toUtf8().toBase64() + "\r\n");
-                    state = WaitingForAuthLogin235_step3;
-                }
+        }
+        break;
+    case WaitingForAuthLogin334_step2:
+        if (transport->canReadLine()) {
+            if (parseResponseCode(334, Server::AuthenticationFailedError)) {
+                // Send the password in base64
+                qCDebug(SIMPLEMAIL_SERVER) << "Sending authentication password";
+                transcript.append(Transcript::Client, "***", 3);
+                transport->write(password.toUtf8().toBase64() + "\r\n");
+                state = WaitingForAuthLogin235_step3;
             }
-            break;
-        case WaitingForAuthCramMd5_334_step1:
-            if (socket->canReadLine()) {
-                QByteArray responseMessage;
-                if (parseResponseCode(334, Server::AuthenticationFailedError, &responseMessage)) {
-                    // Challenge
-                    QByteArray ch = QByteArray::fromBase64(responseMessage);
-
-                    // Compute the hash
-                    QMessageAuthenticationCode code(QCryptographicHash::Md5);
-                    code.setKey(password.toUtf8());
-                    code.addData(ch);
-
-                    QByteArray data(username.toUtf8() + " " + code.result().toHex());
-                    socket->write(data.toBase64() + "\r\n");
-                    state = WaitingForAuthCramMd5_235_step2;
-                }
+        }
+        break;
+    case WaitingForAuthCramMd5_334_step1:
+        if (transport->canReadLine()) {
+            QByteArray responseMessage;
+            if (parseResponseCode(334, Server::AuthenticationFailedError, &responseMessage)) {
+                // Challenge
+                QByteArray ch = QByteArray::fromBase64(responseMessage);
+
+                // Compute the hash
+                QMessageAuthenticationCode code(QCryptographicHash::Md5);
+                code.setKey(password.toUtf8());
+                code.addData(ch);
+
+                QByteArray data(username.toUtf8() + " " + code.result().toHex());
+                transcript.append(Transcript::Client, "***", 3);
+                transport->write(data.toBase64() + "\r\n");
+                state = WaitingForAuthCramMd5_235_step2;
             }
-            break;
-        case WaitingForServiceReady220:
-            if (socket->canReadLine()) {
-                if (parseResponseCode(220)) {
-                    // The client's first command must be EHLO/HELO
-                    socket->write("EHLO " + hostname.toLatin1() + "\r\n");
-                    state = WaitingForServerCaps250;
-                }
+        }
+        break;
+    case WaitingForServiceReady220:
+        if (transport->canReadLine()) {
+            if (parseResponseCode(220)) {
+                // The client's first command must be EHLO/HELO
+                commandHello();
+                state = WaitingForServerCaps250;
             }
-            break;
-        default:
-            qCDebug(SIMPLEMAIL_SERVER) << "readyRead unknown state" << socket->readAll() << state;
         }
-        qCDebug(SIMPLEMAIL_SERVER) << "readyRead" << socket->bytesAvailable();
-    });
+        break;
+    default:
+        qCDebug(SIMPLEMAIL_SERVER) << "readyRead unknown state" << transport->readAll() << state;
+    }
+    qCDebug(SIMPLEMAIL_SERVER) << "readyRead" << transport->bytesAvailable();
 }
 
 void ServerPrivate::setPeerVerificationType(const Server::PeerVerificationType &type)
 {
     peerVerificationType = type;
 #ifndef QT_NO_SSL
-    if (socket != nullptr) {
-        if (connectionType == Server::SslConnection || connectionType == Server::TlsConnection) {
-            switch (type) {
-            case Server::VerifyNone:
-                static_cast<QSslSocket *>(socket)->setPeerVerifyMode(QSslSocket::VerifyNone);
-                break;
-                //                case Server::VerifyPeer:
-            default:
-                static_cast<QSslSocket *>(socket)->setPeerVerifyMode(QSslSocket::VerifyPeer);
-                break;
-            }
+    auto sslSock = sslSocket();
+    if (sslSock) {
+        switch (type) {
+        case Server::VerifyNone:
+            sslSock->setPeerVerifyMode(QSslSocket::VerifyNone);
+            break;
+            //                case Server::VerifyPeer:
+        default:
+            sslSock->setPeerVerifyMode(QSslSocket::VerifyPeer);
+            break;
         }
     }
 #endif
@@ -493,17 +936,19 @@ void ServerPrivate::login()
         qCDebug(SIMPLEMAIL_SERVER) << "Sending authentication plain" << state;
         // Sending command: AUTH PLAIN base64('\0' + username + '\0' + password)
         const QByteArray plain = '\0' + username.toUtf8() + '\0' + password.toUtf8();
-        socket->write(QByteArrayLiteral("AUTH PLAIN ") + plain.toBase64() + "\r\n");
+        SIMPLEMAIL_TRACE(command, "AUTH PLAIN\r\n", 12); // Without the credentials
+        transcript.append(Transcript::Client, "AUTH PLAIN ***", 14);
+        transport->write(QByteArrayLiteral("AUTH PLAIN ") + plain.toBase64() + "\r\n");
         state = WaitingForAuthPlain235;
     } else if (authMethod == Server::AuthLogin) {
         // Sending command: AUTH LOGIN
         qCDebug(SIMPLEMAIL_SERVER) << "Sending authentication login";
-        socket->write(QByteArrayLiteral("AUTH LOGIN\r\n"));
+        writeCommand(QByteArrayLiteral("AUTH LOGIN\r\n"));
         state = WaitingForAuthLogin334_step1;
     } else if (authMethod == Server::AuthCramMd5) {
         // NOTE Implementando - Ready
         qCDebug(SIMPLEMAIL_SERVER) << "Sending authentication CRAM-MD5";
-        socket->write(QByteArrayLiteral("AUTH CRAM-MD5\r\n"));
+        writeCommand(QByteArrayLiteral("AUTH CRAM-MD5\r\n"));
         state = WaitingForAuthCramMd5_334_step1;
     } else {
         state = ServerPrivate::Ready;
@@ -513,57 +958,146 @@ void ServerPrivate::login()
 
 void ServerPrivate::processNextMail()
 {
+    Q_Q(Server);
+
+    // Emitted before a transaction starts, in case the handlers send more mail
+    updateBackpressure();
+
     while (!queue.isEmpty()) {
-        ServerReplyContainer &cont = queue[0];
+        ServerReplyContainer &cont = queue.head();
         if (cont.reply.isNull()) {
-            queue.removeFirst();
+            queue.removeHead();
             continue;
         }
 
         if (cont.state == ServerReplyContainer::Initial) {
+            if (cont.deadline.hasExpired()) {
+                qCDebug(SIMPLEMAIL_SERVER) << "Dropping expired message";
+                ServerReply *reply = cont.reply;
+                queue.removeHead();
+
+                // Reached from sendMail() too, before the caller could connect
+                finishLater(reply,
+                            ServerReply::DeadlineExpired,
+                            q->tr("Message deadline expired before it was sent"));
+                continue;
+            }
+
+            // Sizing scans the content to pick each part's transfer encoding and count
+            // its quoted-printable output, so it's done once for both the bytes rate
+            // limit and SIZE=, and again only if 8BITMIME changes it
+            const bool eightBitMime = extensions.testFlag(Server::EightBitMime);
+            const auto sizeState    = eightBitMime ? ServerReplyContainer::SizeEightBit
+                                                   : ServerReplyContainer::SizeSevenBit;
+            if (cont.sizeState != sizeState &&
+                (extensions.testFlag(Server::Size) ||
+                 (rateLimiter && rateLimiter->isLimited(RateLimiter::Bytes)))) {
+                queue.setHeadSize(cont.msg.encodedSize(eightBitMime), eightBitMime);
+            }
+
+            if (rateLimiter) {
+                const qint64 recipients = cont.msg.toRecipients().size() +
+                                          cont.msg.ccRecipients().size() +
+                                          cont.msg.bccRecipients().size();
+                const qint64 wait       = rateLimiter->acquire(
+                    cont.msg.sender().address(), recipients, qMax<qint64>(0, cont.size));
+                if (wait > 0) {
+                    // Stays queued, becoming Ready so new mail and keep-alive work meanwhile
+                    qCDebug(SIMPLEMAIL_SERVER) << "Rate limited, waiting" << wait;
+                    rateTimer.start(int(qMin<qint64>(wait, std::numeric_limits<int>::max())));
+                    break;
+                }
+            }
+
+            // The connection phases go to the first message that waited for them
+            ServerReplyPrivate *replyPriv = cont.reply->d_func();
+            const qint64 connectStarted   = connectionTimestamps[ServerReply::ConnectStarted];
+            if (connectStarted && connectStarted >= replyPriv->timestamps[ServerReply::Queued]) {
+                std::copy(std::begin(connectionTimestamps) + ServerReply::ConnectStarted,
+                          std::end(connectionTimestamps),
+                          replyPriv->timestamps + ServerReply::ConnectStarted);
+            }
+            std::fill(std::begin(connectionTimestamps), std::end(connectionTimestamps), 0);
+
             // Send the MAIL command with the sender
-            cont.commands << "MAIL FROM:<" + cont.msg.sender().address().toLatin1() + ">\r\n";
-            cont.awaitedCodes << 250;
+            QByteArray mailFrom = "MAIL FROM:<" + cont.msg.sender().address().toLatin1() + '>';
+            if (extensions.testFlag(Server::Size)) {
+                const qint64 size = cont.size;
+                if (sizeLimit > 0 && size > sizeLimit) {
+                    // Don't stream a message the server already told us it will reject
+                    qCWarning(SIMPLEMAIL_SERVER) << "Message too big" << size << sizeLimit;
+                    ServerReply *reply = cont.reply;
+                    queue.removeHead();
+                    finishLater(
+                        reply, 552, q->tr("Message size exceeds fixed maximum message size"));
+                    continue;
+                }
+
+                if (size >= 0) {
+                    mailFrom += " SIZE=" + QByteArray::number(size);
+                }
+            }
+            if (eightBitMime) {
+                mailFrom += " BODY=8BITMIME";
+            }
+            transaction.clear();
+            transaction.commands << mailFrom + "\r\n";
+            transaction.awaitedCodes << 250;
 
             // Send RCPT command for each recipient
             // To (primary recipients)
             const auto toRecipients = cont.msg.toRecipients();
             for (const EmailAddress &rcpt : toRecipients) {
-                cont.commands << "RCPT TO:<" + rcpt.address().toLatin1() + ">\r\n";
-                cont.awaitedCodes << 250;
+                transaction.commands << "RCPT TO:<" + rcpt.address().toLatin1() + ">\r\n";
+                transaction.awaitedCodes << 250;
             }
 
             // Cc (carbon copy)
             const auto ccRecipients = cont.msg.ccRecipients();
             for (const EmailAddress &rcpt : ccRecipients) {
-                cont.commands << "RCPT TO:<" + rcpt.address().toLatin1() + ">\r\n";
-                cont.awaitedCodes << 250;
+                transaction.commands << "RCPT TO:<" + rcpt.address().toLatin1() + ">\r\n";
+                transaction.awaitedCodes << 250;
             }
 
             // Bcc (blind carbon copy)
             const auto bccRecipients = cont.msg.bccRecipients();
             for (const EmailAddress &rcpt : bccRecipients) {
-                cont.commands << "RCPT TO:<" + rcpt.address().toLatin1() + ">\r\n";
-                cont.awaitedCodes << 250;
+                transaction.commands << "RCPT TO:<" + rcpt.address().toLatin1() + ">\r\n";
+                transaction.awaitedCodes << 250;
+            }
+
+            if (protocol == Server::Lmtp) {
+                for (const auto &rcpts : {toRecipients, ccRecipients, bccRecipients}) {
+                    for (const EmailAddress &rcpt : rcpts) {
+                        transaction.recipients << rcpt.address();
+                    }
+                }
             }
 
             // DATA command
-            cont.commands << QByteArrayLiteral("DATA\r\n");
-            cont.awaitedCodes << 354;
+            transaction.commands << QByteArrayLiteral("DATA\r\n");
+            transaction.awaitedCodes << 354;
 
+            // The commands themselves are traced, they may be thousands
             qCDebug(SIMPLEMAIL_SERVER)
-                << "Sending MAIL command" << capPipelining << cont.commands.size() << cont.commands
-                << cont.awaitedCodes;
-            if (capPipelining) {
-                for (const QByteArray &cmd : std::as_const(cont.commands)) {
-                    socket->write(cmd);
+                << "Sending MAIL command" << extensions << transaction.commands.size();
+            if (extensions.testFlag(Server::Pipelining)) {
+                for (const QByteArray &cmd : std::as_const(transaction.commands)) {
+                    writeCommand(cmd);
                 }
             } else {
-                socket->write(cont.commands.first());
+                writeCommand(transaction.commands.first());
             }
 
+            replyPriv->mark(ServerReply::TransactionStarted);
+            counters.setState(ServerMetrics::Sending);
+            counters.setInFlight(true);
             state      = SendingMail;
             cont.state = ServerReplyContainer::SendingCommands;
+            idleTimer.invalidate();
+
+            // Messages dropped above may have made room
+            updateBackpressure();
             return;
         } else {
             return;
@@ -571,20 +1105,239 @@ void ServerPrivate::processNextMail()
     }
 
     state = Ready;
+    counters.setState(ServerMetrics::Idle);
+    if (!idleTimer.isValid()) {
+        idleTimer.start();
+    }
+    updateBackpressure();
+    quitIfDrained();
+}
+
+void ServerPrivate::trackDrain(ServerReply *reply)
+{
+    Q_Q(Server);
+
+    if (reply) {
+        q->connect(reply, &ServerReply::finished, q, [this, reply] {
+            if (reply->error()) {
+                ++drainAbandoned;
+            } else {
+                ++drainSent;
+            }
+        });
+    }
+}
+
+void ServerPrivate::quitIfDrained()
+{
+    Q_Q(Server);
+
+    if (!shuttingDown || drainFinished || !queue.isEmpty()) {
+        return;
+    }
+
+    switch (state) {
+    case Ready:
+        commandQuit();
+        break;
+    case Disconnected:
+        qCDebug(SIMPLEMAIL_SERVER) << "Drained" << drainSent << drainAbandoned;
+        drainFinished = true;
+        shutdownTimer.stop();
+
+        // shutdown() of an idle server gets here before it returns
+        QTimer::singleShot(0, q, [this, q] { Q_EMIT q->drained(drainSent, drainAbandoned); });
+        break;
+    default:
+        // Comes back here once the connection is ready or gone
+        break;
+    }
+}
+
+void ServerPrivate::abandonQueue()
+{
+    Q_Q(Server);
+
+    qCWarning(SIMPLEMAIL_SERVER) << "Shutdown deadline reached, abandoning" << queue.size();
+    queue.takeAll([this, q](const ServerReplyContainer &cont) {
+        if (!cont.reply.isNull()) {
+            ServerCounters::add(counters.messagesFailed);
+            cont.reply->finish(
+                true, ServerReply::ShuttingDown, q->tr("Server shutdown deadline reached"));
+        }
+    });
+    updateBackpressure();
+
+    if (state == Ready || state == Disconnected) {
+        quitIfDrained();
+    } else {
+        // Either mid transaction or the QUIT reply didn't come
+        transport->close();
+    }
+}
+
+void ServerPrivate::finishLater(ServerReply *reply,
+                                int responseCode,
+                                const QString &responseText)
+{
+    ServerCounters::add(counters.messagesFailed);
+
+    // Callers connect to finished() after getting the reply
+    QTimer::singleShot(0, reply, [reply, responseCode, responseText] {
+        reply->finish(true, responseCode, responseText);
+    });
+}
+
+void ServerQueue::enqueue(ServerReplyContainer &&cont, Server::Priority priority)
+{
+    m_bytes.store(bytes() + qMax<qint64>(0, cont.size), std::memory_order_relaxed);
+    m_size.store(size() + 1, std::memory_order_relaxed);
+    SIMPLEMAIL_TRACE(queue__enqueue, cont.reply.data(), int(priority), size());
+    m_lanes[priority].append(std::move(cont));
+}
+
+ServerReplyContainer &ServerQueue::head()
+{
+    return m_lanes[headLane()].first();
+}
+
+void ServerQueue::setHeadSize(qint64 size, bool eightBitMime)
+{
+    ServerReplyContainer &cont = head();
+    m_bytes.store(bytes() - qMax<qint64>(0, cont.size) + qMax<qint64>(0, size),
+                  std::memory_order_relaxed);
+    cont.size      = size;
+    cont.sizeState = eightBitMime ? ServerReplyContainer::SizeEightBit
+                                  : ServerReplyContainer::SizeSevenBit;
+}
+
+void ServerQueue::removeHead()
+{
+    auto &lane = m_lanes[headLane()];
+    m_bytes.store(bytes() - qMax<qint64>(0, lane.first().size), std::memory_order_relaxed);
+    m_size.store(size() - 1, std::memory_order_relaxed);
+    traceDequeue(lane.first());
+    lane.removeFirst();
+}
+
+void ServerQueue::traceDequeue(const ServerReplyContainer &cont) const
+{
+    SIMPLEMAIL_TRACE(queue__dequeue, cont.reply.data(), size());
+}
+
+int ServerQueue::headLane() const
+{
+    // A started transaction must finish before another lane gets a turn
+    for (int i = 0; i <= Server::BulkPriority; ++i) {
+        if (!m_lanes[i].isEmpty() && m_lanes[i].first().state != ServerReplyContainer::Initial) {
+            return i;
+        }
+    }
+
+    for (int i = 0; i <= Server::BulkPriority; ++i) {
+        if (!m_lanes[i].isEmpty()) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+bool ServerPrivate::isQueueFull(qint64 size) const
+{
+    if (queue.isEmpty()) {
+        return false;
+    }
+    return (maxQueuedMessages > 0 && queue.size() >= maxQueuedMessages) ||
+           (maxQueuedBytes > 0 && queue.bytes() + size > maxQueuedBytes);
+}
+
+void ServerPrivate::updateBackpressure()
+{
+    Q_Q(Server);
+
+    qreal usage = 0;
+    if (maxQueuedMessages > 0) {
+        usage = qreal(queue.size()) / maxQueuedMessages;
+    }
+    if (maxQueuedBytes > 0) {
+        usage = qMax(usage, qreal(queue.bytes()) / maxQueuedBytes);
+    }
+
+    if (!queueIsHigh && usage > 0 && usage >= highWatermark) {
+        qCDebug(SIMPLEMAIL_SERVER) << "Queue high" << queue.size() << queue.bytes();
+        queueIsHigh = true;
+        Q_EMIT q->queueHigh();
+    } else if (queueIsHigh && usage <= lowWatermark) {
+        qCDebug(SIMPLEMAIL_SERVER) << "Queue low" << queue.size() << queue.bytes();
+        queueIsHigh = false;
+        Q_EMIT q->queueLow();
+    }
+
+    // Called whenever the queue shrinks, not only on the watermarks
+    wakeBlockedSenders();
+}
+
+void ServerPrivate::wakeBlockedSenders()
+{
+    // Each blocked sendMail() checks again whether its message fits
+    for (QEventLoop *loop : std::as_const(blockedSenders)) {
+        loop->quit();
+    }
+}
+
+void ServerPrivate::markConnection(ServerReply::Phase phase)
+{
+    connectionTimestamps[phase] = QDeadlineTimer::current().deadlineNSecs();
+}
+
+void ServerPrivate::recordLatency(const ServerReplyPrivate *reply)
+{
+    for (int i = ServerReply::Queued; i < ServerReply::PhaseCount; ++i) {
+        const qint64 nsecs = reply->duration(ServerReply::Phase(i));
+        if (nsecs >= 0) {
+            latency[i].record(nsecs / 1000);
+        }
+    }
+}
+
+void ServerPrivate::keepAlive()
+{
+    Q_Q(Server);
+
+    switch (state) {
+    case Disconnected:
+        // Warm up a connection that was dropped while idle
+        q->connectToServer();
+        break;
+    case Ready:
+        if (maxIdleTime > 0 && idleTimer.isValid() && idleTimer.hasExpired(maxIdleTime)) {
+            qCDebug(SIMPLEMAIL_SERVER) << "Recycling idle connection" << idleTimer.elapsed();
+            recycling = true;
+            commandQuit();
+        } else {
+            commandNoop();
+        }
+        break;
+    default:
+        break;
+    }
 }
 
 bool ServerPrivate::parseResponseCode(int expectedCode,
                                       Server::SmtpError defaultError,
                                       QByteArray *responseMessage)
 {
-    while (socket->canReadLine()) {
+    while (transport->canReadLine()) {
         // Save the server's response
-        const QByteArray responseText = socket->readLine().trimmed();
+        const QByteArray responseText = transport->readLine().trimmed();
         const int responseSize        = responseText.size();
         qCDebug(SIMPLEMAIL_SERVER) << "Got response" << responseText << "expected" << expectedCode;
 
         // Extract the respose code from the server's responce (first 3 digits)
         const int responseCode = responseText.left(3).toInt();
+        counters.countReply(responseCode);
+        SIMPLEMAIL_TRACE(reply, responseCode, responseText.constData(), responseText.size());
+        transcript.append(Transcript::Server, responseText);
 
         if (responseCode / 100 == 4) {
             failConnection(Server::ServerError, responseCode, QString::fromLatin1(responseText));
@@ -634,11 +1387,14 @@ int ServerPrivate::parseResponseCode(QByteArray *responseMessage)
     Q_Q(Server);
 
     // Save the server's response
-    const QByteArray responseText = socket->readLine().trimmed();
+    const QByteArray responseText = transport->readLine().trimmed();
     qCDebug(SIMPLEMAIL_SERVER) << "Got response" << responseText;
 
     // Extract the respose code from the server's responce (first 3 digits)
     const int responseCode = responseText.left(3).toInt();
+    counters.countReply(responseCode);
+    SIMPLEMAIL_TRACE(reply, responseCode, responseText.constData(), responseText.size());
+    transcript.append(Transcript::Server, responseText);
 
     if (responseCode / 100 == 4) {
         Q_EMIT q->smtpError(Server::ServerError, QString::fromLatin1(responseText));
@@ -660,14 +1416,21 @@ int ServerPrivate::parseCaps()
     Q_Q(Server);
 
     // Save the server's response
-    const QByteArray responseText = socket->readLine().trimmed();
+    const QByteArray responseText = transport->readLine().trimmed();
     qCDebug(SIMPLEMAIL_SERVER) << "Got response" << responseText;
 
     // Extract the respose code from the server's responce (first 3 digits)
     int responseCode = responseText.left(3).toInt();
+    counters.countReply(responseCode);
+    SIMPLEMAIL_TRACE(reply, responseCode, responseText.constData(), responseText.size());
+    transcript.append(Transcript::Server, responseText);
     if (responseCode == 250) {
-        caps.append(QString::fromLatin1(responseText));
-        if (responseText[3] == ' ') {
+        // The first line only greets with the server's domain
+        if (capsLines++ > 0) {
+            parseExtension(responseText.mid(4));
+        }
+
+        if (responseText.size() <= 3 || responseText[3] == ' ') {
             return 1;
         } else {
             return 0;
@@ -680,11 +1443,79 @@ int ServerPrivate::parseCaps()
     }
 }
 
+void ServerPrivate::parseExtension(const QByteArray &line)
+{
+    const QList<QByteArray> params = line.toUpper().split(' ');
+    const QByteArray &keyword      = params.first();
+
+    if (keyword == "PIPELINING") {
+        extensions |= Server::Pipelining;
+    } else if (keyword == "SIZE") {
+        extensions |= Server::Size;
+        sizeLimit = params.value(1).toLongLong();
+    } else if (keyword == "8BITMIME") {
+        extensions |= Server::EightBitMime;
+    } else if (keyword == "CHUNKING") {
+        extensions |= Server::Chunking;
+    } else if (keyword == "BINARYMIME") {
+        extensions |= Server::BinaryMime;
+    } else if (keyword == "SMTPUTF8") {
+        extensions |= Server::SmtpUtf8;
+    } else if (keyword == "ENHANCEDSTATUSCODES") {
+        extensions |= Server::EnhancedStatusCodes;
+    } else if (keyword == "STARTTLS") {
+        extensions |= Server::StartTls;
+    } else if (keyword == "DSN") {
+        extensions |= Server::Dsn;
+    } else if (keyword == "AUTH" || keyword.startsWith("AUTH=")) {
+        // Old servers announce AUTH=MECHANISM
+        extensions |= Server::Auth;
+        QList<QByteArray> mechanisms = params.mid(1);
+        if (keyword.size() > 5) {
+            mechanisms.prepend(keyword.mid(5));
+        }
+
+        for (const QByteArray &mechanism : std::as_const(mechanisms)) {
+            const QString name = QString::fromLatin1(mechanism);
+            if (!name.isEmpty() && !authMechanisms.contains(name)) {
+                authMechanisms.append(name);
+            }
+        }
+    }
+}
+
+void ServerPrivate::commandHello()
+{
+    // A new EHLO reply replaces what was announced before, e.g. after STARTTLS
+    extensions = Server::NoExtensions;
+    sizeLimit  = 0;
+    capsLines  = 0;
+    authMechanisms.clear();
+
+    if (protocol == Server::Lmtp) {
+        writeCommand("LHLO " + hostname.toLatin1() + "\r\n");
+    } else {
+        writeCommand("EHLO " + hostname.toLatin1() + "\r\n");
+    }
+}
+
+void ServerPrivate::writeCommand(const QByteArray &command)
+{
+    SIMPLEMAIL_TRACE(command, command.constData(), command.size());
+    transcript.append(Transcript::Client, command);
+    transport->write(command);
+}
+
+void ServerPrivate::attachTranscript(ServerReply *reply)
+{
+    reply->d_func()->transcript = transcript.lines();
+}
+
 void ServerPrivate::commandReset()
 {
     if (state == Ready) {
         qCDebug(SIMPLEMAIL_SERVER) << "Sending RESET";
-        socket->write("RSET\r\n", 6);
+        writeCommand(QByteArrayLiteral("RSET\r\n"));
         state = Reset_250;
     }
 }
@@ -693,14 +1524,17 @@ void ServerPrivate::commandNoop()
 {
     if (state == Ready) {
         qCDebug(SIMPLEMAIL_SERVER) << "Sending NOOP";
-        socket->write("NOOP\r\n", 6);
+        writeCommand(QByteArrayLiteral("NOOP\r\n"));
         state = Noop_250;
     }
 }
 
 void ServerPrivate::commandQuit()
 {
-    socket->write("QUIT\r\n", 6);
+    qCDebug(SIMPLEMAIL_SERVER) << "Sending QUIT";
+    writeCommand(QByteArrayLiteral("QUIT\r\n"));
+    counters.setState(ServerMetrics::Closing);
+    state = Quit_221;
 }
 
 void ServerPrivate::failConnection(Server::SmtpError defaultError,
@@ -711,13 +1545,17 @@ void ServerPrivate::failConnection(Server::SmtpError defaultError,
 
     qCDebug(SIMPLEMAIL_SERVER) << "failConnection" << defaultError << responseCode << error;
     // Call this when the connection should be closed due an error
-    for (auto &mail : queue) {
-        ServerReply *reply = mail.reply;
-        reply->finish(true, responseCode, error);
-    }
-    queue.clear();
+    const QStringList lines = transcript.lines();
+    queue.takeAll([this, &lines, responseCode, &error](const ServerReplyContainer &mail) {
+        if (!mail.reply.isNull()) {
+            ServerCounters::add(counters.messagesFailed);
+            mail.reply->d_func()->transcript = lines;
+            mail.reply->finish(true, responseCode, error);
+        }
+    });
+    updateBackpressure();
 
-    socket->close();
+    transport->close();
 
     Q_EMIT q->smtpError(defaultError, error);
 }
@@ -15,20 +15,31 @@
 */
 #pragma once
 
+#include "latencyhistogram.h"
+#include "metrics.h"
+#include "serverreply.h"
 #include "smtpexports.h"
 
+#include <memory>
+
+#include <QDeadlineTimer>
+#include <QHostAddress>
 #include <QObject>
+#include <QStringList>
 #include <QtNetwork/qtnetwork-config.h>
 
 #ifndef QT_NO_SSL
+class QSslConfiguration;
 class QSslError;
 #endif
 
 namespace SimpleMail {
 
 class MimeMessage;
+class RateLimiter;
 class ServerReply;
 class ServerPrivate;
+class Transport;
 class SMTP_EXPORT Server : public QObject
 {
     Q_OBJECT
@@ -58,9 +69,44 @@ public:
         SslConnection,
         TlsConnection, // STARTTLS
 #endif
+        LocalSocketConnection, // host() is the local socket name or path
     };
     Q_ENUM(ConnectionType)
 
+    enum Protocol {
+        Smtp,
+        Lmtp, // RFC 2033, LHLO and one final reply per recipient
+    };
+    Q_ENUM(Protocol)
+
+    enum Extension {
+        NoExtensions        = 0x0000,
+        Pipelining          = 0x0001, // RFC 2920
+        Size                = 0x0002, // RFC 1870, see sizeLimit()
+        EightBitMime        = 0x0004, // RFC 6152
+        Chunking            = 0x0008, // RFC 3030, BDAT
+        BinaryMime          = 0x0010, // RFC 3030
+        SmtpUtf8            = 0x0020, // RFC 6531
+        EnhancedStatusCodes = 0x0040, // RFC 2034
+        StartTls            = 0x0080, // RFC 3207
+        Auth                = 0x0100, // RFC 4954, see authMechanisms()
+        Dsn                 = 0x0200, // RFC 3461
+    };
+    Q_DECLARE_FLAGS(Extensions, Extension)
+    Q_FLAG(Extensions)
+
+    enum Priority {
+        TransactionalPriority, // Sent before any queued bulk message
+        BulkPriority,
+    };
+    Q_ENUM(Priority)
+
+    enum QueuePolicy {
+        RejectWhenFull, // sendMail() returns a failed reply
+        BlockWhenFull,  // sendMail() runs a local event loop until there is room
+    };
+    Q_ENUM(QueuePolicy)
+
     enum PeerVerificationType {
         VerifyNone,
         VerifyPeer,
@@ -71,7 +117,8 @@ public:
     virtual ~Server();
 
     /**
-     * Returns the hostname of the SMTP server
+     * Returns the hostname of the SMTP server, or the socket name
+     * when using a LocalSocketConnection
      */
     QString host() const;
 
@@ -101,6 +148,20 @@ public:
      */
     void setHostname(const QString &hostname);
 
+    /**
+     * Returns the nameserver used to resolve host()
+     */
+    QHostAddress nameserver() const;
+
+    /**
+     * Defines the nameserver used to resolve host(), e.g. a local stub in tests.
+     * The port is only honoured with Qt 6.6 or later. Answers are cached for
+     * their TTL and shared by every Server, when a host has IPv6 and IPv4
+     * addresses the connection attempts are raced (RFC 8305).
+     * Defaults to a null address, the system's resolver
+     */
+    void setNameserver(const QHostAddress &address, quint16 port = 53);
+
     /**
      * Returns the connection type of the SMTP server
      */
@@ -111,6 +172,22 @@ public:
      */
     void setConnectionType(ConnectionType ct);
 
+#ifndef QT_NO_SSL
+    /**
+     * Returns the TLS configuration used by SslConnection and TlsConnection
+     */
+    QSslConfiguration sslConfiguration() const;
+
+    /**
+     * Defines the TLS configuration used by SslConnection and TlsConnection.
+     *
+     * Defaults to a configuration shared by every Server, with the system CA
+     * certificates parsed once, when first needed. Sessions are cached per host and port
+     * across all instances and resumed on reconnects, avoiding full handshakes.
+     */
+    void setSslConfiguration(const QSslConfiguration &configuration);
+#endif
+
     /**
      * Returns the username that will authenticate on the SMTP server
      */
@@ -141,6 +218,103 @@ public:
      */
     void setAuthMethod(AuthMethod method);
 
+    /**
+     * Returns the number of commands and replies kept for failed transactions
+     */
+    int transcriptLines() const;
+
+    /**
+     * Defines how many of the last commands and replies of the connection are
+     * kept, without message bodies or credentials. They are only copied to a
+     * ServerReply when its transaction fails, see ServerReply::transcript().
+     * Defaults to 32, 0 disables it
+     */
+    void setTranscriptLines(int lines);
+
+    /**
+     * Returns the interval in milliseconds between NOOPs sent on an idle connection
+     */
+    int keepAliveInterval() const;
+
+    /**
+     * Keeps the connection authenticated and ready for the next message by
+     * sending a NOOP every msec milliseconds while it is idle, a disconnected
+     * server connects again on the next interval. Combined with connectToServer()
+     * this moves the connection latency ahead of traffic.
+     * Defaults to 0, disabled
+     */
+    void setKeepAliveInterval(int msec);
+
+    /**
+     * Returns the time in milliseconds a connection may stay idle before it is recycled
+     */
+    int maxIdleTime() const;
+
+    /**
+     * Closes the connection with QUIT once it has been idle for msec milliseconds,
+     * when keep-alive is enabled a fresh one is opened right away. This should be
+     * smaller than the server's own idle timeout. It's checked on every keep-alive
+     * interval. Defaults to 0, disabled
+     */
+    void setMaxIdleTime(int msec);
+
+    /**
+     * Returns the protocol spoken with the server
+     */
+    Protocol protocol() const;
+
+    /**
+     * Defines the protocol spoken with the server, LMTP is usually
+     * used with a LocalSocketConnection to reach a local delivery agent.
+     * Defaults to SMTP
+     */
+    void setProtocol(Protocol protocol);
+
+    /**
+     * Returns the extensions the server announced on its last EHLO reply,
+     * empty until connected
+     */
+    Extensions extensions() const;
+
+    /**
+     * Returns the maximum message size announced with the SIZE extension,
+     * zero if there is none or it's unlimited
+     */
+    qint64 sizeLimit() const;
+
+    /**
+     * Returns the authentication mechanisms announced with the AUTH extension
+     */
+    QStringList authMechanisms() const;
+
+    /**
+     * Returns the transport the protocol is spoken over, it's only
+     * available once connecting started or after setTransport()
+     */
+    Transport *transport() const;
+
+    /**
+     * Defines a custom transport to be used instead of the socket
+     * created from connectionType(), Server takes ownership of it.
+     * host() and port() are still passed to Transport::connectToHost()
+     */
+    void setTransport(Transport *transport);
+
+    /**
+     * Returns true if TCP connections should use io_uring
+     */
+    bool ioUringEnabled() const;
+
+    /**
+     * Makes TcpConnection use a Linux io_uring based transport, which batches
+     * the socket operations of all connections on a thread into a single
+     * syscall per event loop iteration, useful when driving thousands of
+     * connections. The Qt sockets are used if the library was built without
+     * ENABLE_IO_URING or if io_uring is unavailable at runtime.
+     * Defaults to false
+     */
+    void setIoUringEnabled(bool enabled);
+
     /**
      * Sends the email async.
      * The email is added to a queue and is processed once
@@ -154,6 +328,21 @@ public:
      */
     ServerReply *sendMail(const MimeMessage &msg);
 
+    /**
+     * Sends the email async with a priority and a deadline, see sendMail().
+     *
+     * Each priority has its own queue, a transactional message is sent as
+     * soon as the transaction in progress is done, regardless of how many
+     * bulk messages are waiting.
+     *
+     * A message whose deadline expires while it is queued is dropped and the
+     * reply fails with ServerReply::DeadlineExpired, useful for one-time codes
+     * that are worthless after a while.
+     */
+    ServerReply *sendMail(const MimeMessage &msg,
+                          Priority priority,
+                          QDeadlineTimer deadline = QDeadlineTimer(QDeadlineTimer::Forever));
+
     /**
      * Returns the number of emails in queue
      * Can be useful if you create multiple Server instances and
@@ -161,13 +350,108 @@ public:
      */
     int queueSize() const;
 
+    /**
+     * Returns the sum of the encoded sizes of the queued messages. A message
+     * is sized when queued if a bytes limit is set, otherwise once it starts
+     * its transaction if the server advertised SIZE or a bytes rate limit is set
+     */
+    qint64 queuedBytes() const;
+
+    /**
+     * Returns the maximum number of queued messages
+     */
+    int maxQueuedMessages() const;
+
+    /**
+     * Defines the maximum number of queued messages, once reached new ones
+     * are handled according to the queuePolicy(). Defaults to 0, unlimited
+     */
+    void setMaxQueuedMessages(int max);
+
+    /**
+     * Returns the maximum number of queued bytes
+     */
+    qint64 maxQueuedBytes() const;
+
+    /**
+     * Defines the maximum sum of the encoded sizes of the queued messages, once
+     * reached new ones are handled according to the queuePolicy(). A message
+     * is always accepted into an empty queue. Defaults to 0, unlimited
+     */
+    void setMaxQueuedBytes(qint64 max);
+
+    /**
+     * Returns the rate limiter consulted before each transaction
+     */
+    std::shared_ptr<RateLimiter> rateLimiter() const;
+
+    /**
+     * Defines the rate limiter consulted before each transaction, when it
+     * has no tokens left the next message waits on the queue until it does.
+     * The same limiter can be shared by several servers
+     */
+    void setRateLimiter(const std::shared_ptr<RateLimiter> &limiter);
+
+    /**
+     * Returns what happens to messages sent while the queue is full
+     */
+    QueuePolicy queuePolicy() const;
+
+    /**
+     * Defines what happens to messages sent while the queue is full.
+     * Defaults to RejectWhenFull
+     */
+    void setQueuePolicy(QueuePolicy policy);
+
+    /**
+     * Defines the queue usage, relative to the limits, at which queueHigh() and
+     * queueLow() are emitted, a blocked sendMail() doesn't wait for them and
+     * returns as soon as its message fits. Defaults to 0.5 and 0.9
+     */
+    void setQueueWatermarks(qreal low, qreal high);
+
     /**
      * Connects to the SMTP server.
      * This is called automatically when an email is sent, and usually SMTP servers
-     * timeout the connection after a while.
+     * timeout the connection after a while, see setKeepAliveInterval().
+     * Does nothing if the server is already connected or connecting.
      */
     void connectToServer();
 
+    /**
+     * Same as shutdown() without a deadline, every queued message is sent
+     * before the session is ended.
+     */
+    void drain();
+
+    /**
+     * Gracefully ends the session: new messages are refused from now on,
+     * queued ones are sent until the deadline expires, then QUIT is sent.
+     * Messages still queued at the deadline fail and an in-flight transaction
+     * is aborted. The drained() signal is emitted from the event loop once
+     * disconnected, even when there was nothing to send.
+     */
+    void shutdown(QDeadlineTimer deadline);
+
+    /**
+     * Returns true once shutdown() or drain() was called
+     */
+    bool isShuttingDown() const;
+
+    /**
+     * Returns a snapshot of the time it took the messages that got a reply to
+     * their DATA to reach phase, see ServerReply::duration(). Queued has the
+     * whole transactions. Recording is lock-free so this can be called from
+     * any thread
+     */
+    LatencyHistogram latencyHistogram(ServerReply::Phase phase) const;
+
+    /**
+     * Returns a snapshot of the counters of this server, it's cheap and can
+     * be called from any thread. See OpenMetrics::render() for scraping
+     */
+    ServerMetrics metrics() const;
+
 #ifndef QT_NO_SSL
     /**
      * @brief ignoreSslErrors tells the socket to ignore all pending ssl errors if SSL encryption is
@@ -185,6 +469,23 @@ public:
 
 Q_SIGNALS:
     void smtpError(SmtpError e, const QString &description);
+
+    /**
+     * Emitted when a shutdown completes with the number of messages queued
+     * at that time that were sent, and of those that failed or were abandoned
+     */
+    void drained(int sent, int abandoned);
+
+    /**
+     * Emitted when the queue usage reaches the high watermark, producers
+     * should pause until queueLow() is emitted
+     */
+    void queueHigh();
+
+    /**
+     * Emitted when the queue usage drops to the low watermark after queueHigh()
+     */
+    void queueLow();
 #ifndef QT_NO_SSL
     void sslErrors(const QList<QSslError> &sslErrorList);
 #endif
@@ -193,4 +494,6 @@ private:
     ServerPrivate *d_ptr;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(Server::Extensions)
+
 } // namespace SimpleMail
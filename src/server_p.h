@@ -16,15 +16,32 @@
 #ifndef SERVER_P_H
 #define SERVER_P_H
 
+#include "latencyhistogram_p.h"
+#include "metrics_p.h"
 #include "mimemessage.h"
+#include "ringbuffer_p.h"
 #include "server.h"
+#include "serverreply.h"
+#include "transcript_p.h"
 
+#include <optional>
+
+#include <QElapsedTimer>
+#include <QEventLoop>
 #include <QPointer>
+#include <QTimer>
+
+#ifndef QT_NO_SSL
+#include <QSslConfiguration>
 
-class QTcpSocket;
+class QSslSocket;
+#endif
 
 namespace SimpleMail {
 
+class ServerReplyPrivate;
+class Transport;
+
 class ServerReply;
 class ServerReplyContainer
 {
@@ -35,6 +52,13 @@ public:
         SendingData,
     };
 
+    // The 8BITMIME flag size was computed with
+    enum SizeState : quint8 {
+        SizeUnknown,
+        SizeSevenBit,
+        SizeEightBit,
+    };
+
     ServerReplyContainer(const MimeMessage &email)
         : msg(email)
     {
@@ -42,9 +66,91 @@ public:
 
     MimeMessage msg;
     QPointer<ServerReply> reply;
+    QDeadlineTimer deadline = QDeadlineTimer(QDeadlineTimer::Forever);
+    qint64 size             = 0; // -1 if it can't be known in advance
+    State state             = Initial;
+    SizeState sizeState     = SizeUnknown;
+};
+
+/**
+ * Commands and replies of the transaction in progress, only the head of
+ * the queue has one so queued messages don't carry these lists
+ */
+class ServerTransaction
+{
+public:
+    inline void clear()
+    {
+        commands.clear();
+        awaitedCodes.clear();
+        recipients.clear();
+        recipientResponses.clear();
+    }
+
     QByteArrayList commands;
     QList<int> awaitedCodes;
-    State state = Initial;
+    QStringList recipients;
+    QList<ServerReply::RecipientResponse> recipientResponses;
+};
+
+/**
+ * One FIFO lane per Server::Priority, the head is the transaction in
+ * progress or else the first message of the most urgent lane
+ */
+class ServerQueue
+{
+public:
+    inline bool isEmpty() const { return size() == 0; }
+    inline int size() const { return m_size.load(std::memory_order_relaxed); }
+    inline qint64 bytes() const { return m_bytes.load(std::memory_order_relaxed); }
+
+    void enqueue(ServerReplyContainer &&cont, Server::Priority priority);
+    ServerReplyContainer &head();
+    void setHeadSize(qint64 size, bool eightBitMime);
+    void removeHead();
+
+    /**
+     * Removes every queued message calling func with it, the ones func
+     * queues are kept
+     */
+    template <typename Func>
+    void takeAll(Func func)
+    {
+        qsizetype counts[Server::BulkPriority + 1];
+        for (int i = 0; i <= Server::BulkPriority; ++i) {
+            counts[i] = m_lanes[i].size();
+        }
+
+        for (int i = 0; i <= Server::BulkPriority; ++i) {
+            for (qsizetype j = 0; j < counts[i]; ++j) {
+                ServerReplyContainer cont = m_lanes[i].takeFirst();
+                m_bytes.store(bytes() - qMax<qint64>(0, cont.size), std::memory_order_relaxed);
+                m_size.store(size() - 1, std::memory_order_relaxed);
+                traceDequeue(cont);
+                func(cont);
+            }
+        }
+    }
+
+    template <typename Func>
+    void forEach(Func func) const
+    {
+        for (const auto &lane : m_lanes) {
+            for (qsizetype i = 0; i < lane.size(); ++i) {
+                func(lane[i]);
+            }
+        }
+    }
+
+private:
+    int headLane() const;
+    void traceDequeue(const ServerReplyContainer &cont) const;
+
+    RingBuffer<ServerReplyContainer> m_lanes[Server::BulkPriority + 1];
+
+    // Read by Server::metrics() from other threads
+    std::atomic<qint64> m_bytes{0};
+    std::atomic<int> m_size{0};
 };
 
 class ServerPrivate
@@ -53,7 +159,6 @@ class ServerPrivate
 public:
     enum State {
         Disconnected,
-        Closing,
         Connecting,
         WaitingForServiceReady220,
         WaitingForServerCaps250,
@@ -67,6 +172,7 @@ public:
         Ready,
         Noop_250,
         Reset_250,
+        Quit_221,
         SendingMail,
     };
 
@@ -74,35 +180,93 @@ public:
         : q_ptr(srv)
     {
     }
-    inline void createSocket();
+    inline void createTransport();
+    void connectTransport();
+    void transportConnected();
+    void transportDisconnected();
+    void transportError();
+    void transportReadyRead();
+#ifndef QT_NO_SSL
+    QSslSocket *sslSocket() const;
+    QSslConfiguration tlsConfiguration() const;
+    static QSslConfiguration sharedSslConfiguration();
+#endif
     void setPeerVerificationType(const Server::PeerVerificationType &type);
     void login();
     void processNextMail();
+    void keepAlive();
+    void trackDrain(ServerReply *reply);
+    void quitIfDrained();
+    void abandonQueue();
+    void finishLater(ServerReply *reply, int responseCode, const QString &responseText);
+    bool isQueueFull(qint64 size) const;
+    void updateBackpressure();
+    void wakeBlockedSenders();
+    void markConnection(ServerReply::Phase phase);
+    void recordLatency(const ServerReplyPrivate *reply);
 
     bool parseResponseCode(int expectedCode,
                            Server::SmtpError defaultError = Server::ServerError,
                            QByteArray *responseMessage    = nullptr);
     int parseResponseCode(QByteArray *responseMessage = nullptr);
     int parseCaps();
+    void parseExtension(const QByteArray &line);
+    void writeCommand(const QByteArray &command);
+    void attachTranscript(ServerReply *reply);
+    inline void commandHello();
     inline void commandReset();
     inline void commandNoop();
     inline void commandQuit();
     void failConnection(Server::SmtpError defaultError, int responseCode, const QString &error);
 
-    QList<ServerReplyContainer> queue;
+    ServerQueue queue;
+    ServerTransaction transaction;
+    ServerCounters counters;
+    Transcript transcript;
+    LatencyRecorder latency[ServerReply::PhaseCount];
+    qint64 connectionTimestamps[ServerReply::TransactionStarted] = {};
+    QTimer keepAliveTimer;
+    QTimer shutdownTimer;
+    QTimer rateTimer;
+    QElapsedTimer idleTimer;
     Server *q_ptr;
-    QTcpSocket *socket = nullptr;
-    QStringList caps;
+    Transport *transport = nullptr;
+    QStringList authMechanisms;
+    QList<QEventLoop *> blockedSenders;
+    QHostAddress nameserver;
+    std::shared_ptr<RateLimiter> rateLimiter;
+#ifndef QT_NO_SSL
+    // Unset until setSslConfiguration(), see tlsConfiguration()
+    std::optional<QSslConfiguration> sslConfiguration;
+#endif
     QString host = QStringLiteral("localhost");
     QString hostname;
     QString username;
     QString password;
+    qint64 sizeLimit                                  = 0;
+    qint64 maxQueuedBytes                             = 0;
+    qreal lowWatermark                                = 0.5;
+    qreal highWatermark                               = 0.9;
+    int maxQueuedMessages                             = 0;
+    int capsLines                                     = 0;
+    int maxIdleTime                                   = 0;
+    int drainSent                                     = 0;
+    int drainAbandoned                                = 0;
     quint16 port                                      = 25;
+    quint16 nameserverPort                            = 53;
     Server::ConnectionType connectionType             = Server::TcpConnection;
     Server::AuthMethod authMethod                     = Server::AuthNone;
+    Server::Protocol protocol                         = Server::Smtp;
     Server::PeerVerificationType peerVerificationType = Server::VerifyPeer;
+    Server::QueuePolicy queuePolicy                   = Server::RejectWhenFull;
+    Server::Extensions extensions                     = Server::NoExtensions;
     State state                                       = Disconnected;
-    bool capPipelining                                = false;
+    bool customTransport                              = false;
+    bool ioUring                                      = false;
+    bool recycling                                    = false;
+    bool shuttingDown                                 = false;
+    bool drainFinished                                = false;
+    bool queueIsHigh                                  = false;
 };
 
 } // namespace SimpleMail
@@ -16,6 +16,7 @@
 #include "serverreply.h"
 
 #include "serverreply_p.h"
+#include "tracing_p.h"
 
 using namespace SimpleMail;
 
@@ -23,6 +24,7 @@ ServerReply::ServerReply(QObject *parent)
     : QObject(parent)
     , d_ptr(new ServerReplyPrivate)
 {
+    d_ptr->mark(Queued);
 }
 
 ServerReply::~ServerReply()
@@ -48,13 +50,62 @@ QString ServerReply::responseText() const
     return d->responseText;
 }
 
+QList<ServerReply::RecipientResponse> ServerReply::recipientResponses() const
+{
+    Q_D(const ServerReply);
+    return d->recipientResponses;
+}
+
+QStringList ServerReply::transcript() const
+{
+    Q_D(const ServerReply);
+    return d->transcript;
+}
+
+qint64 ServerReply::timestamp(Phase phase) const
+{
+    Q_D(const ServerReply);
+    return d->timestamps[phase];
+}
+
+qint64 ServerReply::duration(Phase phase) const
+{
+    Q_D(const ServerReply);
+    return d->duration(phase);
+}
+
 void ServerReply::finish(bool error, int responseCode, const QString &responseText)
 {
     Q_D(ServerReply);
     d->error        = error;
     d->responseCode = responseCode;
     d->responseText = responseText;
+    if (error) {
+        SIMPLEMAIL_TRACE(reply__failed, this, responseCode, responseText.toUtf8().constData());
+    }
+    if (!d->timestamps[Finished]) {
+        d->mark(Finished);
+    }
     Q_EMIT finished();
 }
 
+qint64 ServerReplyPrivate::duration(ServerReply::Phase phase) const
+{
+    if (!timestamps[phase]) {
+        return -1;
+    }
+
+    if (phase == ServerReply::Queued) {
+        const qint64 finished = timestamps[ServerReply::Finished];
+        return finished ? finished - timestamps[phase] : -1;
+    }
+
+    for (int i = phase - 1; i >= ServerReply::Queued; --i) {
+        if (timestamps[i]) {
+            return timestamps[phase] - timestamps[i];
+        }
+    }
+    return -1;
+}
+
 #include "moc_serverreply.cpp"
@@ -17,7 +17,9 @@
 
 #include "smtpexports.h"
 
+#include <QList>
 #include <QObject>
+#include <QStringList>
 
 namespace SimpleMail {
 
@@ -27,6 +29,43 @@ class SMTP_EXPORT ServerReply : public QObject
     Q_OBJECT
     Q_DECLARE_PRIVATE(ServerReply)
 public:
+    /**
+     * Response codes of failures that didn't come from the server,
+     * negative so they never clash with SMTP reply codes
+     */
+    enum LocalResponseCode {
+        TransportError  = -1, // The connection failed or data couldn't be written
+        DeadlineExpired = -2, // The message was still queued when its deadline expired
+        ShuttingDown    = -3, // Refused or abandoned by Server::shutdown()
+        QueueFull       = -4, // Refused by Server::RejectWhenFull
+        DnsError        = -5, // The mail exchangers of a domain couldn't be resolved
+    };
+    Q_ENUM(LocalResponseCode)
+
+    /**
+     * Points in the life of a transaction, see timestamp()
+     */
+    enum Phase {
+        Queued,             // sendMail() was called
+        ConnectStarted,     // The connection phases are set on the first message
+        Connected,          // sent on a connection that was opened for it
+        Encrypted,          // TLS handshake done
+        HelloDone,          // Last EHLO reply received, after STARTTLS if any
+        Authenticated,      // AUTH accepted
+        TransactionStarted, // MAIL FROM sent
+        RecipientsAccepted, // MAIL, RCPT and DATA accepted
+        DataWritten,        // Message encoded and written to the transport
+        Finished,           // Final reply received
+    };
+    Q_ENUM(Phase)
+    static constexpr int PhaseCount = Finished + 1;
+
+    struct RecipientResponse {
+        QString address;
+        QString text;
+        int code = 0;
+    };
+
     explicit ServerReply(QObject *parent = nullptr);
     virtual ~ServerReply();
 
@@ -35,6 +74,31 @@ public:
     int responseCode() const;
     QString responseText() const;
 
+    /**
+     * Returns the final reply of each recipient, in the order they were sent.
+     * Only LMTP servers reply per recipient, for SMTP this list is empty
+     */
+    QList<RecipientResponse> recipientResponses() const;
+
+    /**
+     * Returns the last commands and replies of the connection, as "C: command"
+     * and "S: reply", when the transaction failed. See Server::setTranscriptLines()
+     */
+    QStringList transcript() const;
+
+    /**
+     * Returns the monotonic time in nanoseconds at which phase was reached,
+     * comparable to QDeadlineTimer::current().deadlineNSecs(), or 0 if it wasn't
+     */
+    qint64 timestamp(Phase phase) const;
+
+    /**
+     * Returns the nanoseconds it took to reach phase from the previous phase
+     * that was reached, or -1 if it wasn't. For Queued it's the time from
+     * sendMail() to the final reply
+     */
+    qint64 duration(Phase phase) const;
+
 Q_SIGNALS:
     void finished();
 
@@ -43,6 +107,8 @@ protected:
 
 private:
     friend class ServerPrivate;
+    friend class RelayGroupPrivate;
+    friend class DirectDeliveryPrivate;
 
     ServerReplyPrivate *d_ptr;
 };
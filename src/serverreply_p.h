@@ -1,6 +1,9 @@
 #ifndef SERVERREPLY_P_H
 #define SERVERREPLY_P_H
 
+#include "serverreply.h"
+
+#include <QDeadlineTimer>
 #include <QString>
 
 namespace SimpleMail {
@@ -8,7 +11,16 @@ namespace SimpleMail {
 class ServerReplyPrivate
 {
 public:
+    inline void mark(ServerReply::Phase phase)
+    {
+        timestamps[phase] = QDeadlineTimer::current().deadlineNSecs();
+    }
+    qint64 duration(ServerReply::Phase phase) const;
+
+    QList<ServerReply::RecipientResponse> recipientResponses;
+    QStringList transcript;
     QString responseText;
+    qint64 timestamps[ServerReply::PhaseCount] = {};
     int responseCode = 0;
     bool error       = false;
 };
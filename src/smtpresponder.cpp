@@ -0,0 +1,239 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "smtpresponder_p.h"
+
+using namespace SimpleMail;
+
+SmtpResponder::SmtpResponder()
+    : d_ptr(new SmtpResponderPrivate)
+{
+}
+
+SmtpResponder::~SmtpResponder()
+{
+    delete d_ptr;
+}
+
+void SmtpResponder::setGreeting(const QByteArray &greeting)
+{
+    Q_D(SmtpResponder);
+    d->greeting = greeting;
+}
+
+QByteArray SmtpResponder::greeting() const
+{
+    Q_D(const SmtpResponder);
+    return d->greeting;
+}
+
+void SmtpResponder::setHostname(const QByteArray &hostname)
+{
+    Q_D(SmtpResponder);
+    d->hostname = hostname;
+}
+
+QByteArray SmtpResponder::hostname() const
+{
+    Q_D(const SmtpResponder);
+    return d->hostname;
+}
+
+void SmtpResponder::setExtensions(const QByteArrayList &extensions)
+{
+    Q_D(SmtpResponder);
+    d->extensions = extensions;
+}
+
+QByteArrayList SmtpResponder::extensions() const
+{
+    Q_D(const SmtpResponder);
+    return d->extensions;
+}
+
+void SmtpResponder::setReply(const QByteArray &command, const QByteArray &reply)
+{
+    Q_D(SmtpResponder);
+    if (reply.isEmpty()) {
+        d->replies.remove(command.toUpper());
+    } else {
+        d->replies.insert(command.toUpper(), reply);
+    }
+}
+
+void SmtpResponder::setDataReply(const QByteArray &reply)
+{
+    Q_D(SmtpResponder);
+    d->dataReply = reply;
+}
+
+QByteArray SmtpResponder::startSession()
+{
+    Q_D(SmtpResponder);
+    d->buffer.clear();
+    d->scanFrom         = 0;
+    d->recipients       = 0;
+    d->pendingAuthLines = 0;
+    d->state            = SmtpResponderPrivate::Command;
+    d->lmtp             = false;
+    d->quit             = false;
+
+    return d->greeting + "\r\n";
+}
+
+QByteArray SmtpResponder::process(const char *data, qint64 size)
+{
+    Q_D(SmtpResponder);
+
+    d->bytes += quint64(size);
+    d->buffer.append(data, int(size));
+
+    QByteArray replies;
+    qsizetype pos = 0;
+    while (pos < d->buffer.size()) {
+        if (d->state == SmtpResponderPrivate::Data) {
+            const auto end = d->buffer.indexOf("\r\n.\r\n", int(d->scanFrom));
+            if (end == -1) {
+                // The terminator might be split with the next chunk
+                d->scanFrom = qMax<qsizetype>(d->scanFrom, d->buffer.size() - 4);
+                break;
+            }
+
+            pos      = end + 5;
+            d->state = SmtpResponderPrivate::Command;
+            ++d->messages;
+
+            // LMTP replies once for each accepted recipient
+            const int count = d->lmtp ? qMax(1, d->recipients) : 1;
+            for (int i = 0; i < count; ++i) {
+                replies.append(d->dataReply + "\r\n");
+            }
+            d->recipients = 0;
+            continue;
+        }
+
+        const auto eol = d->buffer.indexOf('\n', int(pos));
+        if (eol == -1) {
+            break;
+        }
+
+        const QByteArray line = d->buffer.mid(int(pos), int(eol + 1 - pos)).trimmed();
+        pos                   = eol + 1;
+        replies.append(d->commandReply(line));
+
+        if (d->state == SmtpResponderPrivate::Data) {
+            // Include the CRLF of the DATA line so an empty message is found too
+            d->scanFrom = qMax<qsizetype>(0, pos - 2);
+        }
+    }
+
+    // Message data is not kept, only what wasn't scanned yet
+    if (d->state == SmtpResponderPrivate::Data) {
+        d->buffer.remove(0, int(d->scanFrom));
+        d->scanFrom = 0;
+    } else {
+        d->buffer.remove(0, int(pos));
+    }
+
+    return replies;
+}
+
+bool SmtpResponder::quitReceived() const
+{
+    Q_D(const SmtpResponder);
+    return d->quit;
+}
+
+quint64 SmtpResponder::messagesReceived() const
+{
+    Q_D(const SmtpResponder);
+    return d->messages;
+}
+
+quint64 SmtpResponder::bytesReceived() const
+{
+    Q_D(const SmtpResponder);
+    return d->bytes;
+}
+
+QByteArray SmtpResponderPrivate::commandReply(const QByteArray &line)
+{
+    if (pendingAuthLines > 0) {
+        // Any credentials are accepted
+        if (--pendingAuthLines > 0) {
+            return QByteArrayLiteral("334 UGFzc3dvcmQ6\r\n");
+        }
+        return QByteArrayLiteral("235 2.7.0 Authentication successful\r\n");
+    }
+
+    const auto space      = line.indexOf(' ');
+    const QByteArray verb = (space == -1 ? line : line.left(space)).toUpper();
+
+    QByteArray reply = replies.value(verb);
+    if (reply.isEmpty()) {
+        if (verb == "EHLO" || verb == "LHLO") {
+            reply = "250" + QByteArray(extensions.isEmpty() ? " " : "-") + hostname;
+            for (int i = 0; i < extensions.size(); ++i) {
+                reply.append("\r\n250" + QByteArray(i + 1 == extensions.size() ? " " : "-") +
+                             extensions.at(i));
+            }
+        } else if (verb == "HELO") {
+            reply = "250 " + hostname;
+        } else if (verb == "MAIL") {
+            reply = "250 2.1.0 Ok";
+        } else if (verb == "RCPT") {
+            reply = "250 2.1.5 Ok";
+        } else if (verb == "DATA") {
+            reply = "354 End data with <CR><LF>.<CR><LF>";
+        } else if (verb == "RSET" || verb == "NOOP") {
+            reply = "250 2.0.0 Ok";
+        } else if (verb == "QUIT") {
+            reply = "221 2.0.0 Bye";
+        } else if (verb == "STARTTLS") {
+            reply = "454 4.7.0 TLS not available";
+        } else if (verb == "AUTH") {
+            const QByteArray mechanism = line.mid(5).toUpper();
+            if (mechanism == "LOGIN") {
+                pendingAuthLines = 2;
+                reply            = "334 VXNlcm5hbWU6";
+            } else if (mechanism == "PLAIN") {
+                pendingAuthLines = 1;
+                reply            = "334 ";
+            } else if (mechanism == "CRAM-MD5") {
+                pendingAuthLines = 1;
+                reply            = "334 " + QByteArrayLiteral("<1.1@localhost>").toBase64();
+            } else {
+                reply = "235 2.7.0 Authentication successful";
+            }
+        } else {
+            reply = "502 5.5.2 Command not implemented";
+        }
+    }
+
+    if (verb == "EHLO" || verb == "HELO" || verb == "LHLO") {
+        lmtp       = verb == "LHLO";
+        recipients = 0;
+    } else if (verb == "MAIL" || verb == "RSET") {
+        recipients = 0;
+    } else if (verb == "RCPT" && reply.startsWith('2')) {
+        ++recipients;
+    } else if (verb == "DATA" && reply.startsWith("354")) {
+        state = Data;
+    } else if (verb == "QUIT") {
+        quit = true;
+    }
+
+    return reply + "\r\n";
+}
@@ -0,0 +1,103 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#pragma once
+
+#include "smtpexports.h"
+
+#include <QByteArrayList>
+
+namespace SimpleMail {
+
+class SmtpResponderPrivate;
+/**
+ * SmtpResponder is a scripted SMTP server side, it consumes client
+ * bytes and produces the replies without doing any I/O, so it can be
+ * paired with any transport.
+ *
+ * Every command gets a canned reply that can be overridden, messages
+ * are parsed up to the final dot and discarded.
+ */
+class SMTP_EXPORT SmtpResponder
+{
+    Q_DECLARE_PRIVATE(SmtpResponder)
+public:
+    SmtpResponder();
+    virtual ~SmtpResponder();
+
+    /**
+     * Defines the 220 greeting line, without the line ending
+     */
+    void setGreeting(const QByteArray &greeting);
+    QByteArray greeting() const;
+
+    /**
+     * Defines the hostname used on the EHLO reply
+     */
+    void setHostname(const QByteArray &hostname);
+    QByteArray hostname() const;
+
+    /**
+     * Defines the extensions announced on the EHLO reply,
+     * defaults to PIPELINING and 8BITMIME
+     */
+    void setExtensions(const QByteArrayList &extensions);
+    QByteArrayList extensions() const;
+
+    /**
+     * Overrides the reply to the command verb, e.g. "RCPT" with
+     * "550 5.1.1 User unknown", multi-line replies are separated by CRLF.
+     * An empty reply restores the default
+     */
+    void setReply(const QByteArray &command, const QByteArray &reply);
+
+    /**
+     * Defines the reply sent once the message data is received
+     */
+    void setDataReply(const QByteArray &reply);
+
+    /**
+     * Starts a new session, returns the greeting to be sent to the client
+     */
+    QByteArray startSession();
+
+    /**
+     * Consumes data sent by the client, returns the replies for
+     * every command completed so far, which might be empty
+     */
+    QByteArray process(const char *data, qint64 size);
+
+    /**
+     * Returns true once the client sent QUIT
+     */
+    bool quitReceived() const;
+
+    /**
+     * Returns the number of messages received since creation
+     */
+    quint64 messagesReceived() const;
+
+    /**
+     * Returns the number of bytes received since creation
+     */
+    quint64 bytesReceived() const;
+
+private:
+    Q_DISABLE_COPY(SmtpResponder)
+
+    SmtpResponderPrivate *d_ptr;
+};
+
+} // namespace SimpleMail
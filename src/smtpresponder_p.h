@@ -0,0 +1,53 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef SMTPRESPONDER_P_H
+#define SMTPRESPONDER_P_H
+
+#include "smtpresponder.h"
+
+#include <QHash>
+
+namespace SimpleMail {
+
+class SmtpResponderPrivate
+{
+public:
+    enum State {
+        Command,
+        Data,
+    };
+
+    QByteArray commandReply(const QByteArray &line);
+
+    QHash<QByteArray, QByteArray> replies;
+    QByteArrayList extensions = {QByteArrayLiteral("PIPELINING"), QByteArrayLiteral("8BITMIME")};
+    QByteArray greeting       = QByteArrayLiteral("220 localhost ESMTP SimpleMail");
+    QByteArray hostname       = QByteArrayLiteral("localhost");
+    QByteArray dataReply      = QByteArrayLiteral("250 2.0.0 Ok: queued");
+    QByteArray buffer;
+    qsizetype scanFrom   = 0;
+    quint64 messages     = 0;
+    quint64 bytes        = 0;
+    int recipients       = 0;
+    int pendingAuthLines = 0;
+    State state          = Command;
+    bool lmtp            = false;
+    bool quit            = false;
+};
+
+} // namespace SimpleMail
+
+#endif // SMTPRESPONDER_P_H
@@ -0,0 +1,435 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "sockettransport_p.h"
+
+#include "sslsessioncache_p.h"
+
+#include <utility>
+
+#include <QLocalSocket>
+#include <QLoggingCategory>
+#include <QSslSocket>
+#include <QTcpSocket>
+
+Q_DECLARE_LOGGING_CATEGORY(SIMPLEMAIL_SERVER)
+
+using namespace SimpleMail;
+
+// RFC 8305 section 5 recommends 250ms
+constexpr int ConnectionAttemptDelay = 250;
+
+SocketTransport::SocketTransport(Server::ConnectionType type, QObject *parent)
+    : Transport(parent)
+    , m_type(type)
+{
+    if (type == Server::LocalSocketConnection) {
+        auto localSocket = new QLocalSocket(this);
+        m_socket         = localSocket;
+        connect(localSocket, &QLocalSocket::connected, this, &SocketTransport::socketConnected);
+        connect(localSocket,
+                &QLocalSocket::stateChanged,
+                this,
+                [this](QLocalSocket::LocalSocketState state) {
+            qCDebug(SIMPLEMAIL_SERVER) << "stateChanged" << state;
+            if (state == QLocalSocket::UnconnectedState) {
+                socketDisconnected();
+            }
+        });
+        connect(localSocket, &QLocalSocket::errorOccurred, this, &SocketTransport::socketError);
+        connect(m_socket, &QIODevice::readyRead, this, &SocketTransport::readyRead);
+        connect(m_socket, &QIODevice::bytesWritten, this, &SocketTransport::bytesWritten);
+    } else {
+        // Replaced by the socket that wins the race on each connect
+        QAbstractSocket *tcpSocket = createTcpSocket();
+#ifndef QT_NO_SSL
+        if (type != Server::TcpConnection) {
+            m_sslConfiguration = static_cast<QSslSocket *>(tcpSocket)->sslConfiguration();
+        }
+#endif
+        m_socket = tcpSocket;
+        watch(tcpSocket);
+    }
+
+    m_attemptTimer.setSingleShot(true);
+    m_attemptTimer.setInterval(ConnectionAttemptDelay);
+    connect(&m_attemptTimer, &QTimer::timeout, this, &SocketTransport::startAttempt);
+}
+
+SocketTransport::~SocketTransport() = default;
+
+Transport::Capabilities SocketTransport::capabilities() const
+{
+    switch (m_type) {
+    case Server::TcpConnection:
+        return NoCapabilities;
+    case Server::LocalSocketConnection:
+        return Local;
+#ifndef QT_NO_SSL
+    case Server::SslConnection:
+    case Server::TlsConnection:
+        return Encryption;
+#endif
+    }
+    return NoCapabilities;
+}
+
+void SocketTransport::connectToHost(const QString &host, quint16 port)
+{
+    if (m_type == Server::LocalSocketConnection) {
+        qCDebug(SIMPLEMAIL_SERVER) << "Connecting to local socket" << host;
+        static_cast<QLocalSocket *>(m_socket)->connectToServer(host);
+        return;
+    }
+
+    abortAttempts();
+#ifndef QT_NO_SSL
+    if (m_type != Server::TcpConnection) {
+        setupSession(host, port);
+    }
+#endif
+
+    m_host       = host;
+    m_port       = port;
+    m_connecting = true;
+    m_resolving  = true;
+    m_attemptError.clear();
+
+    // Cached answers still arrive from the event loop
+    const int id = ++m_lookupId;
+    DnsCache::lookupHost(
+        host, m_nameserver, m_nameserverPort, this, [this, id](const DnsCache::HostResult &result) {
+        if (id == m_lookupId && m_connecting) {
+            hostFound(result);
+        }
+    });
+}
+
+void SocketTransport::disconnectFromHost()
+{
+    if (m_connecting) {
+        // Still resolving or racing, there is no connection to close yet
+        abortAttempts();
+        Q_EMIT disconnected();
+    } else if (m_type == Server::LocalSocketConnection) {
+        static_cast<QLocalSocket *>(m_socket)->disconnectFromServer();
+    } else {
+        static_cast<QTcpSocket *>(m_socket)->disconnectFromHost();
+    }
+}
+
+void SocketTransport::startClientEncryption()
+{
+#ifndef QT_NO_SSL
+    auto sslSocket = qobject_cast<QSslSocket *>(m_socket);
+    if (sslSocket) {
+        qCDebug(SIMPLEMAIL_SERVER) << "Starting client encryption";
+        sslSocket->startClientEncryption();
+    }
+#endif
+}
+
+bool SocketTransport::isEncrypted() const
+{
+#ifndef QT_NO_SSL
+    auto sslSocket = qobject_cast<QSslSocket *>(m_socket);
+    return sslSocket && sslSocket->isEncrypted();
+#else
+    return false;
+#endif
+}
+
+qint64 SocketTransport::bytesAvailable() const
+{
+    return Transport::bytesAvailable() + m_socket->bytesAvailable();
+}
+
+qint64 SocketTransport::bytesToWrite() const
+{
+    return m_socket->bytesToWrite();
+}
+
+bool SocketTransport::canReadLine() const
+{
+    return Transport::canReadLine() || m_socket->canReadLine();
+}
+
+void SocketTransport::close()
+{
+    abortAttempts();
+    m_socket->close();
+    Transport::close();
+}
+
+QIODevice *SocketTransport::socket() const
+{
+    return m_socket;
+}
+
+void SocketTransport::setNameserver(const QHostAddress &address, quint16 port)
+{
+    m_nameserver     = address;
+    m_nameserverPort = port;
+}
+
+#ifndef QT_NO_SSL
+void SocketTransport::setSslConfiguration(const QSslConfiguration &configuration)
+{
+    m_sslConfiguration = configuration;
+    // Needed for the session ticket to be exposed after the handshake
+    m_sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+}
+#endif
+
+qint64 SocketTransport::readData(char *data, qint64 maxSize)
+{
+    return m_socket->read(data, maxSize);
+}
+
+qint64 SocketTransport::readLineData(char *data, qint64 maxSize)
+{
+    // QIODevice::readLine() reserves one more byte for the terminating
+    // null, which the socket's readLine() accounts for
+    return m_socket->readLine(data, maxSize + 1);
+}
+
+qint64 SocketTransport::writeData(const char *data, qint64 size)
+{
+    return m_socket->write(data, size);
+}
+
+QAbstractSocket *SocketTransport::createTcpSocket()
+{
+#ifndef QT_NO_SSL
+    if (m_type != Server::TcpConnection) {
+        auto sslSocket = new QSslSocket(this);
+        if (!m_sessionKey.isEmpty()) {
+            sslSocket->setSslConfiguration(m_sessionConfiguration);
+        }
+        return sslSocket;
+    }
+#endif
+    return new QTcpSocket(this);
+}
+
+void SocketTransport::watch(QAbstractSocket *socket)
+{
+    connect(socket,
+            &QAbstractSocket::stateChanged,
+            this,
+            [this](QAbstractSocket::SocketState state) {
+        qCDebug(SIMPLEMAIL_SERVER) << "stateChanged" << state;
+        if (state == QAbstractSocket::UnconnectedState) {
+            socketDisconnected();
+        }
+    });
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    connect(socket, &QAbstractSocket::errorOccurred, this, &SocketTransport::socketError);
+#else
+    connect(socket,
+            static_cast<void (QAbstractSocket::*)(QAbstractSocket::SocketError)>(
+                &QAbstractSocket::error),
+            this,
+            &SocketTransport::socketError);
+#endif
+    connect(socket, &QIODevice::readyRead, this, &SocketTransport::readyRead);
+    connect(socket, &QIODevice::bytesWritten, this, &SocketTransport::bytesWritten);
+
+#ifndef QT_NO_SSL
+    auto sslSocket = qobject_cast<QSslSocket *>(socket);
+    if (sslSocket) {
+        connect(sslSocket, &QSslSocket::encrypted, this, [this] {
+            storeSession();
+            Q_EMIT encrypted();
+        });
+        // TLS 1.3 servers send tickets after the handshake
+        connect(sslSocket,
+                &QSslSocket::newSessionTicketReceived,
+                this,
+                &SocketTransport::storeSession);
+        connect(sslSocket,
+                static_cast<void (QSslSocket::*)(const QList<QSslError> &)>(&QSslSocket::sslErrors),
+                this,
+                &SocketTransport::sslErrors,
+                Qt::DirectConnection);
+    }
+#endif
+}
+
+void SocketTransport::hostFound(const DnsCache::HostResult &result)
+{
+    m_resolving = !result.complete;
+    m_addresses += result.addresses;
+
+    if (!m_attempts.isEmpty()) {
+        // The late family joins the race after the attempt delay
+        if (!m_addresses.isEmpty() && !m_attemptTimer.isActive()) {
+            m_attemptTimer.start();
+        }
+    } else if (!m_addresses.isEmpty()) {
+        startAttempt();
+    } else if (!m_resolving) {
+        m_connecting = false;
+        setErrorString(m_attemptError.isEmpty() ? result.error : m_attemptError);
+        Q_EMIT errorOccurred(errorString());
+        Q_EMIT disconnected();
+    }
+}
+
+void SocketTransport::startAttempt()
+{
+    const QHostAddress address = m_addresses.takeFirst();
+    QAbstractSocket *socket    = createTcpSocket();
+    m_attempts.append(socket);
+
+    connect(socket, &QAbstractSocket::connected, this, [this, socket] {
+        attemptConnected(socket);
+    });
+    auto failed = [this, socket] { attemptFailed(socket); };
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    connect(socket, &QAbstractSocket::errorOccurred, this, failed);
+#else
+    connect(socket,
+            static_cast<void (QAbstractSocket::*)(QAbstractSocket::SocketError)>(
+                &QAbstractSocket::error),
+            this,
+            failed);
+#endif
+
+    qCDebug(SIMPLEMAIL_SERVER) << "Connecting to host" << m_host << address << m_port;
+#ifndef QT_NO_SSL
+    if (m_type == Server::SslConnection) {
+        // The name is still the one verified and sent with SNI
+        static_cast<QSslSocket *>(socket)->connectToHostEncrypted(
+            address.toString(), m_port, m_host);
+    } else {
+        if (m_type == Server::TlsConnection) {
+            static_cast<QSslSocket *>(socket)->setPeerVerifyName(m_host);
+        }
+        socket->connectToHost(address, m_port);
+    }
+#else
+    socket->connectToHost(address, m_port);
+#endif
+
+    if (!m_addresses.isEmpty()) {
+        m_attemptTimer.start();
+    }
+}
+
+void SocketTransport::attemptConnected(QAbstractSocket *socket)
+{
+    qCDebug(SIMPLEMAIL_SERVER) << "Connected to" << socket->peerAddress() << "after"
+                               << m_attempts.size() << "attempts in flight";
+    m_attempts.removeOne(socket);
+    abortAttempts();
+
+    socket->disconnect(this);
+    m_socket->disconnect(this);
+    m_socket->deleteLater();
+    m_socket = socket;
+    watch(socket);
+
+    socketConnected();
+}
+
+void SocketTransport::attemptFailed(QAbstractSocket *socket)
+{
+    qCDebug(SIMPLEMAIL_SERVER) << "Connection attempt failed" << socket->peerAddress()
+                               << socket->errorString();
+    m_attemptError = socket->errorString();
+    m_attempts.removeOne(socket);
+    socket->disconnect(this);
+    socket->deleteLater();
+
+    if (!m_addresses.isEmpty()) {
+        // The next address doesn't wait for the attempt delay
+        m_attemptTimer.stop();
+        startAttempt();
+    } else if (m_attempts.isEmpty() && !m_resolving) {
+        m_connecting = false;
+        setErrorString(m_attemptError);
+        Q_EMIT errorOccurred(errorString());
+        Q_EMIT disconnected();
+    }
+}
+
+void SocketTransport::abortAttempts()
+{
+    m_connecting = false;
+    m_resolving  = false;
+    m_attemptTimer.stop();
+    m_addresses.clear();
+
+    for (QAbstractSocket *socket : std::as_const(m_attempts)) {
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+    m_attempts.clear();
+}
+
+void SocketTransport::socketConnected()
+{
+    // The socket does its own buffering
+    open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    Q_EMIT connected();
+}
+
+void SocketTransport::socketDisconnected()
+{
+    Transport::close();
+    Q_EMIT disconnected();
+}
+
+void SocketTransport::socketError()
+{
+    qCDebug(SIMPLEMAIL_SERVER) << "SocketError" << m_socket->errorString();
+#ifndef QT_NO_SSL
+    if (!m_sessionKey.isEmpty() && static_cast<QAbstractSocket *>(m_socket)->error() ==
+                                       QAbstractSocket::SslHandshakeFailedError) {
+        // Don't try to resume a session the server may have rejected
+        SslSessionCache::remove(m_sessionKey);
+    }
+#endif
+    setErrorString(m_socket->errorString());
+    Q_EMIT errorOccurred(errorString());
+}
+
+#ifndef QT_NO_SSL
+void SocketTransport::setupSession(const QString &host, quint16 port)
+{
+    m_sessionKey = SslSessionCache::key(host, port);
+
+    // Applied to every socket of the race
+    m_sessionConfiguration  = m_sslConfiguration;
+    const QByteArray ticket = SslSessionCache::ticket(m_sessionKey);
+    if (!ticket.isEmpty()) {
+        qCDebug(SIMPLEMAIL_SERVER) << "Resuming TLS session for" << m_sessionKey;
+        m_sessionConfiguration.setSessionTicket(ticket);
+    }
+}
+
+void SocketTransport::storeSession()
+{
+    const QSslConfiguration configuration =
+        static_cast<QSslSocket *>(m_socket)->sslConfiguration();
+    SslSessionCache::insert(m_sessionKey,
+                            configuration.sessionTicket(),
+                            configuration.sessionTicketLifeTimeHint());
+}
+#endif
+
+#include "moc_sockettransport.cpp"
@@ -0,0 +1,128 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef SOCKETTRANSPORT_P_H
+#define SOCKETTRANSPORT_P_H
+
+#include "dnscache_p.h"
+#include "server.h"
+#include "transport.h"
+
+#include <QTimer>
+
+#ifndef QT_NO_SSL
+#include <QSslConfiguration>
+
+class QSslError;
+#endif
+
+class QAbstractSocket;
+
+namespace SimpleMail {
+
+/**
+ * The default transport, wraps a QTcpSocket, QSslSocket or QLocalSocket
+ * depending on the connection type.
+ *
+ * Host names are resolved through the DnsCache, when they have several
+ * addresses the connection attempts are raced as in RFC 8305 (Happy
+ * Eyeballs): a new attempt starts every 250ms, or as soon as the previous
+ * one fails, the first socket to connect is kept and the others are aborted.
+ */
+class SocketTransport : public Transport
+{
+    Q_OBJECT
+public:
+    explicit SocketTransport(Server::ConnectionType type, QObject *parent = nullptr);
+    ~SocketTransport() override;
+
+    Capabilities capabilities() const override;
+    void connectToHost(const QString &host, quint16 port) override;
+    void disconnectFromHost() override;
+    void startClientEncryption() override;
+    bool isEncrypted() const override;
+
+    qint64 bytesAvailable() const override;
+    qint64 bytesToWrite() const override;
+    bool canReadLine() const override;
+    void close() override;
+
+    QIODevice *socket() const;
+
+    /**
+     * Defines the nameserver used to resolve the host, a null address
+     * uses the system's resolver
+     */
+    void setNameserver(const QHostAddress &address, quint16 port);
+
+#ifndef QT_NO_SSL
+    /**
+     * Defines the configuration applied on every connect, a cached
+     * session for the destination is added to it when available
+     */
+    void setSslConfiguration(const QSslConfiguration &configuration);
+#endif
+
+#ifndef QT_NO_SSL
+Q_SIGNALS:
+    /**
+     * Forwards the errors of the connected socket, Server::ignoreSslErrors()
+     * must be called from a direct connection
+     */
+    void sslErrors(const QList<QSslError> &errors);
+#endif
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 readLineData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 size) override;
+
+private:
+    QAbstractSocket *createTcpSocket();
+    void watch(QAbstractSocket *socket);
+    void hostFound(const DnsCache::HostResult &result);
+    void startAttempt();
+    void attemptConnected(QAbstractSocket *socket);
+    void attemptFailed(QAbstractSocket *socket);
+    void abortAttempts();
+    void socketConnected();
+    void socketDisconnected();
+    void socketError();
+#ifndef QT_NO_SSL
+    void setupSession(const QString &host, quint16 port);
+    void storeSession();
+
+    QSslConfiguration m_sslConfiguration;
+    QSslConfiguration m_sessionConfiguration;
+    QString m_sessionKey;
+#endif
+    QIODevice *m_socket;
+    QList<QAbstractSocket *> m_attempts;
+    QList<QHostAddress> m_addresses;
+    QTimer m_attemptTimer;
+    QHostAddress m_nameserver;
+    QString m_host;
+    QString m_attemptError;
+    Server::ConnectionType m_type;
+    int m_lookupId           = 0;
+    quint16 m_nameserverPort = 53;
+    quint16 m_port           = 0;
+    bool m_connecting        = false;
+    bool m_resolving         = false; // more addresses may follow
+};
+
+} // namespace SimpleMail
+
+#endif // SOCKETTRANSPORT_P_H
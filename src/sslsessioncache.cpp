@@ -0,0 +1,93 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "sslsessioncache_p.h"
+
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QMutex>
+
+using namespace SimpleMail;
+
+namespace {
+
+struct Session {
+    QByteArray ticket;
+    QDeadlineTimer expiry;
+};
+
+// Servers rarely talk to more than a handful of destinations,
+// this only protects from unbounded growth
+constexpr int MaxSessions = 1024;
+
+// Used when the server doesn't give a lifetime hint
+constexpr int DefaultLifetime = 2 * 60 * 60;
+
+QMutex mutex;
+QHash<QString, Session> sessions;
+
+} // namespace
+
+QString SslSessionCache::key(const QString &host, quint16 port)
+{
+    return host.toLower() + QLatin1Char(':') + QString::number(port);
+}
+
+QByteArray SslSessionCache::ticket(const QString &key)
+{
+    QMutexLocker locker(&mutex);
+    auto it = sessions.find(key);
+    if (it == sessions.end()) {
+        return {};
+    }
+
+    if (it->expiry.hasExpired()) {
+        sessions.erase(it);
+        return {};
+    }
+    return it->ticket;
+}
+
+void SslSessionCache::insert(const QString &key, const QByteArray &ticket, int lifetimeHint)
+{
+    if (ticket.isEmpty()) {
+        return;
+    }
+
+    const int lifetime = lifetimeHint > 0 ? lifetimeHint : DefaultLifetime;
+
+    QMutexLocker locker(&mutex);
+    if (sessions.size() >= MaxSessions && !sessions.contains(key)) {
+        for (auto it = sessions.begin(); it != sessions.end();) {
+            if (it->expiry.hasExpired()) {
+                it = sessions.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        if (sessions.size() >= MaxSessions) {
+            sessions.erase(sessions.begin());
+        }
+    }
+
+    sessions.insert(key, {ticket, QDeadlineTimer(qint64(lifetime) * 1000)});
+}
+
+void SslSessionCache::remove(const QString &key)
+{
+    QMutexLocker locker(&mutex);
+    sessions.remove(key);
+}
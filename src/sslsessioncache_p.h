@@ -0,0 +1,52 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef SSLSESSIONCACHE_P_H
+#define SSLSESSIONCACHE_P_H
+
+#include <QByteArray>
+#include <QString>
+
+namespace SimpleMail {
+
+/**
+ * Process wide cache of TLS session tickets keyed by destination,
+ * so every connection to the same host and port, from any Server
+ * instance or thread, can resume instead of doing a full handshake
+ */
+class SslSessionCache
+{
+public:
+    static QString key(const QString &host, quint16 port);
+
+    /**
+     * Returns the ticket for key, or an empty one if none is cached or it expired
+     */
+    static QByteArray ticket(const QString &key);
+
+    /**
+     * Stores the ticket for key, lifetimeHint is in seconds as given by the server
+     */
+    static void insert(const QString &key, const QByteArray &ticket, int lifetimeHint);
+
+    /**
+     * Drops the ticket for key, used when resuming it failed
+     */
+    static void remove(const QString &key);
+};
+
+} // namespace SimpleMail
+
+#endif // SSLSESSIONCACHE_P_H
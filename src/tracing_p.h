@@ -0,0 +1,41 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef TRACING_P_H
+#define TRACING_P_H
+
+/**
+ * USDT probes of the "simplemail" provider, for bpftrace, perf or SystemTap.
+ * An unattached probe is a single nop, its arguments are still evaluated so
+ * they must be cheap. Without ENABLE_USDT the arguments aren't even compiled.
+ *
+ * connect__start(host, port), connect__done(host, port)
+ * command(data, size), reply(code, data, size)
+ * data__start(reply), data__done(reply, ok)
+ * encode__start(part, encoding), encode__done(part, encoding, input, output)
+ * queue__enqueue(reply, priority, size), queue__dequeue(reply, size)
+ * transport__error(host, port, error), reply__failed(reply, code, text)
+ */
+#ifdef SIMPLEMAIL_USDT
+#include <sys/sdt.h>
+
+#define SIMPLEMAIL_TRACE(name, ...) STAP_PROBEV(simplemail, name, __VA_ARGS__)
+#else
+#define SIMPLEMAIL_TRACE(name, ...)                                                                \
+    do {                                                                                           \
+    } while (false)
+#endif
+
+#endif // TRACING_P_H
@@ -0,0 +1,67 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "transcript_p.h"
+
+#include <cstring>
+
+using namespace SimpleMail;
+
+void Transcript::setCapacity(int lines)
+{
+    lines = qMax(0, lines);
+    if (lines == m_capacity) {
+        return;
+    }
+
+    m_lines.reset(lines ? new Line[lines] : nullptr);
+    m_capacity = lines;
+    m_next     = 0;
+    m_count    = 0;
+}
+
+void Transcript::append(Direction direction, const char *data, qsizetype size)
+{
+    if (m_capacity == 0) {
+        return;
+    }
+
+    // Line endings aren't kept
+    while (size > 0 && (data[size - 1] == '\n' || data[size - 1] == '\r')) {
+        --size;
+    }
+
+    Line &line     = m_lines[m_next];
+    line.size      = quint8(qMin<qsizetype>(size, LineLength));
+    line.direction = direction;
+    std::memcpy(line.data, data, line.size);
+
+    m_next  = (m_next + 1) % m_capacity;
+    m_count = qMin(m_count + 1, m_capacity);
+}
+
+QStringList Transcript::lines() const
+{
+    QStringList ret;
+    ret.reserve(m_count);
+
+    const int first = (m_next - m_count + m_capacity) % qMax(1, m_capacity);
+    for (int i = 0; i < m_count; ++i) {
+        const Line &line = m_lines[(first + i) % m_capacity];
+        ret.append(QLatin1Char(char(line.direction)) + QLatin1String(": ") +
+                   QLatin1String(line.data, line.size));
+    }
+    return ret;
+}
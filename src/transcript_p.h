@@ -0,0 +1,71 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#ifndef TRANSCRIPT_P_H
+#define TRANSCRIPT_P_H
+
+#include <memory>
+
+#include <QByteArray>
+#include <QStringList>
+
+namespace SimpleMail {
+
+/**
+ * The last commands and replies of a connection, kept in fixed size slots
+ * allocated once, longer lines are truncated. Only turned into strings when
+ * a transaction fails
+ */
+class Transcript
+{
+public:
+    enum Direction : char {
+        Client = 'C',
+        Server = 'S',
+    };
+
+    static constexpr int LineLength = 126;
+
+    inline int capacity() const { return m_capacity; }
+    void setCapacity(int lines);
+
+    void append(Direction direction, const char *data, qsizetype size);
+    inline void append(Direction direction, const QByteArray &line)
+    {
+        append(direction, line.constData(), line.size());
+    }
+    inline void clear() { m_count = 0; }
+
+    /**
+     * Returns the lines from the oldest, as "C: command" and "S: reply"
+     */
+    QStringList lines() const;
+
+private:
+    struct Line {
+        char data[LineLength];
+        quint8 size;
+        Direction direction;
+    };
+
+    std::unique_ptr<Line[]> m_lines;
+    int m_capacity = 0;
+    int m_next     = 0;
+    int m_count    = 0;
+};
+
+} // namespace SimpleMail
+
+#endif // TRANSCRIPT_P_H
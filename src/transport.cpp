@@ -0,0 +1,41 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "transport.h"
+
+using namespace SimpleMail;
+
+Transport::Transport(QObject *parent)
+    : QIODevice(parent)
+{
+}
+
+Transport::~Transport() = default;
+
+void Transport::startClientEncryption()
+{
+}
+
+bool Transport::isEncrypted() const
+{
+    return false;
+}
+
+bool Transport::isSequential() const
+{
+    return true;
+}
+
+#include "moc_transport.cpp"
@@ -0,0 +1,89 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#pragma once
+
+#include "smtpexports.h"
+
+#include <QIODevice>
+
+namespace SimpleMail {
+
+/**
+ * Transport is the byte stream a Server speaks SMTP over.
+ *
+ * The device is opened by the transport itself once connectToHost()
+ * succeeds and closed when the connection goes away. Server reads the
+ * replies with canReadLine() and readLine() and writes commands and
+ * message data with write(), which must accept all the data given,
+ * bytesToWrite() and bytesWritten() tell how much of it is still pending.
+ */
+class SMTP_EXPORT Transport : public QIODevice
+{
+    Q_OBJECT
+public:
+    enum Capability {
+        NoCapabilities = 0x0,
+        Encryption     = 0x1, // Supports startClientEncryption() for STARTTLS
+        ZeroCopy       = 0x2, // Large writes are sent without the kernel copying them
+        Local          = 0x4, // The peer is on the same host
+    };
+    Q_DECLARE_FLAGS(Capabilities, Capability)
+    Q_FLAG(Capabilities)
+
+    explicit Transport(QObject *parent = nullptr);
+    virtual ~Transport();
+
+    /**
+     * Returns what this transport is able to do
+     */
+    virtual Capabilities capabilities() const = 0;
+
+    /**
+     * Starts connecting to host and port, connected() is emitted
+     * once the device is open, errorOccurred() if that fails
+     */
+    virtual void connectToHost(const QString &host, quint16 port) = 0;
+
+    /**
+     * Closes the connection once pending data is written,
+     * disconnected() is emitted when done
+     */
+    virtual void disconnectFromHost() = 0;
+
+    /**
+     * Starts a TLS handshake on the open connection, data written
+     * meanwhile is sent once it's encrypted.
+     * The default implementation does nothing
+     */
+    virtual void startClientEncryption();
+
+    /**
+     * Returns true if the connection is encrypted
+     */
+    virtual bool isEncrypted() const;
+
+    bool isSequential() const override;
+
+Q_SIGNALS:
+    void connected();
+    void disconnected();
+    void encrypted();
+    void errorOccurred(const QString &error);
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(Transport::Capabilities)
+
+} // namespace SimpleMail
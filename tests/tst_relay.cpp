@@ -0,0 +1,167 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "loopbacktransport.h"
+#include "relay.h"
+#include "server.h"
+#include "smtpresponder.h"
+
+#include <QDir>
+#include <QSaveFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace SimpleMail;
+
+static const QByteArray TemporaryFailure = QByteArrayLiteral("451 4.3.0 Try again later");
+static const QByteArray Accepted         = QByteArrayLiteral("250 2.0.0 Ok");
+
+class TestRelay : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void retriesTemporaryFailures();
+    void spoolsAfterRetries();
+    void keepsRetryingWithoutSpool();
+    void spooledMessageDeliveredOnce();
+
+private:
+    static Relay::Envelope envelope();
+    static SmtpResponder *addUpstream(Relay &relay);
+    static QStringList spooled(const QTemporaryDir &dir);
+};
+
+Relay::Envelope TestRelay::envelope()
+{
+    Relay::Envelope ret;
+    ret.sender     = QStringLiteral("sender@example.com");
+    ret.recipients = QStringList{QStringLiteral("rcpt@example.com")};
+    ret.data       = QByteArrayLiteral("Subject: Relay test\r\n\r\nHello");
+    return ret;
+}
+
+SmtpResponder *TestRelay::addUpstream(Relay &relay)
+{
+    // The whole upstream session stays in process
+    auto transport = new LoopbackTransport;
+    transport->responder()->setDataReply(TemporaryFailure);
+
+    auto server = new Server;
+    server->setTransport(transport);
+    relay.addUpstream(server);
+    return transport->responder();
+}
+
+QStringList TestRelay::spooled(const QTemporaryDir &dir)
+{
+    return QDir(dir.path()).entryList({QStringLiteral("*.msg")}, QDir::Files);
+}
+
+void TestRelay::retriesTemporaryFailures()
+{
+    Relay relay;
+    relay.setRetryInterval(10);
+    relay.setMaxRetries(10);
+    SmtpResponder *responder = addUpstream(relay);
+
+    QVERIFY(relay.submit(envelope()));
+    QTRY_VERIFY(responder->messagesReceived() >= 2);
+
+    responder->setDataReply(Accepted);
+    const quint64 failed = responder->messagesReceived();
+    QTRY_COMPARE(relay.inFlight(), 0);
+    QCOMPARE(responder->messagesReceived() - failed, quint64(1));
+}
+
+void TestRelay::spoolsAfterRetries()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    Relay relay;
+    relay.setRetryInterval(10);
+    relay.setMaxRetries(2);
+    SmtpResponder *responder = addUpstream(relay);
+    relay.setSpoolDirectory(dir.path());
+
+    QVERIFY(relay.submit(envelope()));
+    QTRY_COMPARE(relay.inFlight(), 0);
+    QCOMPARE(responder->messagesReceived(), quint64(2));
+    QCOMPARE(spooled(dir).size(), 1);
+
+    // Picked up by the next spool scan once the upstream recovers
+    responder->setDataReply(Accepted);
+    const quint64 failed = responder->messagesReceived();
+    QTRY_VERIFY(spooled(dir).isEmpty());
+    QTRY_COMPARE(relay.inFlight(), 0);
+    QCOMPARE(responder->messagesReceived() - failed, quint64(1));
+}
+
+void TestRelay::keepsRetryingWithoutSpool()
+{
+    Relay relay;
+    relay.setRetryInterval(10);
+    relay.setMaxRetries(2);
+    SmtpResponder *responder = addUpstream(relay);
+
+    // Already accepted from the client, so it can't be dropped
+    QVERIFY(relay.submit(envelope()));
+    QTRY_VERIFY(responder->messagesReceived() >= 4);
+    QCOMPARE(relay.inFlight(), 1);
+
+    responder->setDataReply(Accepted);
+    const quint64 failed = responder->messagesReceived();
+    QTRY_COMPARE(relay.inFlight(), 0);
+    QCOMPARE(responder->messagesReceived() - failed, quint64(1));
+}
+
+void TestRelay::spooledMessageDeliveredOnce()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // Left by a previous run
+    const Relay::Envelope message = envelope();
+    QSaveFile file(QDir(dir.path()).filePath(QStringLiteral("previous.msg")));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("MAIL FROM:<" + message.sender.toUtf8() + ">\r\n");
+    file.write("RCPT TO:<" + message.recipients.first().toUtf8() + ">\r\n\r\n");
+    file.write(message.data);
+    QVERIFY(file.commit());
+
+    // Spool scans every 200ms run while the retries back off
+    Relay relay;
+    relay.setRetryInterval(20);
+    relay.setMaxRetries(100);
+    SmtpResponder *responder = addUpstream(relay);
+    relay.setSpoolDirectory(dir.path());
+
+    QTRY_VERIFY(responder->messagesReceived() >= 1);
+    QTest::qWait(700);
+    QCOMPARE(relay.inFlight(), 1);
+
+    responder->setDataReply(Accepted);
+    const quint64 failed = responder->messagesReceived();
+    QTRY_VERIFY(spooled(dir).isEmpty());
+    QTRY_COMPARE(relay.inFlight(), 0);
+
+    // A scan that dispatched it again would deliver a second copy
+    QTest::qWait(300);
+    QCOMPARE(responder->messagesReceived() - failed, quint64(1));
+}
+
+QTEST_GUILESS_MAIN(TestRelay)
+
+#include "tst_relay.moc"
@@ -0,0 +1,122 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "loopbacktransport.h"
+#include "mimemessage.h"
+#include "mimetext.h"
+#include "relaygroup.h"
+#include "server.h"
+#include "serverreply.h"
+#include "smtpresponder.h"
+
+#include <QSignalSpy>
+#include <QTest>
+
+using namespace SimpleMail;
+
+class TestRelayGroup : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void expiredDeadline();
+    void oversizedMessage();
+    void failuresKeepLatency();
+
+private:
+    static MimeMessage message();
+    static Server *readyServer(RelayGroup &group);
+};
+
+MimeMessage TestRelayGroup::message()
+{
+    MimeMessage ret;
+    ret.setSender(EmailAddress(QStringLiteral("sender@example.com")));
+    ret.addTo(EmailAddress(QStringLiteral("rcpt@example.com")));
+    ret.setSubject(QStringLiteral("Relay group test"));
+    ret.addPart(std::make_shared<MimeText>(QStringLiteral("Hello\n")));
+    return ret;
+}
+
+Server *TestRelayGroup::readyServer(RelayGroup &group)
+{
+    auto transport = new LoopbackTransport;
+    transport->responder()->setExtensions({"PIPELINING", "8BITMIME", "SIZE 2000"});
+
+    auto server = new Server(&group);
+    server->setTransport(transport);
+    group.addServer(server);
+
+    // The connection stays open after the first message
+    ServerReply *reply = group.sendMail(message());
+    QSignalSpy spy(reply, &ServerReply::finished);
+    return spy.wait() && !reply->error() ? server : nullptr;
+}
+
+void TestRelayGroup::expiredDeadline()
+{
+    RelayGroup group;
+    Server *server = readyServer(group);
+    QVERIFY(server);
+
+    ServerReply *reply =
+        group.sendMail(message(), Server::TransactionalPriority, QDeadlineTimer(0));
+    QSignalSpy spy(reply, &ServerReply::finished);
+    QTRY_COMPARE(spy.size(), 1);
+    QCOMPARE(reply->responseCode(), int(ServerReply::DeadlineExpired));
+    QCOMPARE(group.circuitState(server), RelayGroup::Closed);
+}
+
+void TestRelayGroup::oversizedMessage()
+{
+    RelayGroup group;
+    Server *server = readyServer(group);
+    QVERIFY(server);
+
+    MimeMessage big = message();
+    big.addPart(std::make_shared<MimeText>(QString(4000, QLatin1Char('a'))));
+    ServerReply *reply = group.sendMail(big);
+    QSignalSpy spy(reply, &ServerReply::finished);
+    QTRY_COMPARE(spy.size(), 1);
+    QCOMPARE(reply->responseCode(), 552);
+}
+
+void TestRelayGroup::failuresKeepLatency()
+{
+    RelayGroup group;
+    Server *server = readyServer(group);
+    QVERIFY(server);
+
+    // A slow delivery, then a fast failure that must not make it look faster
+    ServerReply *reply = group.sendMail(message());
+    QSignalSpy spy(reply, &ServerReply::finished);
+    QTest::qSleep(50);
+    QVERIFY(spy.wait());
+    QVERIFY(!reply->error());
+    const qreal latency = group.latency(server);
+    QVERIFY(latency >= 10);
+
+    auto transport = static_cast<LoopbackTransport *>(server->transport());
+    transport->responder()->setDataReply(QByteArrayLiteral("451 4.3.0 Try again later"));
+    reply = group.sendMail(message());
+    QSignalSpy failed(reply, &ServerReply::finished);
+    QVERIFY(failed.wait());
+    QCOMPARE(reply->responseCode(), 451);
+    QCOMPARE(group.latency(server), latency);
+    QVERIFY(group.errorRate(server) > 0);
+}
+
+QTEST_GUILESS_MAIN(TestRelayGroup)
+
+#include "tst_relaygroup.moc"
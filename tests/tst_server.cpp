@@ -0,0 +1,119 @@
+/*
+  Copyright (C) 2026 Daniel Nicoletti <dantti12@gmail.com>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  See the LICENSE file for more details.
+*/
+#include "loopbacktransport.h"
+#include "mimemessage.h"
+#include "mimetext.h"
+#include "server.h"
+#include "serverreply.h"
+#include "smtpresponder.h"
+
+#include <QSignalSpy>
+#include <QTest>
+
+using namespace SimpleMail;
+
+class TestServer : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void expiredDeadlineOnReadyServer();
+    void oversizedMessageOnReadyServer();
+#ifndef QT_NO_SSL
+    void tlsRequiredWithoutEncryption();
+#endif
+
+private:
+    static MimeMessage message();
+    static bool makeReady(Server &server);
+};
+
+MimeMessage TestServer::message()
+{
+    MimeMessage ret;
+    ret.setSender(EmailAddress(QStringLiteral("sender@example.com")));
+    ret.addTo(EmailAddress(QStringLiteral("rcpt@example.com")));
+    ret.setSubject(QStringLiteral("Server test"));
+    ret.addPart(std::make_shared<MimeText>(QStringLiteral("Hello\n")));
+    return ret;
+}
+
+bool TestServer::makeReady(Server &server)
+{
+    // The connection stays open after the first message
+    ServerReply *reply = server.sendMail(message());
+    QSignalSpy spy(reply, &ServerReply::finished);
+    return spy.wait() && !reply->error();
+}
+
+void TestServer::expiredDeadlineOnReadyServer()
+{
+    Server server;
+    server.setTransport(new LoopbackTransport);
+    QVERIFY(makeReady(server));
+
+    ServerReply *reply =
+        server.sendMail(message(), Server::TransactionalPriority, QDeadlineTimer(0));
+    QSignalSpy spy(reply, &ServerReply::finished);
+    QTRY_COMPARE(spy.size(), 1);
+    QVERIFY(reply->error());
+    QCOMPARE(reply->responseCode(), int(ServerReply::DeadlineExpired));
+}
+
+void TestServer::oversizedMessageOnReadyServer()
+{
+    auto transport = new LoopbackTransport;
+    transport->responder()->setExtensions({"PIPELINING", "8BITMIME", "SIZE 2000"});
+
+    Server server;
+    server.setTransport(transport);
+    QVERIFY(makeReady(server));
+
+    MimeMessage big = message();
+    big.addPart(std::make_shared<MimeText>(QString(4000, QLatin1Char('a'))));
+    ServerReply *reply = server.sendMail(big);
+    QSignalSpy spy(reply, &ServerReply::finished);
+    QTRY_COMPARE(spy.size(), 1);
+    QVERIFY(reply->error());
+    QCOMPARE(reply->responseCode(), 552);
+}
+
+#ifndef QT_NO_SSL
+void TestServer::tlsRequiredWithoutEncryption()
+{
+    auto transport = new LoopbackTransport;
+    transport->responder()->setExtensions({"PIPELINING", "STARTTLS", "AUTH PLAIN"});
+
+    Server server;
+    server.setTransport(transport);
+    server.setConnectionType(Server::TlsConnection);
+    server.setAuthMethod(Server::AuthPlain);
+    server.setUsername(QStringLiteral("user"));
+    server.setPassword(QStringLiteral("secret"));
+
+    QSignalSpy errors(&server, &Server::smtpError);
+    ServerReply *reply = server.sendMail(message());
+    QSignalSpy spy(reply, &ServerReply::finished);
+    QVERIFY(spy.wait());
+    QVERIFY(reply->error());
+    QCOMPARE(reply->responseCode(), int(ServerReply::TransportError));
+    QCOMPARE(errors.size(), 1);
+    QCOMPARE(transport->responder()->messagesReceived(), quint64(0));
+}
+#endif
+
+QTEST_GUILESS_MAIN(TestServer)
+
+#include "tst_server.moc"